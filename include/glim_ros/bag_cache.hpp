@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
+#include <rcutils/types/uint8_array.h>
+#include <sensor_msgs/msg/imu.hpp>
+#include <glim/util/raw_points.hpp>
+
+namespace glim {
+
+/**
+ * @brief Type of a bag cache record
+ */
+enum class BagCacheRecordType : std::uint32_t {
+  IMU = 1,         ///< stamp, linear_acc, angular_vel (as recorded, before time offsets and scaling)
+  POINTS = 2,      ///< RawPoints (stamp, points, times, intensities)
+  IMAGE = 3,       ///< Decoded BGR8 image
+  SERIALIZED = 4,  ///< Serialized message of an extension module topic
+};
+
+/**
+ * @brief A record in the memory-mapped cache (payload points into the mapped file)
+ */
+struct BagCacheRecord {
+  BagCacheRecordType type;
+  std::int64_t recv_time;
+  const std::uint8_t* payload;
+  size_t payload_size;
+};
+
+/**
+ * @brief Key identifying a cached bag (path, total file size, modification time, and filtered topics).
+ *        A cache is used only when its key matches, so it is rebuilt automatically when the bag or the topics change.
+ */
+std::string bag_cache_key(const std::string& bag_filename, const std::vector<std::string>& topics);
+
+/**
+ * @brief Cache file path of a bag ("<cache_dir>/<bag name>_<hash>.glimcache").
+ *        The hash of the canonical absolute path keeps bags with the same name in different directories apart,
+ *        while a modified bag maps to the same file so that its stale cache is replaced (the key in the header detects the change).
+ */
+std::string bag_cache_path(const std::string& cache_dir, const std::string& bag_filename);
+
+/**
+ * @brief Writes decoded bag messages into a cache file.
+ *        The file is written to a temporary path and renamed on finish() so that interrupted runs never leave partial caches.
+ */
+class BagCacheWriter {
+public:
+  BagCacheWriter(const std::string& path, const std::string& key);
+  ~BagCacheWriter();
+
+  bool ok() const { return fp != nullptr; }
+
+  void write_imu(std::int64_t recv_time, const sensor_msgs::msg::Imu& msg);
+  void write_points(std::int64_t recv_time, const RawPoints& points);
+  void write_image(std::int64_t recv_time, double stamp, const cv::Mat& image);
+  void write_serialized(std::int64_t recv_time, const std::string& topic, const std::string& type, const rcutils_uint8_array_t& data);
+
+  /// @brief Complete the cache file
+  void finish();
+
+private:
+  void write_record(BagCacheRecordType type, std::int64_t recv_time, const std::vector<std::pair<const void*, size_t>>& chunks);
+
+private:
+  const std::string path;
+  const std::string temp_path;
+  std::FILE* fp;
+};
+
+/**
+ * @brief Streams records from a memory-mapped cache file
+ */
+class BagCacheReader {
+public:
+  BagCacheReader(const std::string& path, const std::string& key);
+  ~BagCacheReader();
+
+  /// @brief True if the cache exists and matches the key
+  bool ok() const { return data != nullptr; }
+
+  /// @brief Get the next record
+  /// @return false if the end of the cache is reached
+  bool read_next(BagCacheRecord& record);
+
+  static void read_imu(const BagCacheRecord& record, double& stamp, Eigen::Vector3d& linear_acc, Eigen::Vector3d& angular_vel);
+  static RawPoints::Ptr read_points(const BagCacheRecord& record);
+  /// @brief Header stamp of a points record (without copying the points)
+  static double read_points_stamp(const BagCacheRecord& record);
+  static double read_image(const BagCacheRecord& record, cv::Mat& image);
+  /// @return Serialized data viewing the mapped file (copy it, e.g., into rclcpp::SerializedMessage, to keep it)
+  static rcutils_uint8_array_t read_serialized(const BagCacheRecord& record, std::string& topic, std::string& type);
+
+private:
+  const std::uint8_t* data;
+  size_t size;
+  size_t cursor;
+};
+
+}  // namespace glim
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+
+#include <glim/util/extension_module_ros2.hpp>
+#include <glim_ros/glim_ros.hpp>
+#include <glim_ros/bag_reader.hpp>
+#include <glim_ros/flow_controller.hpp>
+
+namespace glim {
+
+class BagCacheReader;
+
+/**
+ * @brief Parameters for BagPlayer
+ */
+struct BagPlayerParams {
+  BagPlayerParams();
+
+  /// @brief Declare and read the playback parameters on the node ("playback_speed" is read from config_ros)
+  static BagPlayerParams load(rclcpp::Node& node);
+
+  double start_offset;       ///< Playback start relative to the beginning of the first bag [sec]
+  double playback_duration;  ///< Playback duration from the start (0 = unbounded) [sec]
+  double playback_until;     ///< Stop at this receive time (0 = unbounded) [sec]
+  double playback_speed;     ///< Playback speed relative to the bag time (<= 0 = unthrottled, paced only by the flow control)
+  double end_time;           ///< Stop at the first point cloud whose header stamp exceeds this [sec]
+
+  int num_reader_threads;     ///< Number of deserialization threads of the bag reader
+  int prefetch_size;          ///< Maximum number of messages prefetched ahead of the pipeline
+  bool prefetch_next_bag;     ///< Open the next bag in the background while the current one is played
+  std::string bag_cache_dir;  ///< Directory of the decoded bag cache (empty disables the cache)
+
+  FlowControllerParams flow;  ///< Watermark-based flow control
+};
+
+/**
+ * @brief Plays a sequence of bags into GlimROS.
+ *        IMU, points, and image messages are fed to the pipeline, and the topics subscribed by extension modules
+ *        are fed to them as serialized messages, so that every offline tool drives the pipeline in the same way.
+ */
+class BagPlayer {
+public:
+  BagPlayer(const std::shared_ptr<GlimROS>& glim, const std::vector<std::string>& bag_filenames, const BagPlayerParams& params = BagPlayerParams());
+
+  /// @brief Play all the bags
+  /// @return False if the playback was stopped before the end of the last bag (end of the playback range, shutdown, or error)
+  bool play();
+
+  const FlowController& flow_controller() const { return flow; }
+
+  /// @brief Number of point clouds fed to the pipeline
+  size_t num_frames() const { return frames; }
+
+  /// @brief Receive times of the first and last played messages [nsec] (0 if nothing has been played)
+  int64_t first_msg_time() const { return bag_t0; }
+  int64_t last_msg_time() const { return bag_t1; }
+
+private:
+  using ReaderFactory = std::function<std::unique_ptr<PrefetchingBagReader>()>;
+
+  bool outside_window(size_t bag_index) const;
+  ReaderFactory open_reader(size_t bag_index) const;
+  bool read_bag(size_t bag_index);
+  bool read_cache(BagCacheReader& cache);
+
+  bool pace(int64_t msg_time);
+  bool insert_points(const RawPoints::Ptr& raw_points);
+  void insert_serialized(const std::string& topic_name, const std::string& topic_type, const rcutils_uint8_array_t& serialized_data);
+  void message_processed(int64_t msg_time);
+
+private:
+  const std::shared_ptr<GlimROS> glim;
+  const std::vector<std::string> bag_filenames;
+  const BagPlayerParams params;
+
+  std::vector<std::string> topics;  // Topics read from the bags (including the extension module topics)
+  std::unordered_map<std::string, std::vector<GenericTopicSubscription::Ptr>> subscription_map;
+  PrefetchingBagReaderParams reader_params;
+
+  // Playback window in receive time [nsec] (0 = unbounded)
+  std::vector<BagTimeRange> bag_ranges;
+  int64_t window_start;
+  int64_t window_end;
+
+  FlowController flow;
+
+  std::future<std::unique_ptr<PrefetchingBagReader>> next_reader;
+  size_t next_reader_index;
+
+  // Playback pacing
+  std::chrono::high_resolution_clock::time_point real_t0;
+  int64_t bag_t0;
+  int64_t bag_t1;
+  size_t frames;
+
+  // Speed report
+  double last_sim_time;
+  std::chrono::high_resolution_clock::time_point last_report_time;
+};
+
+}  // namespace glim
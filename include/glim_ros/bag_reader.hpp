@@ -0,0 +1,122 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <condition_variable>
+
+#include <rosbag2_storage/serialized_bag_message.hpp>
+#include <rosbag2_cpp/reader_interfaces/base_reader_interface.hpp>
+
+#include <sensor_msgs/msg/imu.hpp>
+#include <opencv2/core.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+
+namespace glim {
+
+/**
+ * @brief Parameters for PrefetchingBagReader
+ */
+struct PrefetchingBagReaderParams {
+  PrefetchingBagReaderParams();
+
+  std::vector<std::string> topics;  ///< Topics to be read (all topics if empty)
+  std::string imu_topic;            ///< Topic to be deserialized as sensor_msgs/Imu
+  std::string points_topic;         ///< Topic to be deserialized as sensor_msgs/PointCloud2
+  std::string image_topic;          ///< Topic to be decoded as sensor_msgs/(Image|CompressedImage)
+
+  int64_t start_time;       ///< Seek to this receive time before reading [nsec] (0 = from the beginning of the bag)
+  int64_t end_time;         ///< Stop at the first message received after this time [nsec] (0 = until the end of the bag)
+  double points_end_stamp;  ///< Stop at the first point cloud whose header stamp exceeds this [sec] (checked before deserialization)
+  int num_threads;          ///< Number of deserialization threads (0 = deserialize in the reader thread)
+  int queue_size;           ///< Maximum number of messages prefetched ahead of the consumer
+};
+
+/**
+ * @brief Receive time range of a bag [nsec]
+ */
+struct BagTimeRange {
+  bool valid() const { return end > start; }
+
+  int64_t start;
+  int64_t end;
+};
+
+/**
+ * @brief Get the time range of a bag from its metadata (the bag storage is opened only if metadata.yaml is missing)
+ * @return Time range (invalid if the metadata could not be read)
+ */
+BagTimeRange read_bag_time_range(const std::string& bag_filename);
+
+/**
+ * @brief A bag message prefetched and deserialized by PrefetchingBagReader
+ */
+struct BagMessage {
+  using Ptr = std::shared_ptr<BagMessage>;
+  using ConstPtr = std::shared_ptr<const BagMessage>;
+
+  std::shared_ptr<rosbag2_storage::SerializedBagMessage> bag_msg;  ///< Serialized message as read from the bag
+  std::string topic_type;                                           ///< Message type name (e.g., sensor_msgs/msg/Imu)
+  int64_t recv_time;                                                ///< Receive timestamp recorded in the bag [nsec]
+
+  // Deserialized messages (only one of them is set if the topic is IMU/points/image and the type matches)
+  sensor_msgs::msg::Imu::SharedPtr imu;
+  sensor_msgs::msg::PointCloud2::SharedPtr points;
+  double image_stamp = 0.0;  ///< Header stamp of the image [sec]
+  cv::Mat image;             ///< Image (Image or CompressedImage) decoded into BGR8 by the worker threads (empty if not decoded)
+};
+
+/**
+ * @brief Pipelined rosbag reader.
+ *        A reader thread reads (and decompresses) messages into a bounded ring buffer,
+ *        a pool of worker threads deserializes IMU/points/image messages in parallel,
+ *        and read_next() hands them out in the original bag order.
+ */
+class PrefetchingBagReader {
+public:
+  PrefetchingBagReader(const std::string& bag_filename, const PrefetchingBagReaderParams& params = PrefetchingBagReaderParams());
+  ~PrefetchingBagReader();
+
+  /// @brief Topic name to message type map of the bag
+  const std::unordered_map<std::string, std::string>& topic_types() const { return topic_type_map; }
+
+  /// @brief Get the next message in the bag order (blocks until it is deserialized)
+  /// @return Next message, or nullptr if the end of the bag is reached
+  BagMessage::ConstPtr read_next();
+
+  /// @brief True if reading stopped because the end of the requested time range was reached (not the end of the bag)
+  bool end_of_range_reached() const;
+
+private:
+  void read_task();
+  void deserialization_task();
+  void deserialize(BagMessage& msg) const;
+
+private:
+  const PrefetchingBagReaderParams params;
+  std::unique_ptr<rosbag2_cpp::reader_interfaces::BaseReaderInterface> reader;
+  std::unordered_map<std::string, std::string> topic_type_map;
+
+  mutable std::mutex mutex;
+  std::condition_variable slot_freed;        // Consumer -> reader
+  std::condition_variable message_read;      // Reader -> deserialization workers
+  std::condition_variable message_ready;     // Reader/workers -> consumer
+
+  bool kill_switch;
+  bool end_of_bag;
+  bool end_of_range;
+  size_t num_read;                           // Number of messages read from the bag
+  size_t num_consumed;                       // Number of messages handed out by read_next()
+  std::vector<BagMessage::Ptr> ring;         // Message with sequence number i is stored at ring[i % ring.size()]
+  std::vector<char> ready;                   // ready[i % ring.size()] is set once the message is deserialized
+  std::deque<size_t> deserialization_queue;  // Sequence numbers waiting for deserialization
+
+  std::thread read_thread;
+  std::vector<std::thread> deserialization_threads;
+};
+
+}  // namespace glim
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <unordered_set>
+
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <glim_ros/point_cloud2_view.hpp>
+
+namespace glim {
+
+class Config;
+
+/**
+ * @brief Reduced-bandwidth encoding of an output PointCloud2 topic (e.g., for remote monitoring over a wireless link)
+ */
+struct CloudEncoding {
+public:
+  enum class Type {
+    FLOAT32,  ///< float32 coordinates
+    INT16,    ///< int16 coordinates relative to a per-cloud origin (see CloudEncoder::read_int16_frame)
+  };
+
+  CloudEncoding();
+
+  /// @brief Load "<name>_encoding" ("float32" or "int16"), "<name>_fields" ("all", "xyz", "xyzi", or "xyzt"),
+  ///        "<name>_quantization", "<name>_voxel_resolution", and "<name>_transport" from the glim_ros section of config_ros
+  static CloudEncoding load(const Config& config, const std::string& name);
+
+  /// @brief True if the encoding differs from the full-fidelity output
+  bool enabled() const { return type != Type::FLOAT32 || !with_times || !with_intensities || voxel_resolution > 0.0 || transport; }
+
+  std::string to_string() const;
+
+public:
+  Type type;                // Coordinate type
+  bool with_times;          // Keep per-point times (if the input has them)
+  bool with_intensities;    // Keep intensities (if the input has them)
+  double quantization;      // Finest coordinate step of the INT16 encoding (raised for clouds that do not fit in the INT16 range) [m]
+  double voxel_resolution;  // Only the first point in each voxel is kept (<= 0 disables decimation) [m]
+  bool transport;           // Publish through point_cloud_transport so that subscribers can select compression plugins (e.g., draco, zstd)
+};
+
+/**
+ * @brief Converts full-fidelity float32 clouds into a CloudEncoding
+ * @note  INT16 clouds are quantized relative to the center of their bounding box, and the step is raised above the configured quantization
+ *        when the cloud extent does not fit in the INT16 range. The origin and step are written after the last point in the row padding
+ *        (row_step = point_step * width + int16_frame_size) so that every message can be decoded on its own.
+ * @note  Not thread-safe (buffers are reused between calls)
+ */
+class CloudEncoder {
+public:
+  /// @brief Size of the INT16 frame (origin x, y, z and step as little-endian float64) at the end of the row
+  static constexpr size_t int16_frame_size = sizeof(double) * 4;
+
+  CloudEncoder(const CloudEncoding& encoding);
+
+  /// @brief Encode a cloud (the header is copied from the input)
+  void encode(const sensor_msgs::msg::PointCloud2& input, sensor_msgs::msg::PointCloud2& output);
+
+  /// @brief Read the frame of an INT16 cloud (decoded coordinate = origin + scale * value)
+  /// @return False if msg does not carry an INT16 frame
+  static bool read_int16_frame(const sensor_msgs::msg::PointCloud2& msg, Eigen::Vector3d& origin, double& scale);
+
+  /// @brief Total number of clouds encoded with a coarser step than the configured quantization
+  size_t num_rescaled() const { return rescaled; }
+
+private:
+  const CloudEncoding encoding;
+  PointCloud2LayoutCache layout_cache;
+  std::unordered_set<std::uint64_t> voxels;  // Occupied voxels of the current cloud
+  size_t rescaled;
+};
+
+}  // namespace glim
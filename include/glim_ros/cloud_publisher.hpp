@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <glim_ros/cloud_encoding.hpp>
+
+namespace glim {
+
+/**
+ * @brief PointCloud2 publisher that avoids copies and reuses message buffers.
+ *        If the node uses intra-process communication, messages are published as unique_ptr so that intra-process
+ *        subscribers take ownership without a copy (transient local topics fall back to inter-process publishing).
+ *        Otherwise, messages are borrowed from the middleware when it supports loaning, or taken from a pool
+ *        of messages whose data buffers keep their capacity, so that steady-state publishing does not allocate.
+ *        If an encoding is enabled, a reduced-bandwidth copy is published on "<topic>/encoded" while the topic itself keeps full fidelity.
+ * @note  Not thread-safe. Each instance must be used from a single thread.
+ */
+class CloudPublisher {
+public:
+  using Ptr = std::shared_ptr<CloudPublisher>;
+  using PointCloud2 = sensor_msgs::msg::PointCloud2;
+
+  CloudPublisher(rclcpp::Node& node, const std::string& topic, const rclcpp::QoS& qos, int pool_size = 4, const CloudEncoding& encoding = CloudEncoding());
+  ~CloudPublisher();
+
+  /// @brief Number of subscribers of the full-fidelity and encoded topics
+  size_t get_subscription_count() const { return pub->get_subscription_count() + encoded_subscription_count(); }
+
+  /// @brief Fill a message with "fill(PointCloud2&)" and publish it
+  template <typename Fill>
+  void publish(const Fill& fill) {
+    if (encoder && encoded_subscription_count()) {
+      // The encoded cloud is derived from the full-fidelity message
+      const auto msg = acquire();
+      fill(*msg);
+      if (transient_local || pub->get_subscription_count()) {
+        pub->publish(*msg);
+      }
+      publish_encoded(*msg);
+      return;
+    }
+
+    if (intra_process) {
+      auto msg = std::make_unique<PointCloud2>();
+      fill(*msg);
+      pub->publish(std::move(msg));
+      return;
+    }
+
+    if (pub->can_loan_messages()) {
+      auto loaned = pub->borrow_loaned_message();
+      fill(loaned.get());
+      pub->publish(std::move(loaned));
+      return;
+    }
+
+    const auto msg = acquire();
+    fill(*msg);
+    pub->publish(*msg);
+  }
+
+private:
+  struct TransportPublisher;
+
+  /// @brief Get a message that is not referenced by anyone else
+  std::shared_ptr<PointCloud2> acquire();
+
+  size_t encoded_subscription_count() const;
+  void publish_encoded(const PointCloud2& msg);
+
+private:
+  bool intra_process;
+  bool transient_local;
+  std::shared_ptr<rclcpp::Publisher<PointCloud2>> pub;
+
+  // Reduced-bandwidth output (published through point_cloud_transport if transport_pub is available, advertised on the first publish)
+  std::unique_ptr<CloudEncoder> encoder;
+  std::unique_ptr<PointCloud2> encoded_msg;
+  std::shared_ptr<rclcpp::Publisher<PointCloud2>> encoded_pub;
+  std::shared_ptr<TransportPublisher> transport_pub;
+
+  const size_t pool_size;
+  size_t cursor;
+  std::vector<std::shared_ptr<PointCloud2>> pool;
+};
+
+}  // namespace glim
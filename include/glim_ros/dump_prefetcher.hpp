@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+namespace glim {
+
+/**
+ * @brief Reads the files of a map dump into the page cache with a pool of threads.
+ *        Files are prefetched in the order the viewer loads them (top-level graph files, then submap directories in index order)
+ *        by mapping them and touching every page, so that the sequential loader of the viewer mostly hits the page cache.
+ *        Prefetching stops once max_bytes have been read because pages beyond the cap would likely be evicted before they are used.
+ */
+class DumpPrefetcher {
+public:
+  /// @param num_threads  Number of prefetch threads
+  /// @param max_bytes    Maximum number of bytes to prefetch (0 = half of the available memory)
+  DumpPrefetcher(const std::string& dump_path, int num_threads, size_t max_bytes);
+  ~DumpPrefetcher();
+
+  /// @brief Wait for prefetching to finish
+  void wait();
+
+  size_t num_files() const { return files.size(); }
+  size_t num_prefetched_files() const { return num_prefetched; }
+  size_t prefetched_bytes() const { return bytes_prefetched; }
+
+private:
+  struct File {
+    std::string path;
+    size_t size;
+  };
+
+  void prefetch_task();
+  bool prefetch(const File& file);
+
+private:
+  size_t max_bytes;
+  std::vector<File> files;
+
+  std::atomic_bool kill_switch;
+  std::atomic_size_t cursor;
+  std::atomic_size_t bytes_reserved;  // Bytes of the files claimed by the threads (for the cap)
+  std::atomic_size_t bytes_prefetched;
+  std::atomic_size_t num_prefetched;
+  std::atomic_int num_running;
+
+  std::chrono::steady_clock::time_point start_time;
+  std::vector<std::thread> threads;
+};
+
+}  // namespace glim
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <glim_ros/glim_ros.hpp>
+
+namespace glim {
+
+/**
+ * @brief Parameters for FlowController
+ */
+struct FlowControllerParams {
+  FlowControllerParams();
+
+  PipelineWorkload high_watermark;  ///< Input is blocked when any stage reaches its high watermark
+  PipelineWorkload low_watermark;   ///< Input is resumed when all the stages drain down to their low watermarks (clamped to >= 1)
+  double drain_timeout;             ///< Maximum time to wait for the pipeline to drain before resuming the input [sec]
+  double extension_wait_timeout;    ///< Maximum time to wait for extension modules requesting to wait [sec]
+  double report_interval;           ///< Throughput report interval [sec]
+};
+
+/**
+ * @brief Flow control for offline processing.
+ *        Blocks the input on high/low watermarks of the pipeline stage queues so that the input runs
+ *        at the maximum sustainable speed of the pipeline, and reports achieved vs sustainable throughput.
+ */
+class FlowController {
+public:
+  FlowController(const std::shared_ptr<GlimROS>& glim, const FlowControllerParams& params = FlowControllerParams());
+  ~FlowController();
+
+  /// @brief Notify that a points frame has been fed to the pipeline. Blocks while the pipeline is saturated.
+  void frame_inserted();
+
+  /// @brief Block while extension modules request the input to wait
+  void wait_extensions();
+
+  /// @brief Average number of frames fed to the pipeline per second
+  double average_throughput() const;
+
+  /// @brief Ratio of the time the input was blocked by the pipeline
+  double blocked_ratio() const;
+
+private:
+  static FlowControllerParams validate(FlowControllerParams params);
+  bool saturated(const PipelineWorkload& workload) const;
+  bool drained(const PipelineWorkload& workload) const;
+  void report(const PipelineWorkload& workload);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  const std::shared_ptr<GlimROS> glim;
+  const FlowControllerParams params;
+
+  size_t num_inserted;
+  Clock::duration blocked_time;
+  Clock::time_point t_begin;
+
+  // Statistics since the last report
+  Clock::time_point last_report_time;
+  size_t last_num_inserted;
+  size_t last_num_processed;
+  Clock::duration last_blocked_time;
+};
+
+}  // namespace glim
@@ -2,14 +2,24 @@
 
 #include <any>
 #include <deque>
+#include <mutex>
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <condition_variable>
 #include <rclcpp/rclcpp.hpp>
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
 
 #include <image_transport/image_transport.hpp>
 #include <sensor_msgs/msg/imu.hpp>
 #include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
 #include <sensor_msgs/msg/point_cloud2.hpp>
 #include <sensor_msgs/msg/joint_state.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <glim/util/raw_points.hpp>
+#include <glim_ros/imu_batch.hpp>
 
 namespace glim {
 class TimeKeeper;
@@ -20,6 +30,21 @@ class AsyncGlobalMapping;
 
 class ExtensionModule;
 class GenericTopicSubscription;
+class PointCloud2LayoutCache;
+class PipelineNotifier;
+class PipelineStats;
+class ImageDecoder;
+class SensorMergeQueue;
+class MapWriter;
+
+/**
+ * @brief Number of inputs waiting in each pipeline stage
+ */
+struct PipelineWorkload {
+  size_t odometry;        ///< Frames waiting for odometry estimation
+  size_t sub_mapping;     ///< Frames waiting for sub mapping
+  size_t global_mapping;  ///< Submaps waiting for global mapping
+};
 
 class GlimROS : public rclcpp::Node {
 public:
@@ -29,19 +54,60 @@ public:
   bool needs_wait();
   void timer_callback();
 
+  PipelineWorkload workload() const;
+  const std::shared_ptr<PipelineNotifier>& notifier() const { return pipeline_notifier; }
+  const std::shared_ptr<PipelineStats>& stats() const { return pipeline_stats; }
+
   void raw_odom_callback(const sensor_msgs::msg::JointState::SharedPtr msg);
   void imu_callback(const sensor_msgs::msg::Imu::SharedPtr msg);
   void image_callback(const sensor_msgs::msg::Image::ConstSharedPtr msg);
+  void compressed_image_callback(const sensor_msgs::msg::CompressedImage::ConstSharedPtr msg);
   size_t points_callback(const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
 
+  // Entry points for already decoded inputs (time offsets and the acc scale are applied as in the callbacks)
+  void insert_imu(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel);
+  void insert_image(double stamp, const cv::Mat& image);
+  RawPoints::Ptr extract_points(const sensor_msgs::msg::PointCloud2::ConstSharedPtr& msg);
+  size_t insert_raw_points(const RawPoints::Ptr& raw_points);
+
+  /// @brief True if any of the mapping stages consumes images (images need not be read nor decoded otherwise)
+  bool image_enabled() const { return image_to_odometry || image_to_sub_mapping || image_to_global_mapping; }
+
   void wait(bool auto_quit = false);
   void save(const std::string& path);
 
+  /// @brief Write a checkpoint of the mapping state into checkpoint_path (called periodically if checkpoint_interval > 0)
+  bool checkpoint();
+
   const std::vector<std::shared_ptr<GenericTopicSubscription>>& extension_subscriptions();
 
 private:
+  void subscribed_points_callback(const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
+  void subscribed_image_callback(double stamp, const cv::Mat& image);
+  void flush_imu_batch();
+  void insert_imu_batch(ImuBatch& batch);
+  size_t deliver_results();
+  void pipeline_task();
+  void stop_pipeline_thread();
+  void checkpoint_task(double interval);
+  void stop_checkpoint_thread();
+  void publish_stats();
+  void write_stats(const std::string& path) const;
+
+private:
+  std::mutex time_keeper_mutex;
   std::unique_ptr<glim::TimeKeeper> time_keeper;
   std::unique_ptr<glim::CloudPreprocessor> preprocessor;
+  std::unique_ptr<glim::CloudPreprocessor> coarse_preprocessor;  // Used while load shedding (coarser downsampling)
+  std::unique_ptr<glim::PointCloud2LayoutCache> points_layout;
+
+  // IMU samples accumulated by imu_callback until imu_batch_size samples, imu_batch_max_delay, or the next points frame
+  int imu_batch_size;
+  double imu_batch_max_delay;
+  std::mutex imu_batch_mutex;
+  ImuBatch imu_batch;
+  std::mutex imu_flush_mutex;  // Serializes flushes so that the batches reach the stages in order
+  ImuBatch imu_flushing;       // Batch being fanned out (guarded by imu_flush_mutex)
 
   std::shared_ptr<glim::AsyncOdometryEstimation> odometry_estimation;
   std::unique_ptr<glim::AsyncSubMapping> sub_mapping;
@@ -52,16 +118,68 @@ private:
   double points_time_offset;
   double acc_scale;
   bool dump_on_unload;
+  bool image_to_odometry;
+  bool image_to_sub_mapping;
+  bool image_to_global_mapping;
+  std::string dump_path;
+
+  // Saving
+  bool save_glim_dump;
+  bool save_parallel;
+  bool write_chunked_map;
+  std::shared_ptr<MapWriter> map_writer;
+
+  // Checkpointing
+  std::string checkpoint_path;
+  bool checkpoint_glim_dump;
+  std::mutex checkpoint_mutex;
+  std::condition_variable checkpoint_cv;
+  bool checkpoint_kill_switch;
+  std::thread checkpoint_thread;
+
+  // Event-driven result delivery
+  std::mutex results_mutex;
+  std::atomic_bool kill_switch;
+  std::thread pipeline_thread;
+  std::shared_ptr<PipelineNotifier> pipeline_notifier;
+  std::shared_ptr<std::atomic<std::int64_t>> pending_results;  // Results announced by the stage callbacks but not delivered yet
+
+  // Instrumentation
+  std::shared_ptr<PipelineStats> pipeline_stats;
+  mutable std::mutex stats_file_mutex;  // Serializes write_stats() (periodic stats and save() may target the same directory)
+  rclcpp::TimerBase::SharedPtr stats_timer;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub;
+
+  // Image decoding (destroyed before the modules it feeds)
+  std::unique_ptr<ImageDecoder> image_decoder;
+
+  // Load shedding of the subscribed inputs
+  int shedding_frame_skip;                                     // One of this many frames is kept while skipping frames
+  int shedding_image_queue_size;                               // Maximum number of deferred images (older ones are dropped)
+  size_t num_subscribed_frames;                                // Accessed only in the points callback
+  std::atomic<double> latest_input_stamp;                      // Stamp of the latest frame fed to odometry
+  std::shared_ptr<std::atomic<double>> latest_odometry_stamp;  // Stamp of the latest odometry output
+  std::deque<std::pair<double, cv::Mat>> deferred_images;      // Accessed only in the image decoder callback
+
+  // Sensor-time reordering of the subscribed streams (destroyed before the modules it feeds)
+  std::unique_ptr<SensorMergeQueue> merge_queue;
 
   // Extension modulles
   std::vector<std::shared_ptr<ExtensionModule>> extension_modules;
   std::vector<std::shared_ptr<GenericTopicSubscription>> extension_subs;
 
   // ROS-related
+  rclcpp::CallbackGroup::SharedPtr imu_callback_group;
+  rclcpp::CallbackGroup::SharedPtr points_callback_group;
+  rclcpp::CallbackGroup::SharedPtr image_callback_group;
+  rclcpp::CallbackGroup::SharedPtr raw_odom_callback_group;
+  rclcpp::CallbackGroup::SharedPtr timer_callback_group;
+
   rclcpp::TimerBase::SharedPtr timer;
   rclcpp::Subscription<sensor_msgs::msg::Imu>::SharedPtr imu_sub;
   rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr points_sub;
   image_transport::Subscriber image_sub;
+  rclcpp::Subscription<sensor_msgs::msg::CompressedImage>::SharedPtr compressed_image_sub;
   rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr raw_odom_sub;
 };
 
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <gtsam_points/types/point_cloud.hpp>
+
+namespace glim {
+
+/**
+ * @brief Global map cache parameters
+ */
+struct GlobalMapCacheParams {
+public:
+  GlobalMapCacheParams();
+
+  double voxel_resolution;       // Resolution of the per-submap voxel downsampling (<= 0 disables downsampling)
+  double translation_tolerance;  // Submaps are re-transformed only when their pose moves more than this [m]
+  double rotation_tolerance;     // Submaps are re-transformed only when their pose rotates more than this [rad]
+
+  size_t max_memory;      // Memory budget of the cache [bytes] (0 = unlimited)
+  std::string spill_dir;  // Directory to spill local points of least recently updated submaps to (empty = drop them).
+                          // Each cache uses its own subdirectory, which is removed when the cache is destroyed.
+};
+
+/**
+ * @brief Incrementally maintained global map built from voxel-downsampled submaps.
+ *        Each submap is downsampled once when it is inserted, and its world-frame points are
+ *        recomputed only when the submap pose is changed by the global optimization.
+ */
+class GlobalMapCache {
+public:
+  using Poses = std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d>>;
+
+  struct Submap {
+    double stamp;                                     // Stamp identifying the submap (first frame stamp)
+    Eigen::Isometry3d T_world_origin;                 // Pose used to compute world_points
+    size_t num_points;                                // Number of downsampled points
+    gtsam_points::PointCloud::ConstPtr local_points;  // Downsampled points in the submap origin frame (null if spilled)
+    std::vector<std::uint8_t> world_points;           // Downsampled points in the world frame packed as PointCloud2 data (float32 x, y, z)
+
+    size_t last_used;        // Logical time of the last insertion or update (for LRU eviction)
+    std::string spill_file;  // File holding the local points if spilled (float32 x, y, z)
+    bool evicted;            // World points are released and the submap is excluded from the map
+  };
+
+  GlobalMapCache(const GlobalMapCacheParams& params = GlobalMapCacheParams());
+  ~GlobalMapCache();
+
+  /// @brief Insert a new submap
+  void insert(double stamp, const gtsam_points::PointCloud::ConstPtr& points, const Eigen::Isometry3d& T_world_origin);
+
+  /// @brief Update submap poses (poses[i] corresponds to the i-th inserted submap)
+  /// @return Indices of submaps whose world points have been re-computed
+  std::vector<int> update_poses(const Poses& poses);
+
+  size_t size() const { return submaps.size(); }
+  bool can_spill() const { return !spill_path.empty(); }
+  size_t num_points() const { return total_num_points; }
+
+  /// @brief Memory used by the point data of the cache [bytes]
+  size_t memory_usage() const;
+
+  /// @brief Release memory of the least recently updated submaps until the usage is within max_bytes.
+  ///        Local points are spilled (or dropped) first, and world points are evicted only if allow_eviction is true.
+  void enforce_budget(size_t max_bytes, bool allow_eviction);
+  const Submap& submap(int i) const { return submaps[i]; }
+
+  /// @brief Indices of submaps changed since the last call (inserted or re-transformed)
+  std::vector<int> take_updated();
+
+  /// @brief World points of a submap as PointCloud2
+  void submap_to_pointcloud2(int i, const std::string& frame_id, sensor_msgs::msg::PointCloud2& msg) const;
+
+  /// @brief Concatenate the world points of all the submaps into PointCloud2 (no re-transformation)
+  void to_pointcloud2(const std::string& frame_id, double stamp, sensor_msgs::msg::PointCloud2& msg) const;
+
+private:
+  bool transform(Submap& submap) const;
+  void spill(int i);
+
+private:
+  const GlobalMapCacheParams params;
+  std::string spill_path;  // Per-instance subdirectory of spill_dir (empty if spilling is disabled)
+
+  size_t use_clock;
+  size_t total_num_points;
+  std::vector<Submap> submaps;
+  std::vector<bool> updated;
+};
+
+}  // namespace glim
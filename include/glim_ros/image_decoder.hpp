@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <opencv2/core.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
+
+namespace glim {
+
+/**
+ * @brief Decodes Image and CompressedImage messages into BGR8 cv::Mat on a pool of worker threads.
+ *        Decoded images are handed to the callback in the order the messages were submitted.
+ *        Compressed images are decoded directly into cv::Mat without the intermediate sensor_msgs::msg::Image.
+ */
+class ImageDecoder {
+public:
+  using Callback = std::function<void(double stamp, const cv::Mat& image)>;
+
+  /// @param num_threads     Number of decoding threads (0 = decode synchronously in submit())
+  /// @param max_queue_size  Messages submitted while this many are pending are dropped (bounds the added latency)
+  ImageDecoder(int num_threads, int max_queue_size, const Callback& callback);
+  ~ImageDecoder();
+
+  void submit(const sensor_msgs::msg::Image::ConstSharedPtr& msg);
+  void submit(const sensor_msgs::msg::CompressedImage::ConstSharedPtr& msg);
+
+  /// @brief Number of messages dropped because the decoders could not keep up
+  size_t num_dropped() const { return num_dropped_; }
+
+  /// @brief Decode a message into BGR8 (false on failure)
+  static bool decode(const sensor_msgs::msg::Image& msg, cv::Mat& image);
+  static bool decode(const sensor_msgs::msg::CompressedImage& msg, cv::Mat& image);
+
+private:
+  struct Task {
+    size_t seq;
+    sensor_msgs::msg::Image::ConstSharedPtr image;
+    sensor_msgs::msg::CompressedImage::ConstSharedPtr compressed_image;
+  };
+
+  void submit(Task&& task);
+  void decoding_task();
+  void emit_completed();
+
+private:
+  const int max_queue_size;
+  const Callback callback;
+
+  std::mutex mutex;
+  std::condition_variable task_submitted;
+
+  bool kill_switch;
+  size_t num_submitted;
+  size_t num_emitted;
+  std::atomic_size_t num_dropped_;
+  std::deque<Task> tasks;                                   // Tasks waiting for decoding
+  std::map<size_t, std::pair<double, cv::Mat>> completed;  // Decoded images waiting for their predecessors
+
+  std::mutex emit_mutex;  // Serializes the callback so that images are emitted in order
+  std::vector<std::thread> decoding_threads;
+};
+
+}  // namespace glim
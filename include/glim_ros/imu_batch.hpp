@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <Eigen/Core>
+
+namespace glim {
+
+/**
+ * @brief Contiguous batch of IMU samples (structure of arrays).
+ *        Buffers keep their capacity over clear() so that a reused batch does not allocate.
+ */
+struct ImuBatch {
+public:
+  size_t size() const { return stamps.size(); }
+  bool empty() const { return stamps.empty(); }
+
+  void reserve(size_t n) {
+    stamps.reserve(n);
+    linear_acc.reserve(n);
+    angular_vel.reserve(n);
+  }
+
+  void resize(size_t n) {
+    stamps.resize(n);
+    linear_acc.resize(n);
+    angular_vel.resize(n);
+  }
+
+  void clear() {
+    stamps.clear();
+    linear_acc.clear();
+    angular_vel.clear();
+  }
+
+  void swap(ImuBatch& other) {
+    stamps.swap(other.stamps);
+    linear_acc.swap(other.linear_acc);
+    angular_vel.swap(other.angular_vel);
+  }
+
+  void push_back(double stamp, const Eigen::Vector3d& acc, const Eigen::Vector3d& gyro) {
+    stamps.emplace_back(stamp);
+    linear_acc.emplace_back(acc);
+    angular_vel.emplace_back(gyro);
+  }
+
+public:
+  std::vector<double> stamps;                // Timestamps [sec]
+  std::vector<Eigen::Vector3d> linear_acc;   // Linear accelerations [m/s^2]
+  std::vector<Eigen::Vector3d> angular_vel;  // Angular velocities [rad/s]
+};
+
+}  // namespace glim
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace glim {
+
+/**
+ * @brief Lock-free latency histogram with logarithmic buckets (4 buckets per power of two, from 1 us to ~4.5 min).
+ *        record() can be called concurrently from any thread, and snapshots can be subtracted to get windowed statistics.
+ */
+class LatencyHistogram {
+public:
+  static constexpr int sub_buckets = 4;
+  static constexpr int num_octaves = 28;
+  static constexpr int num_buckets = 1 + sub_buckets * num_octaves;
+
+  /**
+   * @brief Histogram counts at a point in time
+   */
+  struct Snapshot {
+    Snapshot() : count(0), sum_ns(0), max_ns(0), window_max_ns(0) { counts.fill(0); }
+
+    /// @brief Statistics of the samples recorded between two snapshots.
+    ///        The max is the window max of the newer snapshot, which is exact if both were taken with take_window().
+    Snapshot operator-(const Snapshot& rhs) const {
+      Snapshot diff;
+      for (int i = 0; i < num_buckets; i++) {
+        diff.counts[i] = counts[i] - rhs.counts[i];
+      }
+      diff.count = count - rhs.count;
+      diff.sum_ns = sum_ns - rhs.sum_ns;
+      diff.max_ns = window_max_ns;
+      diff.window_max_ns = window_max_ns;
+      return diff;
+    }
+
+    /// @brief Mean latency [sec]
+    double mean() const { return count ? sum_ns * 1e-9 / count : 0.0; }
+
+    /// @brief Max latency [sec]
+    double max() const { return max_ns * 1e-9; }
+
+    /// @brief Approximated quantile (e.g., q = 0.99) [sec]
+    double quantile(double q) const {
+      if (!count) {
+        return 0.0;
+      }
+
+      const std::uint64_t rank = std::max<std::uint64_t>(1, std::ceil(q * count));
+      std::uint64_t accum = 0;
+      for (int i = 0; i < num_buckets; i++) {
+        accum += counts[i];
+        if (accum >= rank) {
+          return std::min(bucket_upper_bound(i), max());
+        }
+      }
+      return max();
+    }
+
+    std::array<std::uint64_t, num_buckets> counts;
+    std::uint64_t count;
+    std::uint64_t sum_ns;
+    std::uint64_t max_ns;         // Max since the start
+    std::uint64_t window_max_ns;  // Max since the previous take_window()
+  };
+
+  LatencyHistogram() : count(0), sum_ns(0), max_ns(0), window_max_ns(0) {
+    for (auto& bucket : buckets) {
+      bucket = 0;
+    }
+  }
+
+  void record(std::chrono::nanoseconds duration) {
+    const std::uint64_t ns = std::max<std::int64_t>(0, duration.count());
+    buckets[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(ns, std::memory_order_relaxed);
+
+    update_max(max_ns, ns);
+    update_max(window_max_ns, ns);
+  }
+
+  Snapshot snapshot() const {
+    Snapshot snapshot;
+    for (int i = 0; i < num_buckets; i++) {
+      snapshot.counts[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count = count.load(std::memory_order_relaxed);
+    snapshot.sum_ns = sum_ns.load(std::memory_order_relaxed);
+    snapshot.max_ns = max_ns.load(std::memory_order_relaxed);
+    snapshot.window_max_ns = window_max_ns.load(std::memory_order_relaxed);
+    return snapshot;
+  }
+
+  /// @brief Take a snapshot and start a new window (the window max is reset).
+  ///        Subtract the previous take_window() result to get the statistics of the window.
+  Snapshot take_window() {
+    Snapshot window = snapshot();
+    window.window_max_ns = window_max_ns.exchange(0, std::memory_order_relaxed);
+    return window;
+  }
+
+  /// @brief Bucket 0 holds samples below 1 us. Bucket 1 + 4 * e + m holds [2^e * (1 + m / 4), 2^e * (1 + (m + 1) / 4)) us
+  static int bucket_index(std::uint64_t ns) {
+    const double us = ns * 1e-3;
+    if (us < 1.0) {
+      return 0;
+    }
+
+    int exponent;
+    const double mantissa = std::frexp(us, &exponent);  // us = mantissa * 2^exponent, mantissa in [0.5, 1)
+    const int octave = exponent - 1;
+    if (octave >= num_octaves) {
+      return num_buckets - 1;
+    }
+
+    const int sub = static_cast<int>((mantissa * 2.0 - 1.0) * sub_buckets);
+    return 1 + octave * sub_buckets + sub;
+  }
+
+  /// @brief Upper bound of a bucket [sec]
+  static double bucket_upper_bound(int index) {
+    if (index == 0) {
+      return 1e-6;
+    }
+
+    const int octave = (index - 1) / sub_buckets;
+    const int sub = (index - 1) % sub_buckets;
+    return std::ldexp(1.0 + (sub + 1.0) / sub_buckets, octave) * 1e-6;
+  }
+
+private:
+  static void update_max(std::atomic_uint64_t& max, std::uint64_t ns) {
+    std::uint64_t current_max = max.load(std::memory_order_relaxed);
+    while (ns > current_max && !max.compare_exchange_weak(current_max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+private:
+  std::array<std::atomic_uint64_t, num_buckets> buckets;
+  std::atomic_uint64_t count;
+  std::atomic_uint64_t sum_ns;
+  std::atomic_uint64_t max_ns;
+  std::atomic_uint64_t window_max_ns;
+};
+
+}  // namespace glim
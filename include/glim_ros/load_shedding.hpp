@@ -0,0 +1,177 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace glim {
+
+/**
+ * @brief Load shedding levels. Each level includes the measures of the lower levels.
+ *        Measures that do not affect the estimation are applied first.
+ */
+enum class LoadSheddingLevel {
+  NONE = 0,           ///< Normal operation
+  PAUSE_VIEWER = 1,   ///< Viewers stop publishing point clouds
+  DEFER_IMAGES = 2,   ///< Images are held back and inserted once the backlog clears
+  COARSE_POINTS = 3,  ///< Points are preprocessed with a coarser downsampling resolution
+  SKIP_FRAMES = 4,    ///< Points frames are skipped
+};
+
+/**
+ * @brief Load shedding parameters
+ */
+struct LoadSheddingParams {
+  LoadSheddingParams()
+  : enabled(false),
+    high_workload(10),
+    low_workload(2),
+    high_latency(0.5),
+    low_latency(0.1),
+    escalate_interval(1.0),
+    restore_interval(3.0),
+    max_level(LoadSheddingLevel::SKIP_FRAMES) {}
+
+  bool enabled;                 ///< Enable load shedding (live operation only)
+  size_t high_workload;         ///< Overloaded if the odometry input queue reaches this size
+  size_t low_workload;          ///< Drained if the odometry input queue is within this size (and latency is within low_latency)
+  double high_latency;          ///< Overloaded if odometry lags behind the input by this time [sec]
+  double low_latency;           ///< Drained if the odometry lag is within this time [sec]
+  double escalate_interval;     ///< Minimum time between escalations [sec]
+  double restore_interval;      ///< Time the pipeline must stay drained before a level is restored [sec]
+  LoadSheddingLevel max_level;  ///< Highest level to escalate to
+};
+
+/**
+ * @brief Process-wide load shedding state for live operation.
+ *        GlimROS escalates the level while odometry falls behind the input and restores it step by step once the backlog clears.
+ *        Components (e.g., the viewer) query the level to reduce their work.
+ * @note  instance() is defined in the glim_ros library so that extension modules loaded as separate libraries share one instance
+ *        (an inline function-local static would be instantiated in every library that includes this header).
+ */
+class LoadShedding {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static LoadShedding& instance();
+
+  void set_params(const LoadSheddingParams& params) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->params = params;
+  }
+
+  bool enabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return params.enabled;
+  }
+
+  LoadSheddingLevel level() const { return level_; }
+
+  /// @brief True if the measure of the given level is active
+  bool active(LoadSheddingLevel measure) const { return static_cast<int>(level_.load()) >= static_cast<int>(measure); }
+
+  /// @brief Update the level with the current odometry backlog
+  /// @param workload  Number of frames in the odometry input queue
+  /// @param latency   Lag of the odometry output behind the latest input [sec]
+  /// @return          True if the level has been changed
+  bool update(size_t workload, double latency) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const LoadSheddingLevel current = level_;
+    if (!params.enabled) {
+      return false;
+    }
+
+    const auto now = Clock::now();
+    const bool overloaded = workload >= params.high_workload || latency >= params.high_latency;
+    const bool drained = workload <= params.low_workload && latency <= params.low_latency;
+    const double since_change = std::chrono::duration<double>(now - last_change).count();
+
+    if (!drained) {
+      last_overload = now;
+    }
+
+    if (overloaded && current < params.max_level && since_change >= params.escalate_interval) {
+      level_ = static_cast<LoadSheddingLevel>(static_cast<int>(current) + 1);
+      num_escalations_++;
+      last_change = now;
+    } else if (drained && current != LoadSheddingLevel::NONE && std::chrono::duration<double>(now - last_overload).count() >= params.restore_interval) {
+      level_ = static_cast<LoadSheddingLevel>(static_cast<int>(current) - 1);
+      num_restorations_++;
+      last_change = now;
+      // Restore the next level only after the pipeline stays drained at this level
+      last_overload = now;
+    }
+
+    if (current != LoadSheddingLevel::NONE) {
+      shed_time += now - last_update;
+    }
+    last_update = now;
+
+    return level_ != current;
+  }
+
+  /// @brief Count inputs dropped or deferred by the shedding measures (for reporting)
+  void count_skipped_frame() { num_skipped_frames_++; }
+  void count_deferred_image() { num_deferred_images_++; }
+  void count_dropped_image() { num_dropped_images_++; }
+
+  size_t num_escalations() const { return num_escalations_; }
+  size_t num_restorations() const { return num_restorations_; }
+  size_t num_skipped_frames() const { return num_skipped_frames_; }
+  size_t num_deferred_images() const { return num_deferred_images_; }
+  size_t num_dropped_images() const { return num_dropped_images_; }
+
+  /// @brief Total time spent at levels above NONE [sec]
+  double shedding_time() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::chrono::duration<double>(shed_time).count();
+  }
+
+  static const char* level_name(LoadSheddingLevel level) {
+    switch (level) {
+      case LoadSheddingLevel::NONE:
+        return "none";
+      case LoadSheddingLevel::PAUSE_VIEWER:
+        return "pause_viewer";
+      case LoadSheddingLevel::DEFER_IMAGES:
+        return "defer_images";
+      case LoadSheddingLevel::COARSE_POINTS:
+        return "coarse_points";
+      case LoadSheddingLevel::SKIP_FRAMES:
+        return "skip_frames";
+    }
+    return "unknown";
+  }
+
+private:
+  LoadShedding()
+  : level_(LoadSheddingLevel::NONE),
+    num_escalations_(0),
+    num_restorations_(0),
+    num_skipped_frames_(0),
+    num_deferred_images_(0),
+    num_dropped_images_(0),
+    last_change(Clock::now()),
+    last_overload(Clock::now()),
+    last_update(Clock::now()),
+    shed_time(0) {}
+
+private:
+  mutable std::mutex mutex;
+  LoadSheddingParams params;
+
+  std::atomic<LoadSheddingLevel> level_;
+  std::atomic_size_t num_escalations_;
+  std::atomic_size_t num_restorations_;
+  std::atomic_size_t num_skipped_frames_;
+  std::atomic_size_t num_deferred_images_;
+  std::atomic_size_t num_dropped_images_;
+
+  Clock::time_point last_change;
+  Clock::time_point last_overload;  // Last time the pipeline was not drained
+  Clock::time_point last_update;
+  Clock::duration shed_time;
+};
+
+}  // namespace glim
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <rclcpp/rclcpp.hpp>
+#include <glim_ros/srv/get_map_region.hpp>
+
+#include <glim/mapping/sub_map.hpp>
+#include <glim/util/extension_module_ros2.hpp>
+#include <glim_ros/tiled_map.hpp>
+
+namespace spdlog {
+class logger;
+}
+
+namespace glim {
+
+class CloudEncoder;
+class PeriodicTask;
+
+/**
+ * @brief Map server for large-scale global maps.
+ *        Submaps are kept in a TiledMap with precomputed levels of detail, and only the tiles touched by a new submap or
+ *        by a loop closure are rebuilt on the shared task scheduler.
+ *        Clients call the "~/get_map_region" service (glim_ros/srv/GetMapRegion) with a bounding box and a resolution,
+ *        and each client receives only the points of its own region.
+ */
+class MapServer : public ExtensionModuleROS2 {
+public:
+  MapServer();
+  ~MapServer();
+
+  virtual std::vector<GenericTopicSubscription::Ptr> create_subscriptions(rclcpp::Node& node) override;
+
+private:
+  using GetMapRegion = glim_ros::srv::GetMapRegion;
+
+  struct SubmapUpdate {
+    double stamp;
+    gtsam_points::PointCloud::ConstPtr points;
+    Eigen::Isometry3d T_world_origin;
+  };
+
+  // Called in the global mapping thread
+  void on_update_submaps(const std::vector<SubMap::Ptr>& submaps);
+
+  // Called in the ROS executor thread (map region service callback group)
+  void on_request(const GetMapRegion::Request::SharedPtr& request, const GetMapRegion::Response::SharedPtr& response);
+
+  // Called in the map server task
+  void update();
+
+private:
+  std::string map_frame_id;
+  size_t max_points;
+  int rebuild_threads;
+
+  // Inputs handed over to the map server task
+  std::mutex input_mutex;
+  std::vector<SubmapUpdate> new_submaps;
+  TiledMap::Poses latest_poses;
+
+  // Updated in the map server task and queried in the service callback
+  std::mutex map_mutex;
+  std::unique_ptr<TiledMap> map;
+
+  std::shared_ptr<PeriodicTask> update_task;
+  std::unique_ptr<CloudEncoder> region_encoder;  // Accessed only in the service callback group
+  rclcpp::Clock::SharedPtr clock;
+  rclcpp::CallbackGroup::SharedPtr service_group;
+  std::shared_ptr<rclcpp::Service<GetMapRegion>> region_service;
+
+  // Logging
+  std::shared_ptr<spdlog::logger> logger;
+};
+
+}  // namespace glim
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <Eigen/Geometry>
+#include <glim/mapping/sub_map.hpp>
+
+namespace glim {
+
+/**
+ * @brief MapWriter parameters
+ */
+struct MapWriterParams {
+public:
+  MapWriterParams();
+
+  int submaps_per_chunk;  // Number of submaps stored in a chunk file
+  int num_threads;        // Number of threads writing chunks in parallel
+  bool compress;          // Compress chunks with zlib (ignored if built without zlib)
+};
+
+/**
+ * @brief Incremental writer of a chunked map dump.
+ *        Submap points never change after a submap is created, so they are written only once (in the submap origin frame)
+ *        into chunk files, while the submap poses refined by the global optimization are kept in a small manifest.
+ *        Each save() encodes only the chunks that changed since the previous save to the same path (in parallel)
+ *        and then atomically replaces the manifest, so a save is cheap even for large maps and can be used as a checkpoint.
+ *        Chunks that are up to date in another path (e.g., the checkpoint) are hard-linked (or copied) instead of being encoded again,
+ *        so the final save after checkpoints only encodes the submaps added since the last checkpoint.
+ *        Points of submaps in a full chunk are released once the chunk is written, so the writer does not keep the whole map in memory.
+ *
+ *        Layout:
+ *          <path>/manifest.json        Chunk list and per-submap id, chunk, number of points, and T_world_origin
+ *          <path>/chunk_XXXXXX.bin     "GLIMCHNK", u32 version, u32 compressed, u64 raw size, u64 stored size, payload
+ *          payload (per submap)        i32 id, u32 flags (1 = intensities), u64 N, float32 xyz * N, [float32 intensity * N]
+ */
+class MapWriter {
+public:
+  MapWriter(const MapWriterParams& params = MapWriterParams());
+  ~MapWriter();
+
+  /// @brief Add a new submap (thread-safe)
+  void insert_submap(const SubMap::ConstPtr& submap);
+
+  /// @brief Update the submap poses (thread-safe)
+  void update_poses(const std::vector<SubMap::Ptr>& submaps);
+
+  size_t num_submaps() const;
+
+  /// @brief Write the chunks changed since the last save and the manifest into the directory
+  /// @return false if writing failed
+  bool save(const std::string& path);
+
+private:
+  struct Submap {
+    int id;
+    Eigen::Isometry3d T_world_origin;
+    size_t num_points;
+    gtsam_points::PointCloud::ConstPtr points;  // Released once the submap is written in a full chunk
+  };
+
+  struct Chunk {
+    std::string filename;
+    size_t num_submaps;  // Number of submaps stored in the written file (the last chunk may be partial)
+    size_t num_points;
+    size_t stored_bytes;
+  };
+
+  bool write_chunk(const std::string& path, size_t chunk_id, const std::vector<Submap>& submaps, Chunk& chunk) const;
+  bool link_chunk(const std::string& src_path, const std::string& dst_path, const Chunk& chunk) const;
+  bool write_manifest(const std::string& path, const std::vector<Submap>& submaps, const std::vector<Chunk>& chunks) const;
+
+private:
+  const MapWriterParams params;
+
+  mutable std::mutex mutex;
+  std::vector<Submap> submaps;
+  std::unordered_map<int, size_t> submap_index;  // Submap ID -> index in submaps
+
+  std::mutex save_mutex;                                              // Serializes save() calls
+  std::unordered_map<std::string, std::vector<Chunk>> saved_chunks;  // Canonical path -> chunks written there
+};
+
+}  // namespace glim
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+namespace glim {
+
+/**
+ * @brief Process-wide registry of memory usage reported by components (e.g., the viewer map cache),
+ *        and the memory budget components should respect.
+ * @note  instance() is defined in the glim_ros library so that extension modules loaded as separate libraries share one instance.
+ */
+class MemoryUsage {
+public:
+  static MemoryUsage& instance();
+
+  /// @brief Report the current memory usage of a component [bytes]
+  void report(const std::string& component, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    usages[component] = bytes;
+  }
+
+  /// @brief Memory usage of the reported components
+  std::vector<std::pair<std::string, size_t>> components() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<std::pair<std::string, size_t>>(usages.begin(), usages.end());
+  }
+
+  /// @brief Set the resident set size budget [bytes] (0 = unlimited)
+  void set_budget(size_t bytes) { budget_ = bytes; }
+  size_t budget() const { return budget_; }
+
+  /// @brief True if the resident set size exceeds the budget (components should release memory)
+  bool over_budget() const {
+    const size_t budget = budget_;
+    return budget && resident_set_size() > budget;
+  }
+
+  /// @brief Resident set size of the process [bytes]
+  static size_t resident_set_size() {
+    std::FILE* fp = std::fopen("/proc/self/statm", "r");
+    if (!fp) {
+      return 0;
+    }
+
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    const int num_read = std::fscanf(fp, "%lu %lu", &size, &resident);
+    std::fclose(fp);
+    return num_read == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+  }
+
+private:
+  MemoryUsage() : budget_(0) {}
+
+private:
+  mutable std::mutex mutex;
+  std::map<std::string, size_t> usages;
+  std::atomic_size_t budget_;
+};
+
+}  // namespace glim
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+
+namespace glim {
+
+/**
+ * @brief Event counter to wake up threads waiting for new outputs of the pipeline stages
+ */
+class PipelineNotifier {
+public:
+  PipelineNotifier() : generation_(0) {}
+
+  /// @brief Signal that a pipeline stage produced new results
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      generation_++;
+    }
+    cv.notify_all();
+  }
+
+  /// @brief Number of notifications so far
+  std::uint64_t generation() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return generation_;
+  }
+
+  /// @brief Wait for a notification issued after generation "since"
+  /// @return Current generation (equals "since" on timeout)
+  template <typename Rep, typename Period>
+  std::uint64_t wait(std::uint64_t since, const std::chrono::duration<Rep, Period>& timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait_for(lock, timeout, [&] { return generation_ != since; });
+    return generation_;
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  std::uint64_t generation_;
+};
+
+}  // namespace glim
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <glim_ros/latency_histogram.hpp>
+
+namespace glim {
+
+/**
+ * @brief Instrumented stages of the GLIM pipeline
+ */
+enum class PipelineStage {
+  EXTRACT,               ///< PointCloud2 to RawPoints conversion
+  TIME_KEEPER,           ///< TimeKeeper::process
+  PREPROCESS,            ///< CloudPreprocessor::preprocess
+  ODOMETRY_QUEUE,        ///< Odometry input queue (insert_frame -> start of odometry estimation)
+  ODOMETRY,              ///< Odometry estimation of a frame
+  SUB_MAPPING_QUEUE,     ///< Sub mapping input queue (marginalized frame -> start of sub mapping)
+  SUB_MAPPING,           ///< Sub mapping of the frame that completes a submap
+  GLOBAL_MAPPING_QUEUE,  ///< Global mapping input queue (new submap -> start of global mapping)
+  GLOBAL_MAPPING,        ///< Global mapping of a submap
+  NUM_STAGES
+};
+
+/**
+ * @brief Per-stage latency histograms and throughput of the pipeline
+ * @note  Histograms are lock-free. Latencies spanning threads (begin/end) are paired through a small mutex-protected queue per stage.
+ */
+class PipelineStats {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr int num_stages = static_cast<int>(PipelineStage::NUM_STAGES);
+
+  /**
+   * @brief Statistics of a stage
+   */
+  struct StageSummary {
+    std::string name;
+    std::uint64_t count;  // Number of samples
+    double rate;          // Samples per second
+    double mean;          // [sec]
+    double p50;           // [sec]
+    double p99;           // [sec]
+    double max;           // [sec]
+  };
+
+  PipelineStats();
+  ~PipelineStats();
+
+  static const char* stage_name(PipelineStage stage);
+
+  /// @brief Record a latency measured in a single thread
+  void record(PipelineStage stage, std::chrono::nanoseconds duration) { histograms[static_cast<int>(stage)].record(duration); }
+
+  /// @brief Mark the beginning of a stage for an input identified by key (e.g., frame stamp, submap ID)
+  void begin(PipelineStage stage, double key);
+
+  /// @brief Record the latency of the stage since begin() with the same key (older pending keys are discarded)
+  void end(PipelineStage stage, double key);
+
+  /// @brief Record the latency of the stage since the latest begin() (pending keys are discarded)
+  void end_latest(PipelineStage stage);
+
+  /// @brief Statistics since the previous window() call
+  std::vector<StageSummary> window();
+
+  /// @brief Statistics since the start
+  std::vector<StageSummary> total() const;
+
+  /// @brief Human-readable table of the given statistics
+  static std::string format(const std::vector<StageSummary>& summaries);
+
+private:
+  std::vector<StageSummary> summarize(const std::array<LatencyHistogram::Snapshot, num_stages>& snapshots, double duration) const;
+
+private:
+  const Clock::time_point t0;
+  std::array<LatencyHistogram, num_stages> histograms;
+
+  struct Pending {
+    std::mutex mutex;
+    std::deque<std::pair<double, Clock::time_point>> queue;
+  };
+  std::array<Pending, num_stages> pending;
+
+  std::mutex window_mutex;
+  Clock::time_point last_window_time;
+  std::array<LatencyHistogram::Snapshot, num_stages> last_window;
+};
+
+}  // namespace glim
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <gtsam_points/types/point_cloud.hpp>
+
+namespace glim {
+
+/**
+ * @brief Float32 PointCloud2 layout (x, y, z[, t][, intensity]) shared with glim::frame_to_pointcloud2
+ */
+struct PointCloud2Packing {
+  PointCloud2Packing(bool with_times, bool with_intensities)
+  : with_times(with_times),
+    with_intensities(with_intensities),
+    point_step(sizeof(float) * (3 + with_times + with_intensities)) {}
+
+  const bool with_times;
+  const bool with_intensities;
+  const std::uint32_t point_step;
+};
+
+/// @brief Set up the header, fields, and a data buffer sized for num_points (the buffer is left uninitialized)
+/// @note  The capacity of the data buffer is reused when the message is recycled
+void init_pointcloud2(const std::string& frame_id, double stamp, size_t num_points, const PointCloud2Packing& packing, sensor_msgs::msg::PointCloud2& msg);
+
+/// @brief Create a PointCloud2 message initialized with init_pointcloud2
+sensor_msgs::msg::PointCloud2::SharedPtr create_pointcloud2(const std::string& frame_id, double stamp, size_t num_points, const PointCloud2Packing& packing);
+
+/// @brief Transform points and write them as float32 into a buffer with the given packing
+/// @note  Uses Eigen vectorization for the transformation and splits large clouds over OpenMP threads
+/// @param parallel  Allow splitting over OpenMP threads (disable in callers that are already parallelized, e.g., on the TaskScheduler)
+void transform_and_pack(const Eigen::Isometry3d& T, const gtsam_points::PointCloud& frame, const PointCloud2Packing& packing, std::uint8_t* data, bool parallel = true);
+
+/// @brief Transform a frame and convert it into PointCloud2 in a single pass
+void transform_to_pointcloud2(const std::string& frame_id, double stamp, const Eigen::Isometry3d& T, const gtsam_points::PointCloud& frame, sensor_msgs::msg::PointCloud2& msg);
+sensor_msgs::msg::PointCloud2::SharedPtr transform_to_pointcloud2(const std::string& frame_id, double stamp, const Eigen::Isometry3d& T, const gtsam_points::PointCloud& frame);
+
+}  // namespace glim
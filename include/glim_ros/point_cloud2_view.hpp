@@ -0,0 +1,112 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <Eigen/Core>
+
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <glim/util/raw_points.hpp>
+
+namespace glim {
+
+/**
+ * @brief Accessor of a scalar PointCloud2 field (offset and type conversion resolved once)
+ */
+struct PointCloud2Field {
+  PointCloud2Field() : offset(-1), datatype(0), scale(1.0), read(nullptr) {}
+
+  bool valid() const { return offset >= 0 && read; }
+  double operator()(const std::uint8_t* point) const { return scale * read(point + offset); }
+
+  int offset;                               // Byte offset in a point
+  std::uint8_t datatype;                    // sensor_msgs::msg::PointField datatype
+  double scale;                             // Scale applied to read values (e.g., 1e-9 for nanosec timestamps)
+  double (*read)(const std::uint8_t* ptr);  // Read a value of datatype as double
+};
+
+/**
+ * @brief Field layout of PointCloud2 messages.
+ *        The layout is resolved once and reused for subsequent messages as long as their fields do not change.
+ *        Supports the layouts of common LiDAR drivers (Ouster, Livox, Velodyne, Hesai, ...).
+ */
+struct PointCloud2Layout {
+  using ConstPtr = std::shared_ptr<const PointCloud2Layout>;
+
+  /// @brief Resolve the field layout of a message
+  static ConstPtr resolve(const sensor_msgs::msg::PointCloud2& msg, const std::string& intensity_channel = "intensity");
+
+  /// @brief Check if the layout is still valid for the message
+  bool matches(const sensor_msgs::msg::PointCloud2& msg) const;
+
+public:
+  std::uint32_t point_step;
+  std::vector<sensor_msgs::msg::PointField> fields;  // Fields the layout was resolved from
+
+  bool supported;     // If false, the layout cannot be read by PointCloud2View (e.g., big endian, integer coordinates, color fields)
+  bool packed_xyz;    // x, y, z are consecutive FLOAT32 values
+  PointCloud2Field x;
+  PointCloud2Field y;
+  PointCloud2Field z;
+  PointCloud2Field time;
+  PointCloud2Field intensity;
+};
+
+/**
+ * @brief Caches the layout of a topic and re-resolves it only when the message fields change
+ */
+class PointCloud2LayoutCache {
+public:
+  PointCloud2LayoutCache(const std::string& intensity_channel = "intensity") : intensity_channel(intensity_channel) {}
+
+  const PointCloud2Layout& get(const sensor_msgs::msg::PointCloud2& msg);
+
+private:
+  const std::string intensity_channel;
+  PointCloud2Layout::ConstPtr layout;
+};
+
+/**
+ * @brief Strided read-only view over the data buffer of a PointCloud2 message (no copy).
+ * @note  The message (e.g., an intra-process ConstSharedPtr or a loaned message) must outlive the view.
+ */
+class PointCloud2View {
+public:
+  PointCloud2View(const sensor_msgs::msg::PointCloud2& msg, const PointCloud2Layout& layout)
+  : layout(layout),
+    data(msg.data.data()),
+    num_points(static_cast<size_t>(msg.width) * msg.height),
+    stamp(msg.header.stamp.sec + msg.header.stamp.nanosec / 1e9) {}
+
+  size_t size() const { return num_points; }
+  bool has_times() const { return layout.time.valid(); }
+  bool has_intensities() const { return layout.intensity.valid(); }
+
+  const std::uint8_t* at(size_t i) const { return data + layout.point_step * i; }
+
+  Eigen::Vector4d point(size_t i) const {
+    const std::uint8_t* pt = at(i);
+    if (layout.packed_xyz) {
+      float xyz[3];
+      std::memcpy(xyz, pt + layout.x.offset, sizeof(float) * 3);
+      return Eigen::Vector4d(xyz[0], xyz[1], xyz[2], 1.0);
+    }
+    return Eigen::Vector4d(layout.x(pt), layout.y(pt), layout.z(pt), 1.0);
+  }
+
+  double time(size_t i) const { return layout.time(at(i)); }
+  double intensity(size_t i) const { return layout.intensity(at(i)); }
+
+  /// @brief Copy points into a RawPoints in a single pass (non-finite points are skipped)
+  RawPoints::Ptr to_raw_points() const;
+
+public:
+  const PointCloud2Layout& layout;
+  const std::uint8_t* data;
+  const size_t num_points;
+  const double stamp;
+};
+
+}  // namespace glim
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+namespace glim {
+
+/**
+ * @brief Pose sample of the IMU frame in the map frame
+ */
+struct PoseSample {
+  double stamp;                // [sec]
+  double anchor_stamp;         // Stamp of the odometry estimate the sample is propagated from [sec]
+  double position[3];          // [m]
+  double orientation[4];       // Quaternion (x, y, z, w)
+  double linear_velocity[3];   // In the map frame [m/s]
+  double angular_velocity[3];  // In the IMU frame (bias compensated) [rad/s]
+};
+
+/**
+ * @brief Seqlock-protected slot holding the latest pose sample.
+ *        A single writer never waits for readers, and readers retry only while a write is in progress.
+ *        The slot is trivially copyable and has a fixed layout so that it can be placed in POSIX shared memory.
+ */
+struct PoseSlot {
+  static constexpr std::uint64_t magic_number = 0x45534f504d494c47ull;  // "GLIMPOSE"
+
+  /// @brief Publish a sample (single writer)
+  void write(const PoseSample& new_sample) {
+    const std::uint64_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);  // Odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(static_cast<void*>(&sample), &new_sample, sizeof(PoseSample));
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  /// @brief Read the latest sample without blocking the writer
+  /// @return False if no sample has been written yet or the slot kept being written for max_retries attempts
+  bool read(PoseSample& out, int max_retries = 1000) const {
+    for (int i = 0; i < max_retries; i++) {
+      const std::uint64_t seq0 = sequence.load(std::memory_order_acquire);
+      if (seq0 & 1) {
+        continue;
+      }
+
+      std::memcpy(&out, static_cast<const void*>(&sample), sizeof(PoseSample));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == seq0) {
+        return seq0 != 0;
+      }
+    }
+    return false;
+  }
+
+  /// @brief Number of samples written so far
+  std::uint64_t count() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+  std::uint64_t magic;
+  std::atomic<std::uint64_t> sequence;
+  PoseSample sample;
+};
+
+/**
+ * @brief PoseSlot mapped from a POSIX shared memory object (e.g., "/glim_pose") for consumers in other processes
+ */
+class SharedPoseSlot {
+public:
+  /// @param create  Create (and initialize) the shared memory object (writer side) or open an existing one (reader side)
+  SharedPoseSlot(const std::string& name, bool create);
+  ~SharedPoseSlot();
+
+  /// @brief Mapped slot (nullptr if the shared memory could not be opened)
+  PoseSlot* slot() const { return slot_; }
+
+private:
+  const std::string name;
+  const bool owner;
+  PoseSlot* slot_;
+};
+
+}  // namespace glim
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <rclcpp/rclcpp.hpp>
+#include <nav_msgs/msg/odometry.hpp>
+
+#include <glim/odometry/estimation_frame.hpp>
+#include <glim/mapping/sub_map.hpp>
+#include <glim/util/extension_module_ros2.hpp>
+#include <glim_ros/pose_slot.hpp>
+
+namespace spdlog {
+class logger;
+}
+
+namespace glim {
+
+class TrajectoryManager;
+class PeriodicTask;
+
+/**
+ * @brief IMU-rate pose output decoupled from the LiDAR rate.
+ *        The latest odometry estimate is used as an anchor and IMU samples received after it are forward-integrated on top of it.
+ *        Each propagated pose is written to a seqlock-protected PoseSlot (optionally in POSIX shared memory) directly in the odometry thread,
+ *        and published as nav_msgs/Odometry on "~/imu_rate_odom" from the shared task scheduler so that publishing never blocks odometry estimation.
+ */
+class PoseStreamer : public ExtensionModuleROS2 {
+public:
+  PoseStreamer();
+  ~PoseStreamer();
+
+  virtual std::vector<GenericTopicSubscription::Ptr> create_subscriptions(rclcpp::Node& node) override;
+
+  /// @brief Latest propagated pose (readable from any thread without blocking the odometry thread)
+  const PoseSlot& latest() const { return *slot; }
+
+private:
+  struct ImuSample {
+    double stamp;
+    Eigen::Vector3d linear_acc;
+    Eigen::Vector3d angular_vel;
+  };
+
+  // Called in the odometry thread
+  void on_insert_imu(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel);
+  void on_new_frame(const EstimationFrame::ConstPtr& frame);
+  void propagate(const ImuSample& imu);
+  void write_pose();
+
+  // Called in the global mapping thread
+  void on_update_submaps(const std::vector<SubMap::Ptr>& submaps);
+
+  void publish_latest();
+
+private:
+  double gravity;
+  double max_propagation;  // Samples are not propagated further than this from the anchor [sec]
+  std::string map_frame_id;
+  std::string imu_frame_id;
+
+  // Propagation state (accessed only in the odometry thread)
+  bool anchored;
+  double anchor_stamp;
+  double state_stamp;
+  Eigen::Isometry3d T_odom_imu;
+  Eigen::Vector3d v_odom_imu;
+  Eigen::Vector3d angular_vel;
+  Eigen::Matrix<double, 6, 1> imu_bias;
+  Eigen::Isometry3d T_world_odom;
+  std::deque<ImuSample> imu_buffer;  // IMU samples newer than the anchor
+
+  std::mutex trajectory_mutex;
+  std::unique_ptr<TrajectoryManager> trajectory;
+
+  std::unique_ptr<PoseSlot> local_slot;
+  std::unique_ptr<SharedPoseSlot> shared_slot;
+  PoseSlot* slot;
+
+  std::uint64_t last_published;  // Accessed only in the publish task
+  std::atomic_bool publishing;   // publish_task and odom_pub are created
+  std::shared_ptr<PeriodicTask> publish_task;
+  std::shared_ptr<rclcpp::Publisher<nav_msgs::msg::Odometry>> odom_pub;
+
+  // Logging
+  std::shared_ptr<spdlog::logger> logger;
+};
+
+}  // namespace glim
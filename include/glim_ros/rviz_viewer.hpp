@@ -2,7 +2,6 @@
 
 #include <any>
 #include <atomic>
-#include <thread>
 #include <chrono>
 
 #include <rclcpp/rclcpp.hpp>
@@ -18,6 +17,7 @@
 #include <glim/mapping/sub_map.hpp>
 #include <glim/util/extension_module.hpp>
 #include <glim/util/extension_module_ros2.hpp>
+#include <glim_ros/spsc_queue.hpp>
 
 namespace spdlog {
 class logger;
@@ -26,6 +26,9 @@ class logger;
 namespace glim {
 
 class TrajectoryManager;
+class GlobalMapCache;
+class CloudPublisher;
+class PeriodicTask;
 
 /**
  * @brief Rviz-based viewer
@@ -40,20 +43,41 @@ public:
 private:
   void set_callbacks();
   void odometry_new_frame(const EstimationFrame::ConstPtr& new_frame, bool corrected);
+  void publish_frame(const EstimationFrame::ConstPtr& new_frame, bool corrected, bool publish_clouds);
+  void process_frame_queue();
   void globalmap_on_update_submaps(const std::vector<SubMap::Ptr>& submaps);
   void invoke(const std::function<void()>& task);
 
   void spin_once();
 
 private:
-  std::atomic_bool kill_switch;
-  std::thread thread;
+  // Odometry frame passed from the odometry thread to the viewer thread
+  struct FrameTask {
+    size_t seq;
+    EstimationFrame::ConstPtr frame;
+    bool corrected;
+    bool publish_clouds;
+  };
+
+  std::shared_ptr<PeriodicTask> spin_task;  // spin_once() on the shared task scheduler
+  std::atomic_bool publishers_ready;        // Set at the end of create_subscriptions() (spin_once() does nothing until then)
+
+  int cloud_queue_size;                                // Number of latest frames per topic whose clouds are published (older ones are dropped)
+  size_t frame_seq;                                    // Accessed only in the odometry thread
+  std::unique_ptr<SPSCQueue<FrameTask>> frame_queue;  // Odometry thread -> viewer thread
+  std::mutex frame_overflow_mutex;
+  std::atomic_size_t num_frame_overflow;
+  std::vector<FrameTask> frame_overflow;               // Frames pushed while frame_queue is full (never dropped)
+  std::vector<FrameTask> frame_batch;
 
   std::unique_ptr<tf2_ros::Buffer> tf_buffer;
   std::unique_ptr<tf2_ros::TransformListener> tf_listener;
   std::unique_ptr<tf2_ros::TransformBroadcaster> tf_broadcaster;
 
   rclcpp::Time last_globalmap_pub_time;
+  double globalmap_pub_interval;
+  bool globalmap_changed;
+  bool globalmap_budget_warned;  // Warned about the memory budget without a spill directory (until the usage is back within the budget)
 
   std::string imu_frame_id;
   std::string lidar_frame_id;
@@ -63,15 +87,16 @@ private:
   bool publish_imu2lidar;
   double tf_time_offset;
 
-  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> points_pub;
-  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> aligned_points_pub;
-  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> map_pub;
+  std::shared_ptr<CloudPublisher> points_pub;
+  std::shared_ptr<CloudPublisher> aligned_points_pub;
+  std::shared_ptr<CloudPublisher> map_pub;
+  std::shared_ptr<CloudPublisher> map_updates_pub;
 
   std::shared_ptr<rclcpp::Publisher<nav_msgs::msg::Odometry>> odom_pub;
   std::shared_ptr<rclcpp::Publisher<geometry_msgs::msg::PoseStamped>> pose_pub;
 
-  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> points_corrected_pub;
-  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> aligned_points_corrected_pub;
+  std::shared_ptr<CloudPublisher> points_corrected_pub;
+  std::shared_ptr<CloudPublisher> aligned_points_corrected_pub;
 
   std::shared_ptr<rclcpp::Publisher<nav_msgs::msg::Odometry>> odom_corrected_pub;
   std::shared_ptr<rclcpp::Publisher<geometry_msgs::msg::PoseStamped>> pose_corrected_pub;
@@ -79,7 +104,7 @@ private:
   std::mutex trajectory_mutex;
   std::unique_ptr<TrajectoryManager> trajectory;
 
-  std::vector<gtsam_points::PointCloud::ConstPtr> submaps;
+  std::unique_ptr<GlobalMapCache> globalmap;
 
   std::mutex invoke_queue_mutex;
   std::vector<std::function<void()>> invoke_queue;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
+#include <glim/util/raw_points.hpp>
+
+namespace glim {
+
+/**
+ * @brief Reorders IMU, points and image inputs from independent subscriptions by sensor time.
+ *        Inputs are released to the callbacks in sensor-time order on a dedicated delivery thread.
+ *        A points frame is keyed on its scan end and released as soon as an IMU sample covering the scan end has arrived,
+ *        or when it has been held for max_latency (e.g., the IMU stream stalls).
+ *        IMU samples and images are held only while a preceding frame is waiting for IMU coverage.
+ */
+class SensorMergeQueue {
+public:
+  using Clock = std::chrono::steady_clock;
+  using ImuCallback = std::function<void(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel)>;
+  using PointsCallback = std::function<void(const RawPoints::Ptr& raw_points)>;
+  using ImageCallback = std::function<void(double stamp, const cv::Mat& image)>;
+
+  /// @param max_latency         Maximum time an input is held waiting for IMU coverage [sec]
+  /// @param imu_time_offset     Offset added to IMU stamps to obtain the sensor time (the callbacks receive the original stamps)
+  /// @param points_time_offset  Offset added to points stamps to obtain the sensor time
+  SensorMergeQueue(
+    double max_latency,
+    double imu_time_offset,
+    double points_time_offset,
+    const ImuCallback& imu_callback,
+    const PointsCallback& points_callback,
+    const ImageCallback& image_callback);
+  ~SensorMergeQueue();
+
+  void push_imu(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel);
+  void push_points(const RawPoints::Ptr& raw_points);
+  void push_image(double stamp, const cv::Mat& image);
+
+  /// @brief Release all the held inputs and block until they are delivered
+  void flush();
+
+  /// @brief Number of inputs held in the queue
+  size_t size() const;
+
+  /// @brief Number of frames released after max_latency without IMU coverage
+  size_t num_expired() const { return num_expired_; }
+
+  /// @brief Number of inputs that arrived after later inputs of the same kind had already been released
+  size_t num_late() const { return num_late_; }
+
+private:
+  struct Input {
+    Clock::time_point deadline;  // Release time regardless of IMU coverage
+    double stamp;                // Original stamp passed to the callback
+    Eigen::Vector3d linear_acc;
+    Eigen::Vector3d angular_vel;
+    RawPoints::Ptr raw_points;
+    cv::Mat image;
+  };
+
+  void delivery_task();
+  bool releasable(const Input& input, double key, Clock::time_point now) const;
+  void deliver(const Input& input);
+
+private:
+  const Clock::duration max_latency;
+  const double imu_time_offset;
+  const double points_time_offset;
+  const ImuCallback imu_callback;
+  const PointsCallback points_callback;
+  const ImageCallback image_callback;
+
+  mutable std::mutex mutex;
+  std::condition_variable input_pushed;
+  std::condition_variable delivered;
+
+  bool kill_switch;
+  bool flush_request;
+  size_t num_delivering;
+  double imu_watermark;                 // Latest IMU sensor time received
+  double last_released_imu;             // Latest IMU sensor time released
+  double last_released_points;          // Latest scan end released
+  std::multimap<double, Input> inputs;  // Held inputs keyed on sensor time (scan end for points)
+
+  std::atomic_size_t num_expired_;
+  std::atomic_size_t num_late_;
+  std::thread delivery_thread;
+};
+
+}  // namespace glim
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace glim {
+
+/**
+ * @brief Bounded lock-free single-producer single-consumer queue
+ * @note  try_push must be called from only one thread, and try_pop from only one (other) thread
+ */
+template <typename T>
+class SPSCQueue {
+public:
+  /// @param capacity  Maximum number of elements (rounded up to a power of two)
+  explicit SPSCQueue(size_t capacity) : buffer(round_up(capacity)), mask(buffer.size() - 1), head(0), tail(0) {}
+
+  size_t capacity() const { return buffer.size(); }
+
+  /// @brief Approximate number of elements
+  size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+  /// @brief Push an element (producer thread)
+  /// @return false if the queue is full
+  bool try_push(T value) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) >= buffer.size()) {
+      return false;
+    }
+
+    buffer[t & mask] = std::move(value);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief Pop an element (consumer thread)
+  /// @return false if the queue is empty
+  bool try_pop(T& value) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    // Move out so that the slot does not keep the element (e.g., a shared_ptr) alive
+    value = std::move(buffer[h & mask]);
+    buffer[h & mask] = T();
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static size_t round_up(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+private:
+  std::vector<T> buffer;
+  const size_t mask;
+
+  alignas(64) std::atomic_size_t head;  // Next slot to pop (written by the consumer)
+  alignas(64) std::atomic_size_t tail;  // Next slot to push (written by the producer)
+};
+
+}  // namespace glim
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sensor_msgs/msg/imu.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <glim_ros/point_cloud2_view.hpp>
+
+namespace glim {
+
+/**
+ * @brief StreamValidator parameters
+ */
+struct StreamValidatorParams {
+public:
+  StreamValidatorParams();
+
+  double min_range;          // Points closer than this are counted as out of range [m]
+  double max_range;          // Points farther than this are counted as out of range [m]
+  double imu_gap_factor;     // IMU intervals longer than this factor times the mean interval are counted as gaps
+  double max_acc_norm_diff;  // Warn if the mean acceleration norm differs from gravity more than this [m/s^2]
+};
+
+/**
+ * @brief Rolling statistics of a sensor stream (reset by StreamValidator::take_window())
+ */
+struct StreamStats {
+public:
+  StreamStats();
+
+  size_t num_messages;
+  size_t num_stamp_errors;  // Messages whose stamp did not increase
+  size_t num_intervals;     // Number of valid intervals in the window
+  double min_interval;      // Message interval statistics [sec]
+  double max_interval;
+  double sum_interval;
+  double sum_sq_interval;
+  double first_stamp;       // Stamps of the first and the last messages in the window [sec]
+  double last_stamp;
+
+  // Point cloud checks
+  size_t num_points;
+  size_t num_non_finite;        // Points with NaN/Inf coordinates
+  size_t num_out_of_range;      // Finite points outside [min_range, max_range]
+  size_t num_time_disorder;     // Points whose per-point time is smaller than that of the previous point
+  size_t num_without_times;     // Clouds without per-point times
+  size_t num_unsupported;       // Clouds whose layout cannot be validated in place
+  double max_scan_duration;     // Maximum per-point time span in a cloud [sec]
+
+  // IMU checks
+  size_t num_imu_gaps;          // Intervals longer than imu_gap_factor * mean interval
+  size_t num_imu_non_finite;    // Samples with NaN/Inf values
+  double sum_acc_norm;
+
+  double rate() const;       // Message rate [Hz]
+  double mean_interval() const;
+  double jitter() const;     // Standard deviation of the message interval [sec]
+};
+
+/**
+ * @brief Low-overhead validator of IMU and point cloud streams.
+ *        Point clouds are checked directly on the message buffer (no conversion into RawPoints),
+ *        and packed float32 coordinates are checked with vectorized Eigen expressions.
+ */
+class StreamValidator {
+public:
+  StreamValidator(const StreamValidatorParams& params = StreamValidatorParams());
+  ~StreamValidator();
+
+  void validate(const sensor_msgs::msg::Imu& msg);
+  void validate(const sensor_msgs::msg::PointCloud2& msg);
+
+  /// @brief Get the statistics accumulated since the last call and start a new window
+  void take_window(StreamStats& imu, StreamStats& points);
+
+  /// @brief Human-readable warnings for the statistics
+  std::vector<std::string> warnings(const StreamStats& imu, const StreamStats& points) const;
+
+private:
+  void update_interval(StreamStats& stats, double stamp, double& last_stamp);
+  void validate_coordinates(const PointCloud2View& view);
+  void validate_times(const PointCloud2View& view);
+
+private:
+  const StreamValidatorParams params;
+  PointCloud2LayoutCache layout_cache;
+
+  double last_imu_stamp;
+  double last_points_stamp;
+  double imu_mean_interval;  // Running estimate used to detect gaps
+
+  StreamStats imu_stats;
+  StreamStats points_stats;
+};
+
+}  // namespace glim
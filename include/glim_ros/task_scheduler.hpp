@@ -0,0 +1,135 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace glim {
+
+/**
+ * @brief Priority of tasks run on the shared TaskScheduler (ready tasks of higher priorities are run first)
+ */
+enum class TaskPriority { HIGH = 0, NORMAL = 1, LOW = 2 };
+
+class TaskScheduler;
+
+/**
+ * @brief Handle of a periodic task. The task never runs concurrently with itself.
+ */
+class PeriodicTask : public std::enable_shared_from_this<PeriodicTask> {
+public:
+  using Ptr = std::shared_ptr<PeriodicTask>;
+
+  /// @brief Run the task as soon as possible instead of waiting for the next period
+  void wake();
+
+  /// @brief Stop scheduling the task and wait for its running invocation to finish (must not be called from the task itself)
+  void cancel();
+
+private:
+  friend class TaskScheduler;
+  PeriodicTask(TaskScheduler* scheduler, const std::string& name, std::chrono::steady_clock::duration interval, TaskPriority priority, const std::function<void()>& task)
+  : scheduler(scheduler),
+    name(name),
+    interval(interval),
+    priority(priority),
+    task(task),
+    generation(0),
+    ready(false),
+    running(false),
+    woken(false),
+    canceled(false) {}
+
+  TaskScheduler* const scheduler;
+  const std::string name;
+  const std::chrono::steady_clock::duration interval;
+  const TaskPriority priority;
+  const std::function<void()> task;
+
+  // Guarded by the scheduler mutex
+  std::uint64_t generation;  // Invalidates timer entries when the task is woken or canceled
+  bool ready;                // The task is in a ready queue
+  bool running;              // The task is being run by a worker
+  bool woken;                // Woken while running (re-run immediately)
+  bool canceled;             // The task is no longer scheduled
+};
+
+/**
+ * @brief Process-wide worker pool shared by the extension modules.
+ *        Modules submit one-shot and periodic tasks instead of owning threads that mostly sleep on timers.
+ *        The workers run at a lowered OS priority so that they do not compete with the odometry and mapping threads,
+ *        and LOW priority tasks (e.g., visualization) never occupy all the workers: one worker is always reserved for HIGH and NORMAL tasks,
+ *        so the pool has at least two workers.
+ */
+class TaskScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+
+  /// @brief Shared instance (started with default settings on the first submission if start() is not called)
+  static TaskScheduler& instance();
+
+  ~TaskScheduler();
+
+  /// @brief Start the workers (ignored if already started)
+  /// @param num_threads  Number of worker threads (raised to 2 if smaller, see the class description)
+  /// @param nice         Niceness of the worker threads (0 = keep the process priority)
+  void start(int num_threads, int nice);
+
+  /// @brief Run a task once
+  void submit(TaskPriority priority, const Task& task);
+
+  /// @brief Run a task once after a delay
+  void submit_after(Clock::duration delay, TaskPriority priority, const Task& task);
+
+  /// @brief Run a task every interval (measured from the start of the previous run) until it is canceled
+  PeriodicTask::Ptr schedule_periodic(const std::string& name, Clock::duration interval, TaskPriority priority, const Task& task);
+
+  /// @brief Run body(i) for every i in [0, n) on up to num_tasks tasks, and block until all of them are done.
+  ///        The calling thread takes part in the loop, so this completes even when called from a worker while the others are busy.
+  void parallel_for(TaskPriority priority, int num_tasks, size_t n, const std::function<void(size_t)>& body);
+
+  /// @brief Number of worker threads
+  size_t num_threads() const;
+
+private:
+  friend class PeriodicTask;
+
+  struct Entry {
+    TaskPriority priority;
+    Task task;                   // One-shot task
+    PeriodicTask::Ptr periodic;  // Periodic task (if task is empty)
+    std::uint64_t generation;    // Generation of the periodic task when the entry was created
+  };
+
+  TaskScheduler();
+
+  void start_workers(int num_threads, int nice);  // Called with the mutex locked
+  void push_ready(Entry&& entry);
+  bool pop_ready(Entry& entry);
+  void worker_task(int nice);
+
+  void wake(const PeriodicTask::Ptr& periodic);
+  void cancel(const PeriodicTask::Ptr& periodic);
+
+private:
+  mutable std::mutex mutex;
+  std::condition_variable task_pushed;
+  std::condition_variable task_finished;
+
+  bool kill_switch;
+  size_t num_low_running;
+  std::deque<Entry> ready[3];                      // Ready tasks of each priority
+  std::multimap<Clock::time_point, Entry> timers;  // Delayed tasks
+  std::vector<std::thread> workers;
+};
+
+}  // namespace glim
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sched.h>
+
+namespace glim {
+
+class Config;
+
+/**
+ * @brief CPU set, NUMA memory binding, and real-time priority of a pipeline stage
+ */
+struct ThreadAffinity {
+public:
+  ThreadAffinity() : numa_node(-1), priority(0) {}
+
+  /// @brief Load "<stage>_cpus", "<stage>_numa_node", and "<stage>_priority" from the glim_ros section of config_ros
+  static ThreadAffinity load(const Config& config, const std::string& stage);
+
+  /// @brief True if nothing is configured (the stage inherits the settings of the process)
+  bool empty() const { return cpus.empty() && numa_node < 0 && priority <= 0; }
+
+  std::string to_string() const;
+
+public:
+  std::string stage;      // Stage name (for reporting)
+  std::vector<int> cpus;  // CPUs the threads may run on (empty = unrestricted)
+  int numa_node;          // NUMA node memory of the threads is bound to (-1 = default policy)
+  int priority;           // SCHED_FIFO priority [1, 99] (0 = keep SCHED_OTHER)
+};
+
+/**
+ * @brief Applies ThreadAffinity to the calling thread and restores the previous settings on destruction.
+ *        Threads created in the scope (e.g., the threads of AsyncOdometryEstimation) inherit the CPU set,
+ *        the memory policy, and the scheduling policy of the calling thread, so the settings persist in them.
+ */
+class ScopedThreadAffinity {
+public:
+  ScopedThreadAffinity(const ThreadAffinity& affinity);
+  ~ScopedThreadAffinity();
+
+  /// @brief Apply the settings to the calling thread permanently
+  /// @return Description of the applied settings and failures (for reporting)
+  static std::string apply(const ThreadAffinity& affinity);
+
+  /// @brief Description of the settings of the calling thread
+  static std::string current();
+
+private:
+  bool empty;
+
+  cpu_set_t cpus;
+  int sched_policy;
+  int sched_priority;
+  int mempolicy_mode;
+  unsigned long mempolicy_nodes;
+};
+
+}  // namespace glim
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <gtsam_points/types/point_cloud.hpp>
+
+namespace glim {
+
+/**
+ * @brief Tiled map parameters
+ */
+struct TiledMapParams {
+public:
+  TiledMapParams();
+
+  double tile_size;                     // Edge length of the square XY tiles [m]
+  std::vector<double> lod_resolutions;  // Voxel resolutions of the LOD levels from the finest to the coarsest [m]
+  double translation_tolerance;         // Submaps are re-binned only when their pose moves more than this [m]
+  double rotation_tolerance;            // Submaps are re-binned only when their pose rotates more than this [rad]
+};
+
+/**
+ * @brief Global map partitioned into 2D tiles with precomputed levels of detail.
+ *        Submaps are downsampled once at the finest resolution when they are inserted and are binned into the tiles their bounding boxes overlap.
+ *        Only tiles touched by a new submap or by a submap moved by the global optimization are rebuilt,
+ *        and each level of a tile is computed by downsampling the next finer level.
+ */
+class TiledMap {
+public:
+  using Poses = std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d>>;
+  using TileKey = std::pair<int, int>;
+
+  struct Level {
+    size_t num_points;                 // Number of points in the level
+    std::vector<std::uint8_t> points;  // World points packed as PointCloud2 data (float32 x, y, z)
+  };
+
+  struct Tile {
+    std::vector<int> submaps;   // Submaps whose bounding boxes overlap the tile
+    std::vector<Level> levels;  // Levels of detail (empty until the tile is built)
+    double min_z;               // Minimum Z of the points in the tile
+    double max_z;               // Maximum Z of the points in the tile
+    size_t version;             // Incremented every time the tile is rebuilt
+    bool dirty;                 // The tile needs to be rebuilt
+  };
+
+  /// @brief Map region
+  struct Query {
+    Eigen::Vector3d min_pt;  // Minimum corner of the bounding box in the world frame
+    Eigen::Vector3d max_pt;  // Maximum corner of the bounding box in the world frame
+    double resolution;       // Requested point spacing [m] (the coarsest level finer than this is used)
+    size_t max_points;       // Coarser levels are used if the region has more points than this (0 = unlimited)
+  };
+
+  TiledMap(const TiledMapParams& params = TiledMapParams());
+  ~TiledMap();
+
+  /// @brief Insert a new submap and mark the tiles it overlaps dirty
+  void insert(double stamp, const gtsam_points::PointCloud::ConstPtr& points, const Eigen::Isometry3d& T_world_origin);
+
+  /// @brief Update submap poses (poses[i] corresponds to the i-th inserted submap) and mark the tiles of moved submaps dirty
+  /// @return Number of moved submaps
+  int update_poses(const Poses& poses);
+
+  /// @brief Rebuild the dirty tiles
+  /// @param num_tasks  Number of tasks rebuilding tiles in parallel on the shared TaskScheduler (including the calling thread)
+  /// @return Keys of the rebuilt tiles
+  std::vector<TileKey> rebuild(int num_tasks = 1);
+
+  size_t num_submaps() const { return submaps.size(); }
+  size_t num_tiles() const { return tiles.size(); }
+  size_t num_dirty() const { return num_dirty_tiles; }
+  size_t num_levels() const { return params.lod_resolutions.size(); }
+  double tile_size() const { return params.tile_size; }
+
+  /// @brief Memory used by the point data of the map [bytes]
+  size_t memory_usage() const;
+
+  const std::map<TileKey, Tile>& get_tiles() const { return tiles; }
+
+  /// @brief Keys of the tiles overlapping an XY region
+  std::vector<TileKey> overlapping_tiles(const Eigen::Vector2d& min_pt, const Eigen::Vector2d& max_pt) const;
+
+  /// @brief Level used to answer a query
+  int select_level(const Query& query) const;
+
+  /// @brief Points of a region in the world frame as PointCloud2
+  /// @return Level used to answer the query
+  int query(const Query& query, const std::string& frame_id, double stamp, sensor_msgs::msg::PointCloud2& msg) const;
+
+private:
+  struct Submap {
+    double stamp;                                     // Stamp identifying the submap (first frame stamp)
+    Eigen::Isometry3d T_world_origin;                 // Pose used to bin the submap
+    Eigen::AlignedBox3d local_bounds;                 // Bounding box of the local points
+    gtsam_points::PointCloud::ConstPtr local_points;  // Points downsampled at the finest LOD resolution in the submap origin frame
+    std::vector<TileKey> tiles;                       // Tiles the submap is binned into
+  };
+
+  TileKey tile_key(double x, double y) const;
+  void bin(int submap_id);
+  void unbin(int submap_id);
+  void mark_dirty(Tile& tile);
+
+private:
+  const TiledMapParams params;
+
+  size_t num_dirty_tiles;
+  std::vector<Submap> submaps;
+  std::map<TileKey, Tile> tiles;
+};
+
+}  // namespace glim
@@ -0,0 +1,474 @@
+#include <glob.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <new>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <regex>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <spdlog/spdlog.h>
+#include <boost/format.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include <glim/util/config.hpp>
+#include <glim/odometry/callbacks.hpp>
+#include <glim_ros/glim_ros.hpp>
+#include <glim_ros/bag_player.hpp>
+#include <glim_ros/pipeline_stats.hpp>
+
+// Allocation counters (operator new is replaced for the whole process, including the loaded modules)
+namespace {
+std::atomic_uint64_t num_allocations(0);
+std::atomic_uint64_t num_allocated_bytes(0);
+}  // namespace
+
+void* operator new(std::size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  if (void* ptr = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+struct StampedPosition {
+  double stamp;
+  Eigen::Vector3d position;
+};
+
+/// @brief Load a trajectory in the TUM format (stamp x y z qx qy qz qw)
+std::vector<StampedPosition> load_tum(const std::string& path) {
+  std::vector<StampedPosition> traj;
+  std::ifstream ifs(path);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    StampedPosition pose;
+    std::stringstream sst(line);
+    if (sst >> pose.stamp >> pose.position.x() >> pose.position.y() >> pose.position.z()) {
+      traj.emplace_back(pose);
+    }
+  }
+
+  std::sort(traj.begin(), traj.end(), [](const StampedPosition& lhs, const StampedPosition& rhs) { return lhs.stamp < rhs.stamp; });
+  return traj;
+}
+
+/**
+ * @brief Absolute trajectory error after rigid (Umeyama) alignment
+ */
+struct ATE {
+  ATE() : num_matches(0), rmse(0.0), mean(0.0), max(0.0) {}
+
+  int num_matches;
+  double rmse;
+  double mean;
+  double max;
+};
+
+ATE compute_ate(const std::vector<StampedPosition>& estimate, const std::vector<StampedPosition>& reference, double max_time_diff) {
+  // Associate estimated poses with the nearest reference poses
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (const auto& pose : estimate) {
+    auto found = std::lower_bound(reference.begin(), reference.end(), pose.stamp, [](const StampedPosition& ref, double stamp) { return ref.stamp < stamp; });
+    if (found != reference.begin() && (found == reference.end() || std::abs((found - 1)->stamp - pose.stamp) < std::abs(found->stamp - pose.stamp))) {
+      found--;
+    }
+
+    if (found != reference.end() && std::abs(found->stamp - pose.stamp) < max_time_diff) {
+      src.emplace_back(pose.position);
+      dst.emplace_back(found->position);
+    }
+  }
+
+  ATE ate;
+  ate.num_matches = src.size();
+  if (src.size() < 3) {
+    return ate;
+  }
+
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src_mat(3, src.size());
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst_mat(3, dst.size());
+  for (size_t i = 0; i < src.size(); i++) {
+    src_mat.col(i) = src[i];
+    dst_mat.col(i) = dst[i];
+  }
+
+  const Eigen::Matrix4d T = Eigen::umeyama(src_mat, dst_mat, false);
+  double sum_sq = 0.0;
+  double sum = 0.0;
+  for (size_t i = 0; i < src.size(); i++) {
+    const double error = (T.block<3, 3>(0, 0) * src[i] + T.block<3, 1>(0, 3) - dst[i]).norm();
+    sum_sq += error * error;
+    sum += error;
+    ate.max = std::max(ate.max, error);
+  }
+
+  ate.rmse = std::sqrt(sum_sq / src.size());
+  ate.mean = sum / src.size();
+  return ate;
+}
+
+/// @brief Write a string as a JSON string literal
+void write_json_string(std::ostream& ost, const std::string& str) {
+  ost << '"';
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        ost << "\\\"";
+        break;
+      case '\\':
+        ost << "\\\\";
+        break;
+      case '\n':
+        ost << "\\n";
+        break;
+      case '\r':
+        ost << "\\r";
+        break;
+      case '\t':
+        ost << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          ost << boost::format("\\u%04x") % static_cast<int>(c);
+        } else {
+          ost << c;
+        }
+    }
+  }
+  ost << '"';
+}
+
+/// @brief Write a property tree as JSON (unlike boost::property_tree::write_json, numbers are written unquoted)
+void write_json(std::ostream& ost, const boost::property_tree::ptree& tree, int indent = 0) {
+  if (tree.empty()) {
+    // JSON numbers are written as is, non-finite numbers (nan, inf) as null, and anything else as a string
+    static const std::regex json_number("-?(0|[1-9][0-9]*)(\\.[0-9]+)?([eE][+-]?[0-9]+)?");
+    const std::string& value = tree.data();
+    char* end = nullptr;
+    const double number = std::strtod(value.c_str(), &end);
+    if (std::regex_match(value, json_number)) {
+      ost << value;
+    } else if (!value.empty() && end == value.c_str() + value.size() && !std::isfinite(number)) {
+      ost << "null";
+    } else {
+      write_json_string(ost, value);
+    }
+    return;
+  }
+
+  const std::string pad(indent + 2, ' ');
+  ost << "{\n";
+  for (auto child = tree.begin(); child != tree.end(); child++) {
+    ost << pad;
+    write_json_string(ost, child->first);
+    ost << ": ";
+    write_json(ost, child->second, indent + 2);
+    ost << (std::next(child) == tree.end() ? "\n" : ",\n");
+  }
+  ost << std::string(indent, ' ') << "}";
+}
+
+/**
+ * @brief Compare metrics against a baseline result
+ * @return Number of metrics regressed beyond the tolerance (or settings that differ from the baseline)
+ */
+int compare_baseline(const boost::property_tree::ptree& result, const std::string& baseline_path, double tolerance) {
+  boost::property_tree::ptree baseline;
+  try {
+    boost::property_tree::read_json(baseline_path, baseline);
+  } catch (const std::exception& e) {
+    spdlog::error("failed to read baseline {}: {}", baseline_path, e.what());
+    return 0;
+  }
+
+  // Results of runs with different settings are not comparable
+  int num_mismatches = 0;
+  for (const auto& setting : result.get_child("settings")) {
+    const auto base = baseline.get_optional<std::string>("settings." + setting.first);
+    if (!base || *base != setting.second.data()) {
+      spdlog::error("setting {}={} differs from the baseline ({})", setting.first, setting.second.data(), base ? *base : "missing");
+      num_mismatches++;
+    }
+  }
+  if (num_mismatches) {
+    return num_mismatches;
+  }
+
+  // (key, true if larger is better)
+  std::vector<std::pair<std::string, bool>> metrics = {{"throughput.frames_per_sec", true}, {"memory.peak_rss_mb", false}, {"ate.rmse", false}};
+  for (int i = 0; i < glim::PipelineStats::num_stages; i++) {
+    metrics.emplace_back(std::string("stages.") + glim::PipelineStats::stage_name(static_cast<glim::PipelineStage>(i)) + ".p99_ms", false);
+  }
+
+  int num_regressions = 0;
+  spdlog::info("comparison against {} (tolerance={:.1f}%)", baseline_path, tolerance * 100.0);
+  for (const auto& [key, larger_is_better] : metrics) {
+    const auto current = result.get_optional<double>(key);
+    const auto base = baseline.get_optional<double>(key);
+    if (!current || !base || *base == 0.0) {
+      continue;
+    }
+
+    const double change = (*current - *base) / std::abs(*base);
+    const bool regressed = larger_is_better ? change < -tolerance : change > tolerance;
+    num_regressions += regressed;
+
+    const auto message = (boost::format("%-40s baseline=%12.3f current=%12.3f change=%+7.1f%%") % key % *base % *current % (change * 100.0)).str();
+    if (regressed) {
+      spdlog::warn("{} REGRESSED", message);
+    } else {
+      spdlog::info("{}", message);
+    }
+  }
+
+  return num_regressions;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: glim_benchmark input_rosbag_path..." << std::endl;
+    return 0;
+  }
+
+  rclcpp::init(argc, argv);
+
+  // Deterministic settings must be applied before the modules are loaded (they read them at initialization)
+  auto settings_node = std::make_shared<rclcpp::Node>("glim_benchmark_settings");
+  const int seed = settings_node->declare_parameter<int>("benchmark_seed", 0);
+  const int omp_threads = settings_node->declare_parameter<int>("benchmark_omp_threads", 4);
+  settings_node.reset();
+
+  if (omp_threads <= 0) {
+    spdlog::critical("benchmark_omp_threads must be a fixed positive number (benchmark_omp_threads={})", omp_threads);
+    return 1;
+  }
+
+  // The OpenMP runtime reads OMP_* only when it is loaded (before main), and omp_set_num_threads() affects only the calling thread,
+  // so the process is re-executed with the fixed settings to apply them to every thread of the modules
+  const std::string omp_num_threads = std::to_string(omp_threads);
+  const char* env_num_threads = std::getenv("OMP_NUM_THREADS");
+  const char* env_dynamic = std::getenv("OMP_DYNAMIC");
+  if (!env_num_threads || omp_num_threads != env_num_threads || !env_dynamic || std::string(env_dynamic) != "FALSE") {
+    setenv("OMP_NUM_THREADS", omp_num_threads.c_str(), 1);
+    setenv("OMP_DYNAMIC", "FALSE", 1);
+    rclcpp::shutdown();
+    execv("/proc/self/exe", argv);
+    spdlog::critical("failed to re-execute with OMP_NUM_THREADS={} ({})", omp_num_threads, std::strerror(errno));
+    return 1;
+  }
+  std::srand(seed);
+
+  rclcpp::NodeOptions options;
+  auto glim = std::make_shared<glim::GlimROS>(options);
+
+  // Thread counts that change the results must be fixed in the configs
+  glim::Config config_ros(glim::GlobalConfig::get_config_path("config_ros"));
+  glim::Config config_odometry(glim::GlobalConfig::get_config_path("config_odometry"));
+  const auto odometry_threads = config_odometry.param<int>("odometry_estimation", "num_threads");
+  if (!odometry_threads) {
+    spdlog::critical("odometry_estimation.num_threads must be set in config_odometry for reproducible benchmarks");
+    rclcpp::shutdown();
+    return 1;
+  }
+
+  const auto declare = [&](const std::string& name, auto default_value) {
+    glim->declare_parameter(name, default_value);
+    glim->get_parameter(name, default_value);
+    return default_value;
+  };
+
+  std::string dump_path = "/tmp/dump";
+  glim->get_parameter<std::string>("dump_path", dump_path);
+
+  const std::string output_path = declare("benchmark_output", dump_path + "/benchmark.json");
+  const std::string reference_path = declare("reference_trajectory", std::string());
+  const std::string baseline_path = declare("baseline", std::string());
+  const double regression_tolerance = declare("regression_tolerance", 0.1);
+  const double max_time_diff = declare("max_time_diff", 0.05);
+  const bool save_dump = declare("save_dump", true);
+
+  std::vector<std::string> bag_filenames;
+  for (int i = 1; i < argc; i++) {
+    glob_t globbuf;
+    glob(argv[i], 0, nullptr, &globbuf);
+    for (size_t j = 0; j < globbuf.gl_pathc; j++) {
+      bag_filenames.push_back(globbuf.gl_pathv[j]);
+    }
+    globfree(&globbuf);
+  }
+  std::sort(bag_filenames.begin(), bag_filenames.end());
+
+  // Odometry trajectory (used when the global mapping trajectory is not available)
+  std::mutex odom_mutex;
+  std::vector<StampedPosition> odom_traj;
+  glim::OdometryEstimationCallbacks::on_new_frame.add([&](const glim::EstimationFrame::ConstPtr& frame) {
+    std::lock_guard<std::mutex> lock(odom_mutex);
+    odom_traj.push_back(StampedPosition{frame->stamp, frame->T_world_imu.translation()});
+  });
+
+  // Unthrottled playback through the same player as glim_rosbag (including the extension module topics).
+  // The input is paced only by the watermark-based flow control so that every run feeds the pipeline the same way.
+  glim::BagPlayerParams player_params = glim::BagPlayerParams::load(*glim);
+  player_params.playback_speed = 0.0;
+  glim::BagPlayer player(glim, bag_filenames, player_params);
+
+  const std::uint64_t allocations_t0 = num_allocations;
+  const std::uint64_t allocated_bytes_t0 = num_allocated_bytes;
+  const auto t0 = std::chrono::steady_clock::now();
+
+  player.play();
+
+  glim->wait(true);
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  const std::uint64_t allocations = num_allocations - allocations_t0;
+  const std::uint64_t allocated_bytes = num_allocated_bytes - allocated_bytes_t0;
+
+  if (save_dump) {
+    glim->save(dump_path);
+  }
+
+  // Collect results
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::vector<StampedPosition> traj = save_dump ? load_tum(dump_path + "/traj_imu.txt") : std::vector<StampedPosition>();
+  const std::string traj_source = traj.empty() ? "odometry" : "global_mapping";
+  if (traj.empty()) {
+    std::lock_guard<std::mutex> lock(odom_mutex);
+    traj = odom_traj;
+  }
+
+  double path_length = 0.0;
+  for (size_t i = 1; i < traj.size(); i++) {
+    path_length += (traj[i].position - traj[i - 1].position).norm();
+  }
+
+  boost::property_tree::ptree result;
+  result.put("bags", bag_filenames.size());
+  result.put("settings.seed", seed);
+  result.put("settings.omp_threads", omp_threads);
+  result.put("settings.odometry_threads", *odometry_threads);
+  result.put("settings.scheduler_threads", config_ros.param<int>("glim_ros", "scheduler_threads", 2));
+  const size_t num_frames = player.num_frames();
+  const double bag_duration = (player.last_msg_time() - player.first_msg_time()) / 1e9;
+  result.put("throughput.frames", num_frames);
+  result.put("throughput.wall_time_sec", elapsed);
+  result.put("throughput.bag_duration_sec", bag_duration);
+  result.put("throughput.frames_per_sec", elapsed > 0.0 ? num_frames / elapsed : 0.0);
+  result.put("throughput.realtime_factor", elapsed > 0.0 ? bag_duration / elapsed : 0.0);
+  result.put("throughput.blocked_ratio", player.flow_controller().blocked_ratio());
+
+  for (const auto& stage : glim->stats()->total()) {
+    const std::string prefix = "stages." + stage.name;
+    result.put(prefix + ".count", stage.count);
+    result.put(prefix + ".mean_ms", stage.mean * 1e3);
+    result.put(prefix + ".p50_ms", stage.p50 * 1e3);
+    result.put(prefix + ".p99_ms", stage.p99 * 1e3);
+    result.put(prefix + ".max_ms", stage.max * 1e3);
+  }
+
+  result.put("memory.peak_rss_mb", usage.ru_maxrss / 1024.0);
+  result.put("memory.allocations", allocations);
+  result.put("memory.allocated_mb", allocated_bytes / 1024.0 / 1024.0);
+  result.put("memory.allocations_per_frame", num_frames ? static_cast<double>(allocations) / num_frames : 0.0);
+
+  result.put("trajectory.source", traj_source);
+  result.put("trajectory.poses", traj.size());
+  result.put("trajectory.path_length", path_length);
+
+  if (!reference_path.empty()) {
+    const ATE ate = compute_ate(traj, load_tum(reference_path), max_time_diff);
+    result.put("ate.reference", reference_path);
+    result.put("ate.matches", ate.num_matches);
+    result.put("ate.rmse", ate.rmse);
+    result.put("ate.mean", ate.mean);
+    result.put("ate.max", ate.max);
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(output_path).parent_path(), ec);
+  std::ofstream ofs(output_path);
+  write_json(ofs, result);
+  ofs << std::endl;
+
+  write_json(std::cout, result);
+  std::cout << std::endl;
+  spdlog::info("benchmark result written to {}", output_path);
+
+  int num_regressions = 0;
+  if (!baseline_path.empty()) {
+    num_regressions = compare_baseline(result, baseline_path, regression_tolerance);
+    if (num_regressions) {
+      spdlog::warn("{} metrics regressed", num_regressions);
+    }
+  }
+
+  rclcpp::shutdown();
+  return num_regressions ? 2 : 0;
+}
@@ -0,0 +1,364 @@
+#include <glim_ros/bag_cache.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstring>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+namespace glim {
+
+namespace {
+
+constexpr char magic[8] = {'G', 'L', 'I', 'M', 'B', 'A', 'G', 'C'};
+constexpr std::uint32_t version = 1;
+
+// Record header (payloads are padded to 8 bytes so that doubles in the mapped file are aligned)
+struct RecordHeader {
+  std::uint32_t type;
+  std::uint32_t reserved;
+  std::int64_t recv_time;
+  std::uint64_t payload_size;
+};
+
+struct PointsHeader {
+  double stamp;
+  std::uint64_t num_points;
+  std::uint32_t has_times;
+  std::uint32_t has_intensities;
+};
+
+struct ImageHeader {
+  double stamp;
+  std::int32_t rows;
+  std::int32_t cols;
+  std::int32_t type;
+  std::uint32_t elem_size;
+};
+
+size_t padded(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+/// @brief Canonical absolute path of a bag
+std::filesystem::path canonical_bag_path(const std::string& bag_filename) {
+  std::error_code ec;
+  return std::filesystem::weakly_canonical(std::filesystem::absolute(bag_filename, ec), ec);
+}
+
+/// @brief Canonical absolute path, total file size, and latest modification time of a bag
+std::string bag_identity(const std::string& bag_filename) {
+  namespace fs = std::filesystem;
+
+  std::error_code ec;
+  const fs::path bag_path = canonical_bag_path(bag_filename);
+
+  // Sum of the file sizes and the latest modification time of the bag (a directory or a single file)
+  std::uintmax_t total_size = 0;
+  fs::file_time_type latest_time = fs::file_time_type::min();
+  const auto accumulate = [&](const fs::path& path) {
+    total_size += fs::file_size(path, ec);
+    latest_time = std::max(latest_time, fs::last_write_time(path, ec));
+  };
+
+  if (fs::is_directory(bag_path, ec)) {
+    for (const auto& entry : fs::directory_iterator(bag_path, ec)) {
+      if (entry.is_regular_file(ec)) {
+        accumulate(entry.path());
+      }
+    }
+  } else {
+    accumulate(bag_path);
+  }
+
+  return bag_path.string() + "|" + std::to_string(total_size) + "|" + std::to_string(latest_time.time_since_epoch().count());
+}
+
+}  // namespace
+
+std::string bag_cache_key(const std::string& bag_filename, const std::vector<std::string>& topics) {
+  std::string key = bag_identity(bag_filename) + "|";
+  for (const auto& topic : topics) {
+    key += topic + ",";
+  }
+  return key;
+}
+
+std::string bag_cache_path(const std::string& cache_dir, const std::string& bag_filename) {
+  // FNV-1a (stable across builds, unlike std::hash) of the path only, so that a modified bag replaces its cache file instead of orphaning it.
+  // The size and modification time are checked against the key stored in the cache header.
+  std::uint64_t hash = 14695981039346656037ull;
+  for (const char c : canonical_bag_path(bag_filename).string()) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+
+  // Bag directories may be given with a trailing slash
+  std::filesystem::path bag_path = std::filesystem::path(bag_filename).lexically_normal();
+  if (bag_path.filename().empty()) {
+    bag_path = bag_path.parent_path();
+  }
+
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+  return cache_dir + "/" + bag_path.filename().string() + "_" + hex + ".glimcache";
+}
+
+BagCacheWriter::BagCacheWriter(const std::string& path, const std::string& key) : path(path), temp_path(path + ".tmp") {
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+  fp = std::fopen(temp_path.c_str(), "wb");
+  if (!fp) {
+    spdlog::warn("failed to open bag cache {} for writing", temp_path);
+    return;
+  }
+
+  // Large buffer to keep the write path off the critical path of playback
+  std::setvbuf(fp, nullptr, _IOFBF, 1 << 22);
+
+  const std::uint32_t key_size = key.size();
+  const std::vector<char> key_padding(padded(key.size()) - key.size(), 0);
+  std::fwrite(magic, sizeof(magic), 1, fp);
+  std::fwrite(&version, sizeof(version), 1, fp);
+  std::fwrite(&key_size, sizeof(key_size), 1, fp);
+  std::fwrite(key.data(), 1, key.size(), fp);
+  std::fwrite(key_padding.data(), 1, key_padding.size(), fp);
+}
+
+BagCacheWriter::~BagCacheWriter() {
+  if (fp) {
+    // Not finished (e.g., playback was interrupted)
+    std::fclose(fp);
+    std::remove(temp_path.c_str());
+  }
+}
+
+void BagCacheWriter::write_imu(std::int64_t recv_time, const sensor_msgs::msg::Imu& msg) {
+  const double values[7] = {
+    msg.header.stamp.sec + msg.header.stamp.nanosec / 1e9,
+    msg.linear_acceleration.x,
+    msg.linear_acceleration.y,
+    msg.linear_acceleration.z,
+    msg.angular_velocity.x,
+    msg.angular_velocity.y,
+    msg.angular_velocity.z};
+  write_record(BagCacheRecordType::IMU, recv_time, {{values, sizeof(values)}});
+}
+
+void BagCacheWriter::write_points(std::int64_t recv_time, const RawPoints& points) {
+  PointsHeader header;
+  header.stamp = points.stamp;
+  header.num_points = points.size();
+  header.has_times = points.times.size() == points.size();
+  header.has_intensities = points.intensities.size() == points.size();
+
+  std::vector<std::pair<const void*, size_t>> chunks = {{&header, sizeof(header)}, {points.points.data(), sizeof(Eigen::Vector4d) * points.size()}};
+  if (header.has_times) {
+    chunks.emplace_back(points.times.data(), sizeof(double) * points.size());
+  }
+  if (header.has_intensities) {
+    chunks.emplace_back(points.intensities.data(), sizeof(double) * points.size());
+  }
+  write_record(BagCacheRecordType::POINTS, recv_time, chunks);
+}
+
+void BagCacheWriter::write_image(std::int64_t recv_time, double stamp, const cv::Mat& image) {
+  const cv::Mat continuous = image.isContinuous() ? image : image.clone();
+
+  ImageHeader header;
+  header.stamp = stamp;
+  header.rows = continuous.rows;
+  header.cols = continuous.cols;
+  header.type = continuous.type();
+  header.elem_size = continuous.elemSize();
+  write_record(BagCacheRecordType::IMAGE, recv_time, {{&header, sizeof(header)}, {continuous.data, continuous.total() * continuous.elemSize()}});
+}
+
+void BagCacheWriter::write_serialized(std::int64_t recv_time, const std::string& topic, const std::string& type, const rcutils_uint8_array_t& data) {
+  const std::uint32_t sizes[3] = {static_cast<std::uint32_t>(topic.size()), static_cast<std::uint32_t>(type.size()), static_cast<std::uint32_t>(data.buffer_length)};
+  write_record(BagCacheRecordType::SERIALIZED, recv_time, {{sizes, sizeof(sizes)}, {topic.data(), topic.size()}, {type.data(), type.size()}, {data.buffer, data.buffer_length}});
+}
+
+void BagCacheWriter::write_record(BagCacheRecordType type, std::int64_t recv_time, const std::vector<std::pair<const void*, size_t>>& chunks) {
+  if (!fp) {
+    return;
+  }
+
+  RecordHeader header;
+  header.type = static_cast<std::uint32_t>(type);
+  header.reserved = 0;
+  header.recv_time = recv_time;
+  header.payload_size = 0;
+  for (const auto& chunk : chunks) {
+    header.payload_size += chunk.second;
+  }
+
+  const char padding[8] = {0};
+  std::fwrite(&header, sizeof(header), 1, fp);
+  for (const auto& chunk : chunks) {
+    std::fwrite(chunk.first, 1, chunk.second, fp);
+  }
+  std::fwrite(padding, 1, padded(header.payload_size) - header.payload_size, fp);
+}
+
+void BagCacheWriter::finish() {
+  if (!fp) {
+    return;
+  }
+
+  const bool failed = std::ferror(fp);
+  std::fclose(fp);
+  fp = nullptr;
+
+  if (failed) {
+    spdlog::warn("failed to write bag cache {}", temp_path);
+    std::remove(temp_path.c_str());
+    return;
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str())) {
+    spdlog::warn("failed to rename {} to {}", temp_path, path);
+    std::remove(temp_path.c_str());
+    return;
+  }
+
+  spdlog::info("bag cache written to {}", path);
+}
+
+BagCacheReader::BagCacheReader(const std::string& path, const std::string& key) : data(nullptr), size(0), cursor(0) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < static_cast<off_t>(sizeof(magic) + 8)) {
+    close(fd);
+    return;
+  }
+
+  void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    spdlog::warn("failed to map bag cache {}", path);
+    return;
+  }
+  madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+  const std::uint8_t* bytes = static_cast<const std::uint8_t*>(mapped);
+  std::uint32_t file_version;
+  std::uint32_t key_size;
+  std::memcpy(&file_version, bytes + sizeof(magic), sizeof(file_version));
+  std::memcpy(&key_size, bytes + sizeof(magic) + 4, sizeof(key_size));
+
+  const size_t header_size = sizeof(magic) + 8 + padded(key_size);
+  const bool valid = std::memcmp(bytes, magic, sizeof(magic)) == 0 && file_version == version && header_size <= static_cast<size_t>(st.st_size) &&
+                     std::string(reinterpret_cast<const char*>(bytes + sizeof(magic) + 8), key_size) == key;
+
+  if (!valid) {
+    spdlog::info("bag cache {} is outdated", path);
+    munmap(mapped, st.st_size);
+    return;
+  }
+
+  spdlog::info("reading bag cache {}", path);
+  data = bytes;
+  size = st.st_size;
+  cursor = header_size;
+}
+
+BagCacheReader::~BagCacheReader() {
+  if (data) {
+    munmap(const_cast<std::uint8_t*>(data), size);
+  }
+}
+
+bool BagCacheReader::read_next(BagCacheRecord& record) {
+  if (!data || cursor + sizeof(RecordHeader) > size) {
+    return false;
+  }
+
+  RecordHeader header;
+  std::memcpy(&header, data + cursor, sizeof(header));
+  if (cursor + sizeof(header) + header.payload_size > size) {
+    spdlog::warn("truncated bag cache record");
+    return false;
+  }
+
+  record.type = static_cast<BagCacheRecordType>(header.type);
+  record.recv_time = header.recv_time;
+  record.payload = data + cursor + sizeof(header);
+  record.payload_size = header.payload_size;
+
+  cursor += sizeof(header) + padded(header.payload_size);
+  return true;
+}
+
+void BagCacheReader::read_imu(const BagCacheRecord& record, double& stamp, Eigen::Vector3d& linear_acc, Eigen::Vector3d& angular_vel) {
+  const double* values = reinterpret_cast<const double*>(record.payload);
+  stamp = values[0];
+  linear_acc = Eigen::Map<const Eigen::Vector3d>(values + 1);
+  angular_vel = Eigen::Map<const Eigen::Vector3d>(values + 4);
+}
+
+RawPoints::Ptr BagCacheReader::read_points(const BagCacheRecord& record) {
+  PointsHeader header;
+  std::memcpy(&header, record.payload, sizeof(header));
+  const std::uint8_t* ptr = record.payload + sizeof(header);
+
+  // A single copy from the page cache into the buffers owned by RawPoints
+  auto points = std::make_shared<RawPoints>();
+  points->stamp = header.stamp;
+  points->points.resize(header.num_points);
+  std::memcpy(static_cast<void*>(points->points.data()), ptr, sizeof(Eigen::Vector4d) * header.num_points);
+  ptr += sizeof(Eigen::Vector4d) * header.num_points;
+
+  if (header.has_times) {
+    const double* times = reinterpret_cast<const double*>(ptr);
+    points->times.assign(times, times + header.num_points);
+    ptr += sizeof(double) * header.num_points;
+  }
+
+  if (header.has_intensities) {
+    const double* intensities = reinterpret_cast<const double*>(ptr);
+    points->intensities.assign(intensities, intensities + header.num_points);
+  }
+
+  return points;
+}
+
+double BagCacheReader::read_points_stamp(const BagCacheRecord& record) {
+  PointsHeader header;
+  std::memcpy(&header, record.payload, sizeof(header));
+  return header.stamp;
+}
+
+double BagCacheReader::read_image(const BagCacheRecord& record, cv::Mat& image) {
+  ImageHeader header;
+  std::memcpy(&header, record.payload, sizeof(header));
+
+  // Clone because the modules may keep the image after the cache is unmapped
+  void* pixels = const_cast<std::uint8_t*>(record.payload + sizeof(header));
+  image = cv::Mat(header.rows, header.cols, header.type, pixels).clone();
+  return header.stamp;
+}
+
+rcutils_uint8_array_t BagCacheReader::read_serialized(const BagCacheRecord& record, std::string& topic, std::string& type) {
+  std::uint32_t sizes[3];
+  std::memcpy(sizes, record.payload, sizeof(sizes));
+
+  const char* ptr = reinterpret_cast<const char*>(record.payload + sizeof(sizes));
+  topic.assign(ptr, sizes[0]);
+  type.assign(ptr + sizes[0], sizes[1]);
+
+  rcutils_uint8_array_t serialized = rcutils_get_zero_initialized_uint8_array();
+  serialized.buffer = reinterpret_cast<std::uint8_t*>(const_cast<char*>(ptr + sizes[0] + sizes[1]));
+  serialized.buffer_length = sizes[2];
+  serialized.buffer_capacity = sizes[2];
+  return serialized;
+}
+
+}  // namespace glim
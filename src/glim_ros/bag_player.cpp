@@ -0,0 +1,412 @@
+#include <glim_ros/bag_player.hpp>
+
+#include <limits>
+#include <thread>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#include <glim/util/config.hpp>
+#include <glim_ros/bag_cache.hpp>
+
+namespace glim {
+
+BagPlayerParams::BagPlayerParams() {
+  start_offset = 0.0;
+  playback_duration = 0.0;
+  playback_until = 0.0;
+  playback_speed = 100.0;
+  end_time = std::numeric_limits<double>::max();
+
+  num_reader_threads = 2;
+  prefetch_size = 32;
+  prefetch_next_bag = true;
+}
+
+BagPlayerParams BagPlayerParams::load(rclcpp::Node& node) {
+  BagPlayerParams params;
+  const auto declare = [&](const std::string& name, auto& value) {
+    node.declare_parameter(name, value);
+    node.get_parameter(name, value);
+  };
+
+  // Playback range settings
+  declare("start_offset", params.start_offset);
+  declare("playback_duration", params.playback_duration);
+  declare("playback_until", params.playback_until);
+  declare("end_time", params.end_time);
+
+  const Config config_ros(GlobalConfig::get_config_path("config_ros"));
+  params.playback_speed = config_ros.param<double>("glim_ros", "playback_speed", params.playback_speed);
+
+  // Bag reader settings
+  declare("num_reader_threads", params.num_reader_threads);
+  declare("prefetch_size", params.prefetch_size);
+  declare("prefetch_next_bag", params.prefetch_next_bag);
+  declare("bag_cache_dir", params.bag_cache_dir);
+
+  // Flow control settings
+  const auto declare_watermark = [&](const std::string& name, size_t& watermark) {
+    int value = watermark;
+    declare(name, value);
+    watermark = std::max(0, value);
+  };
+  declare_watermark("odometry_high_watermark", params.flow.high_watermark.odometry);
+  declare_watermark("odometry_low_watermark", params.flow.low_watermark.odometry);
+  declare_watermark("sub_mapping_high_watermark", params.flow.high_watermark.sub_mapping);
+  declare_watermark("sub_mapping_low_watermark", params.flow.low_watermark.sub_mapping);
+  declare_watermark("global_mapping_high_watermark", params.flow.high_watermark.global_mapping);
+  declare_watermark("global_mapping_low_watermark", params.flow.low_watermark.global_mapping);
+  declare("drain_timeout", params.flow.drain_timeout);
+
+  return params;
+}
+
+BagPlayer::BagPlayer(const std::shared_ptr<GlimROS>& glim, const std::vector<std::string>& bag_filenames, const BagPlayerParams& params)
+: glim(glim),
+  bag_filenames(bag_filenames),
+  params(params),
+  window_start(0),
+  window_end(0),
+  flow(glim, params.flow),
+  next_reader_index(0),
+  bag_t0(0),
+  bag_t1(0),
+  frames(0),
+  last_sim_time(0.0),
+  last_report_time(std::chrono::high_resolution_clock::now()) {
+  // List topics
+  const Config config_ros(GlobalConfig::get_config_path("config_ros"));
+  reader_params.imu_topic = config_ros.param<std::string>("glim_ros", "imu_topic", "/imu");
+  reader_params.points_topic = config_ros.param<std::string>("glim_ros", "points_topic", "/points");
+  // The image topic is not read at all if no stage consumes images
+  reader_params.image_topic = glim->image_enabled() ? config_ros.param<std::string>("glim_ros", "image_topic", "/image") : "";
+  topics = {reader_params.imu_topic, reader_params.points_topic};
+  if (!reader_params.image_topic.empty()) {
+    topics.push_back(reader_params.image_topic);
+  }
+
+  spdlog::info("topics:");
+  for (const auto& topic : topics) {
+    spdlog::info("- {}", topic);
+  }
+
+  for (const auto& sub : glim->extension_subscriptions()) {
+    spdlog::info("- {} (ext)", sub->topic);
+    topics.push_back(sub->topic);
+    subscription_map[sub->topic].push_back(sub);
+  }
+
+  reader_params.topics = topics;
+  reader_params.num_threads = params.num_reader_threads;
+  reader_params.queue_size = params.prefetch_size;
+
+  // Time range index of the input bags (taken from the bag metadata)
+  bag_ranges.resize(bag_filenames.size());
+  std::transform(bag_filenames.begin(), bag_filenames.end(), bag_ranges.begin(), [](const std::string& bag_filename) { return read_bag_time_range(bag_filename); });
+
+  // start_offset is relative to the beginning of the first bag and may skip entire bags of a split set
+  if (!bag_ranges.empty() && bag_ranges.front().valid()) {
+    const int64_t playback_start = bag_ranges.front().start + static_cast<int64_t>(std::max(0.0, params.start_offset) * 1e9);
+    window_start = params.start_offset > 0.0 ? playback_start : 0;
+    if (params.playback_duration > 0.0) {
+      window_end = playback_start + static_cast<int64_t>(params.playback_duration * 1e9);
+    }
+  } else if (params.start_offset > 0.0 || params.playback_duration > 0.0) {
+    spdlog::warn("failed to get the time range of the first bag (start_offset and playback_duration are ignored)");
+  }
+  if (params.playback_until > 0.0) {
+    const int64_t until = static_cast<int64_t>(params.playback_until * 1e9);
+    window_end = window_end > 0 ? std::min(window_end, until) : until;
+  }
+  reader_params.end_time = window_end;
+  reader_params.points_end_stamp = params.end_time;
+}
+
+bool BagPlayer::play() {
+  for (size_t i = 0; i < bag_filenames.size(); i++) {
+    if (outside_window(i)) {
+      spdlog::info("skipping {} (outside the playback range)", bag_filenames[i]);
+      continue;
+    }
+
+    if (!read_bag(i)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BagPlayer::outside_window(size_t bag_index) const {
+  const auto& range = bag_ranges[bag_index];
+  return range.valid() && ((window_start > 0 && range.end < window_start) || (window_end > 0 && range.start > window_end));
+}
+
+BagPlayer::ReaderFactory BagPlayer::open_reader(size_t bag_index) const {
+  // Seek only in the bag containing the start of the window
+  auto reader_params = this->reader_params;
+  reader_params.start_time = window_start > bag_ranges[bag_index].start ? window_start : 0;
+  return [reader_params, bag_filename = bag_filenames[bag_index]] { return std::make_unique<PrefetchingBagReader>(bag_filename, reader_params); };
+}
+
+bool BagPlayer::read_bag(size_t bag_index) {
+  const std::string& bag_filename = bag_filenames[bag_index];
+  spdlog::info("opening {}", bag_filename);
+
+  // The cache always covers the entire bag, so it is not used when skipping the beginning of the bag
+  const bool seek = window_start > bag_ranges[bag_index].start;
+  std::unique_ptr<BagCacheWriter> cache_writer;
+  if (!params.bag_cache_dir.empty() && !seek) {
+    const std::string cache_path = bag_cache_path(params.bag_cache_dir, bag_filename);
+    const std::string cache_key = bag_cache_key(bag_filename, topics);
+
+    BagCacheReader cache(cache_path, cache_key);
+    if (cache.ok()) {
+      return read_cache(cache);
+    }
+
+    spdlog::info("writing bag cache to {}", cache_path);
+    cache_writer.reset(new BagCacheWriter(cache_path, cache_key));
+    if (!cache_writer->ok()) {
+      cache_writer.reset();
+    }
+  }
+
+  std::unique_ptr<PrefetchingBagReader> reader;
+  if (next_reader.valid() && next_reader_index == bag_index) {
+    reader = next_reader.get();
+  } else {
+    reader = open_reader(bag_index)();
+  }
+
+  // Prefetching is disabled with the bag cache because the next bag may be replayed from its cache
+  if (params.prefetch_next_bag && params.bag_cache_dir.empty() && bag_index + 1 < bag_filenames.size() && !outside_window(bag_index + 1)) {
+    next_reader_index = bag_index + 1;
+    next_reader = std::async(std::launch::async, open_reader(next_reader_index));
+  }
+
+  const std::string& imu_topic = reader_params.imu_topic;
+  const std::string& points_topic = reader_params.points_topic;
+  const std::string& image_topic = reader_params.image_topic;
+
+  while (true) {
+    if (!rclcpp::ok()) {
+      return false;
+    }
+    rclcpp::spin_some(glim);
+
+    const auto msg = reader->read_next();
+    if (!msg) {
+      break;
+    }
+
+    const auto& bag_msg = msg->bag_msg;
+    const std::string& topic_name = bag_msg->topic_name;
+    const std::string& topic_type = msg->topic_type;
+
+    const auto msg_time = msg->recv_time;
+    if (!pace(msg_time)) {
+      return false;
+    }
+
+    if (topic_name == imu_topic) {
+      if (topic_type != "sensor_msgs/msg/Imu") {
+        spdlog::error("topic_type mismatch: {} != sensor_msgs/msg/Imu (topic={})", topic_type, topic_name);
+        return false;
+      }
+      if (msg->imu) {
+        if (cache_writer) {
+          cache_writer->write_imu(msg_time, *msg->imu);
+        }
+        glim->imu_callback(msg->imu);
+      }
+    } else if (topic_name == points_topic) {
+      if (topic_type != "sensor_msgs/msg/PointCloud2") {
+        spdlog::error("topic_type mismatch: {} != sensor_msgs/msg/PointCloud2 (topic={})", topic_type, topic_name);
+        return false;
+      }
+      if (!msg->points) {
+        continue;
+      }
+
+      auto raw_points = glim->extract_points(msg->points);
+      if (raw_points == nullptr) {
+        spdlog::warn("failed to extract points from message");
+        continue;
+      }
+
+      if (cache_writer) {
+        cache_writer->write_points(msg_time, *raw_points);
+      }
+      if (!insert_points(raw_points)) {
+        return false;
+      }
+    } else if (topic_name == image_topic) {
+      if (topic_type != "sensor_msgs/msg/Image" && topic_type != "sensor_msgs/msg/CompressedImage") {
+        spdlog::error("topic_type mismatch: {} != sensor_msgs/msg/(Image|CompressedImage) (topic={})", topic_type, topic_name);
+        return false;
+      }
+      if (!msg->image.empty()) {
+        if (cache_writer) {
+          cache_writer->write_image(msg_time, msg->image_stamp, msg->image);
+        }
+        glim->insert_image(msg->image_stamp, msg->image);
+      }
+    }
+
+    if (subscription_map.count(topic_name)) {
+      if (cache_writer) {
+        cache_writer->write_serialized(msg_time, topic_name, topic_type, *bag_msg->serialized_data);
+      }
+      insert_serialized(topic_name, topic_type, *bag_msg->serialized_data);
+    }
+
+    message_processed(msg_time);
+  }
+
+  if (reader->end_of_range_reached()) {
+    spdlog::info("reached the end of the playback range");
+    return false;
+  }
+
+  // Publish the cache only when the entire bag has been read
+  if (cache_writer) {
+    cache_writer->finish();
+  }
+
+  return true;
+}
+
+bool BagPlayer::read_cache(BagCacheReader& cache) {
+  BagCacheRecord record;
+  std::string topic_name;
+  std::string topic_type;
+
+  while (cache.read_next(record)) {
+    if (!rclcpp::ok()) {
+      return false;
+    }
+    rclcpp::spin_some(glim);
+
+    // The same range checks as PrefetchingBagReader (the cache always covers the entire bag)
+    const bool out_of_range = (reader_params.end_time > 0 && record.recv_time > reader_params.end_time) ||
+                              (record.type == BagCacheRecordType::POINTS && BagCacheReader::read_points_stamp(record) > reader_params.points_end_stamp);
+    if (out_of_range) {
+      spdlog::info("reached the end of the playback range");
+      return false;
+    }
+
+    if (!pace(record.recv_time)) {
+      return false;
+    }
+
+    switch (record.type) {
+      case BagCacheRecordType::IMU: {
+        double stamp;
+        Eigen::Vector3d linear_acc;
+        Eigen::Vector3d angular_vel;
+        BagCacheReader::read_imu(record, stamp, linear_acc, angular_vel);
+        glim->insert_imu(stamp, linear_acc, angular_vel);
+      } break;
+      case BagCacheRecordType::POINTS:
+        if (!insert_points(BagCacheReader::read_points(record))) {
+          return false;
+        }
+        break;
+      case BagCacheRecordType::IMAGE: {
+        cv::Mat image;
+        const double stamp = BagCacheReader::read_image(record, image);
+        glim->insert_image(stamp, image);
+      } break;
+      case BagCacheRecordType::SERIALIZED:
+        insert_serialized(topic_name, topic_type, BagCacheReader::read_serialized(record, topic_name, topic_type));
+        break;
+      default:
+        spdlog::warn("unknown bag cache record type {}", static_cast<int>(record.type));
+        break;
+    }
+
+    message_processed(record.recv_time);
+  }
+
+  return true;
+}
+
+bool BagPlayer::pace(int64_t msg_time) {
+  if (real_t0.time_since_epoch().count() == 0) {
+    real_t0 = std::chrono::high_resolution_clock::now();
+  }
+
+  if (bag_t0 == 0) {
+    bag_t0 = msg_time;
+  }
+  spdlog::debug("msg_time: {} ({} sec)", msg_time / 1e9, (msg_time - bag_t0) / 1e9);
+
+  if (params.playback_until > 0.0 && msg_time / 1e9 > params.playback_until) {
+    spdlog::info("reached playback_until ({} < {})", msg_time / 1e9, params.playback_until);
+    return false;
+  }
+
+  if (params.playback_duration > 0.0 && (msg_time - bag_t0) / 1e9 > params.playback_duration) {
+    spdlog::info("reached playback_duration ({} > {})", (msg_time - bag_t0) / 1e9, params.playback_duration);
+    return false;
+  }
+
+  bag_t1 = msg_time;
+  const auto bag_elapsed = std::chrono::nanoseconds(msg_time - bag_t0);
+  if (params.playback_speed > 0.0) {
+    const auto real_target = real_t0 + std::chrono::duration_cast<std::chrono::nanoseconds>(bag_elapsed / params.playback_speed);
+    if (std::chrono::high_resolution_clock::now() < real_target) {
+      spdlog::debug("throttling (bag_elapsed={} playback_speed={})", bag_elapsed.count() / 1e9, params.playback_speed);
+      std::this_thread::sleep_until(real_target);
+    }
+  }
+
+  return true;
+}
+
+bool BagPlayer::insert_points(const RawPoints::Ptr& raw_points) {
+  const double stamp = raw_points->stamp;
+  glim->insert_raw_points(raw_points);
+  frames++;
+
+  if (stamp > params.end_time) {
+    spdlog::info("end_time reached");
+    return false;
+  }
+
+  // Block while the pipeline is saturated
+  flow.frame_inserted();
+  return true;
+}
+
+void BagPlayer::insert_serialized(const std::string& topic_name, const std::string& topic_type, const rcutils_uint8_array_t& serialized_data) {
+  auto found = subscription_map.find(topic_name);
+  if (found != subscription_map.end()) {
+    const rclcpp::SerializedMessage serialized_msg(serialized_data);
+    for (const auto& sub : found->second) {
+      sub->insert_message_instance(serialized_msg, topic_type);
+    }
+  }
+}
+
+void BagPlayer::message_processed(int64_t msg_time) {
+  glim->timer_callback();
+
+  // Playback speed report
+  const double stamp = msg_time / 1e9;
+  const auto now = std::chrono::high_resolution_clock::now();
+  if (now - last_report_time >= std::chrono::seconds(5)) {
+    if (last_sim_time > 0.0) {
+      const double real = std::chrono::duration<double>(now - last_report_time).count();
+      spdlog::info("playback speed: {:.3f}x", (stamp - last_sim_time) / real);
+    }
+
+    last_sim_time = stamp;
+    last_report_time = now;
+  }
+
+  flow.wait_extensions();
+}
+
+}  // namespace glim
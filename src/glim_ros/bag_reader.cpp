@@ -0,0 +1,288 @@
+#include <glim_ros/bag_reader.hpp>
+
+#include <limits>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <rmw/rmw.h>
+#include <rosidl_typesupport_cpp/message_type_support.hpp>
+#include <rosbag2_cpp/converter_options.hpp>
+#include <rosbag2_cpp/readers/sequential_reader.hpp>
+#include <rosbag2_compression/sequential_compression_reader.hpp>
+#include <rosbag2_storage/metadata_io.hpp>
+#include <rosbag2_storage/storage_filter.hpp>
+#include <rosbag2_storage/storage_options.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
+
+#include <glim_ros/ros_compatibility.hpp>
+#include <glim_ros/image_decoder.hpp>
+
+namespace glim {
+
+namespace {
+
+// Deserialize a message directly from the bag buffer (rclcpp::SerializedMessage would copy the buffer first)
+template <typename Msg>
+bool deserialize_message(const rcutils_uint8_array_t& serialized, Msg& msg) {
+  const auto type_support = rosidl_typesupport_cpp::get_message_type_support_handle<Msg>();
+  return rmw_deserialize(&serialized, type_support, &msg) == RMW_RET_OK;
+}
+
+// Read header.stamp at the beginning of a serialized message without deserializing it.
+// The payload starts with a 4-byte CDR encapsulation header followed by int32 sec and uint32 nanosec.
+bool peek_header_stamp(const rcutils_uint8_array_t& serialized, double& stamp) {
+  const std::uint8_t* data = serialized.buffer;
+  if (serialized.buffer_length < 12 || data[0] != 0 || data[1] != 1) {
+    // Only little endian CDR is supported
+    return false;
+  }
+
+  std::int32_t sec;
+  std::uint32_t nanosec;
+  std::memcpy(&sec, data + 4, sizeof(sec));
+  std::memcpy(&nanosec, data + 8, sizeof(nanosec));
+  stamp = sec + nanosec / 1e9;
+  return true;
+}
+
+}  // namespace
+
+BagTimeRange read_bag_time_range(const std::string& bag_filename) {
+  BagTimeRange range = {0, 0};
+
+  try {
+    rosbag2_storage::BagMetadata metadata;
+    rosbag2_storage::MetadataIo metadata_io;
+    if (metadata_io.metadata_file_exists(bag_filename)) {
+      metadata = metadata_io.read_metadata(bag_filename);
+    } else {
+      rosbag2_storage::StorageOptions options;
+      options.uri = bag_filename;
+      rosbag2_cpp::readers::SequentialReader reader;
+      reader.open(options, rosbag2_cpp::ConverterOptions());
+      metadata = reader.get_metadata();
+    }
+
+    range.start = std::chrono::duration_cast<std::chrono::nanoseconds>(metadata.starting_time.time_since_epoch()).count();
+    range.end = range.start + std::chrono::duration_cast<std::chrono::nanoseconds>(metadata.duration).count();
+  } catch (const std::exception& e) {
+    spdlog::warn("failed to read the metadata of {}: {}", bag_filename, e.what());
+  }
+
+  return range;
+}
+
+PrefetchingBagReaderParams::PrefetchingBagReaderParams() {
+  start_time = 0;
+  end_time = 0;
+  points_end_stamp = std::numeric_limits<double>::max();
+  num_threads = 2;
+  queue_size = 32;
+}
+
+PrefetchingBagReader::PrefetchingBagReader(const std::string& bag_filename, const PrefetchingBagReaderParams& params)
+: params(params),
+  kill_switch(false),
+  end_of_bag(false),
+  end_of_range(false),
+  num_read(0),
+  num_consumed(0),
+  ring(std::max(1, params.queue_size)),
+  ready(ring.size(), 0) {
+  rosbag2_storage::StorageOptions options;
+  options.uri = bag_filename;
+
+  rosbag2_cpp::ConverterOptions converter_options;
+
+  reader = std::make_unique<rosbag2_cpp::readers::SequentialReader>();
+  reader->open(options, converter_options);
+
+  if (reader->get_metadata().compression_format != "") {
+    spdlog::info("compression detected (format={})", reader->get_metadata().compression_format);
+    spdlog::info("opening bag with SequentialCompressionReader");
+    reader = std::make_unique<rosbag2_compression::SequentialCompressionReader>();
+    reader->open(options, converter_options);
+  }
+
+  if (!params.topics.empty()) {
+    rosbag2_storage::StorageFilter filter;
+    filter.topics = params.topics;
+    reader->set_filter(filter);
+  }
+
+  for (const auto& topic : reader->get_all_topics_and_types()) {
+    topic_type_map[topic.name] = topic.type;
+  }
+
+  if (params.start_time > 0) {
+    spdlog::info("seeking to {:.3f}", params.start_time / 1e9);
+    reader->seek(params.start_time);
+  }
+
+  read_thread = std::thread([this] { read_task(); });
+  for (int i = 0; i < params.num_threads; i++) {
+    deserialization_threads.emplace_back([this] { deserialization_task(); });
+  }
+}
+
+PrefetchingBagReader::~PrefetchingBagReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    kill_switch = true;
+  }
+  slot_freed.notify_all();
+  message_read.notify_all();
+  message_ready.notify_all();
+
+  read_thread.join();
+  for (auto& thread : deserialization_threads) {
+    thread.join();
+  }
+}
+
+BagMessage::ConstPtr PrefetchingBagReader::read_next() {
+  std::unique_lock<std::mutex> lock(mutex);
+  const size_t index = num_consumed % ring.size();
+  message_ready.wait(lock, [&] { return ready[index] || (end_of_bag && num_consumed == num_read); });
+
+  if (!ready[index]) {
+    return nullptr;
+  }
+
+  BagMessage::ConstPtr msg = std::move(ring[index]);
+  ready[index] = 0;
+  num_consumed++;
+
+  lock.unlock();
+  slot_freed.notify_one();
+  return msg;
+}
+
+bool PrefetchingBagReader::end_of_range_reached() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return end_of_range;
+}
+
+void PrefetchingBagReader::read_task() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      slot_freed.wait(lock, [&] { return kill_switch || num_read - num_consumed < ring.size(); });
+      if (kill_switch) {
+        return;
+      }
+    }
+
+    auto msg = std::make_shared<BagMessage>();
+    try {
+      if (reader->has_next()) {
+        msg->bag_msg = reader->read_next();
+      }
+    } catch (const std::exception& e) {
+      spdlog::error("failed to read message from bag: {}", e.what());
+    }
+
+    // Messages out of the time range are rejected before deserialization
+    bool out_of_range = false;
+    if (msg->bag_msg) {
+      msg->recv_time = get_msg_recv_timestamp(*msg->bag_msg);
+      out_of_range = params.end_time > 0 && msg->recv_time > params.end_time;
+
+      double stamp;
+      if (!out_of_range && msg->bag_msg->topic_name == params.points_topic && peek_header_stamp(*msg->bag_msg->serialized_data, stamp)) {
+        out_of_range = stamp > params.points_end_stamp;
+      }
+    }
+
+    if (!msg->bag_msg || out_of_range) {
+      std::lock_guard<std::mutex> lock(mutex);
+      end_of_bag = true;
+      end_of_range = out_of_range;
+      message_ready.notify_all();
+      return;
+    }
+
+    const auto found = topic_type_map.find(msg->bag_msg->topic_name);
+    msg->topic_type = found == topic_type_map.end() ? "" : found->second;
+
+    if (deserialization_threads.empty()) {
+      deserialize(*msg);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t seq = num_read++;
+    ring[seq % ring.size()] = msg;
+
+    if (deserialization_threads.empty()) {
+      ready[seq % ring.size()] = 1;
+      message_ready.notify_all();
+    } else {
+      deserialization_queue.push_back(seq);
+      message_read.notify_one();
+    }
+  }
+}
+
+void PrefetchingBagReader::deserialization_task() {
+  while (true) {
+    size_t seq;
+    BagMessage::Ptr msg;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      message_read.wait(lock, [&] { return kill_switch || !deserialization_queue.empty(); });
+      if (kill_switch) {
+        return;
+      }
+
+      seq = deserialization_queue.front();
+      deserialization_queue.pop_front();
+      msg = ring[seq % ring.size()];
+    }
+
+    deserialize(*msg);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ready[seq % ring.size()] = 1;
+    message_ready.notify_all();
+  }
+}
+
+void PrefetchingBagReader::deserialize(BagMessage& msg) const {
+  const auto& topic_name = msg.bag_msg->topic_name;
+  const auto& serialized = *msg.bag_msg->serialized_data;
+
+  // Type mismatches are left to the consumer to report
+  if (topic_name == params.imu_topic && msg.topic_type == "sensor_msgs/msg/Imu") {
+    msg.imu = std::make_shared<sensor_msgs::msg::Imu>();
+    if (!deserialize_message(serialized, *msg.imu)) {
+      spdlog::warn("failed to deserialize IMU message (topic={})", topic_name);
+      msg.imu.reset();
+    }
+  } else if (topic_name == params.points_topic && msg.topic_type == "sensor_msgs/msg/PointCloud2") {
+    msg.points = std::make_shared<sensor_msgs::msg::PointCloud2>();
+    if (!deserialize_message(serialized, *msg.points)) {
+      spdlog::warn("failed to deserialize points message (topic={})", topic_name);
+      msg.points.reset();
+    }
+  } else if (topic_name == params.image_topic && msg.topic_type == "sensor_msgs/msg/Image") {
+    sensor_msgs::msg::Image image_msg;
+    if (!deserialize_message(serialized, image_msg)) {
+      spdlog::warn("failed to deserialize image message (topic={})", topic_name);
+      return;
+    }
+
+    msg.image_stamp = image_msg.header.stamp.sec + image_msg.header.stamp.nanosec / 1e9;
+    ImageDecoder::decode(image_msg, msg.image);
+  } else if (topic_name == params.image_topic && msg.topic_type == "sensor_msgs/msg/CompressedImage") {
+    sensor_msgs::msg::CompressedImage compressed_image_msg;
+    if (!deserialize_message(serialized, compressed_image_msg)) {
+      spdlog::warn("failed to deserialize compressed image message (topic={})", topic_name);
+      return;
+    }
+
+    // Decoded directly into cv::Mat without the intermediate Image message
+    msg.image_stamp = compressed_image_msg.header.stamp.sec + compressed_image_msg.header.stamp.nanosec / 1e9;
+    ImageDecoder::decode(compressed_image_msg, msg.image);
+  }
+}
+
+}  // namespace glim
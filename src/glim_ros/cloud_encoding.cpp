@@ -0,0 +1,212 @@
+#include <glim_ros/cloud_encoding.hpp>
+
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <sensor_msgs/msg/point_field.hpp>
+#include <glim/util/config.hpp>
+
+namespace glim {
+
+namespace {
+
+/// @brief 21-bit-per-axis voxel key (same packing as gtsam_points voxelmaps)
+std::uint64_t voxel_key(const Eigen::Vector4d& pt, double inv_resolution) {
+  const Eigen::Array3i coord = (pt.head<3>() * inv_resolution).array().floor().cast<int>();
+  const std::uint64_t mask = (1ull << 21) - 1;
+  const std::uint64_t x = static_cast<std::uint64_t>(coord[0] + (1 << 20)) & mask;
+  const std::uint64_t y = static_cast<std::uint64_t>(coord[1] + (1 << 20)) & mask;
+  const std::uint64_t z = static_cast<std::uint64_t>(coord[2] + (1 << 20)) & mask;
+  return x | (y << 21) | (z << 42);
+}
+
+void add_field(const std::string& name, std::uint8_t datatype, std::uint32_t size, sensor_msgs::msg::PointCloud2& msg) {
+  sensor_msgs::msg::PointField field;
+  field.name = name;
+  field.offset = msg.point_step;
+  field.datatype = datatype;
+  field.count = 1;
+  msg.fields.emplace_back(field);
+  msg.point_step += size;
+}
+
+}  // namespace
+
+CloudEncoding::CloudEncoding() : type(Type::FLOAT32), with_times(true), with_intensities(true), quantization(0.01), voxel_resolution(0.0), transport(false) {}
+
+CloudEncoding CloudEncoding::load(const Config& config, const std::string& name) {
+  CloudEncoding encoding;
+
+  const std::string type = config.param<std::string>("glim_ros", name + "_encoding", "float32");
+  if (type == "int16") {
+    encoding.type = Type::INT16;
+  } else if (type != "float32") {
+    spdlog::warn("unknown {}_encoding={} (use float32)", name, type);
+  }
+
+  const std::string fields = config.param<std::string>("glim_ros", name + "_fields", "all");
+  if (fields == "xyz" || fields == "xyzi" || fields == "xyzt") {
+    encoding.with_times = fields == "xyzt";
+    encoding.with_intensities = fields == "xyzi";
+  } else if (fields != "all") {
+    spdlog::warn("unknown {}_fields={} (use all)", name, fields);
+  }
+
+  encoding.quantization = config.param<double>("glim_ros", name + "_quantization", encoding.quantization);
+  if (encoding.quantization <= 0.0) {
+    spdlog::warn("invalid {}_quantization={} (use 0.01)", name, encoding.quantization);
+    encoding.quantization = 0.01;
+  }
+
+  encoding.voxel_resolution = config.param<double>("glim_ros", name + "_voxel_resolution", 0.0);
+  encoding.transport = config.param<bool>("glim_ros", name + "_transport", false);
+  return encoding;
+}
+
+std::string CloudEncoding::to_string() const {
+  std::string str = type == Type::INT16 ? "int16(" + std::to_string(quantization) + "m)" : "float32";
+  str += std::string(" fields=xyz") + (with_intensities ? "i" : "") + (with_times ? "t" : "");
+  if (voxel_resolution > 0.0) {
+    str += " voxel=" + std::to_string(voxel_resolution) + "m";
+  }
+  if (transport) {
+    str += " transport";
+  }
+  return str;
+}
+
+CloudEncoder::CloudEncoder(const CloudEncoding& encoding) : encoding(encoding), rescaled(0) {}
+
+bool CloudEncoder::read_int16_frame(const sensor_msgs::msg::PointCloud2& msg, Eigen::Vector3d& origin, double& scale) {
+  using sensor_msgs::msg::PointField;
+
+  if (msg.fields.empty() || msg.fields[0].datatype != PointField::INT16 || msg.height != 1) {
+    return false;
+  }
+
+  const size_t frame_offset = static_cast<size_t>(msg.point_step) * msg.width;
+  if (msg.row_step != frame_offset + int16_frame_size || msg.data.size() < frame_offset + int16_frame_size) {
+    return false;
+  }
+
+  double frame[4];
+  std::memcpy(frame, msg.data.data() + frame_offset, int16_frame_size);
+  origin = Eigen::Vector3d(frame[0], frame[1], frame[2]);
+  scale = frame[3];
+  return true;
+}
+
+void CloudEncoder::encode(const sensor_msgs::msg::PointCloud2& input, sensor_msgs::msg::PointCloud2& output) {
+  using sensor_msgs::msg::PointField;
+
+  const auto& layout = layout_cache.get(input);
+  const PointCloud2View view(input, layout);
+  const bool with_times = encoding.with_times && view.has_times();
+  const bool with_intensities = encoding.with_intensities && view.has_intensities();
+
+  output.header = input.header;
+  output.height = 1;
+  output.is_bigendian = false;
+  output.is_dense = true;
+  output.fields.clear();
+  output.point_step = 0;
+
+  const bool quantize = encoding.type == CloudEncoding::Type::INT16;
+  const std::uint8_t coord_type = quantize ? PointField::INT16 : PointField::FLOAT32;
+  const std::uint32_t coord_size = quantize ? sizeof(std::int16_t) : sizeof(float);
+  add_field("x", coord_type, coord_size, output);
+  add_field("y", coord_type, coord_size, output);
+  add_field("z", coord_type, coord_size, output);
+  const std::uint32_t time_offset = output.point_step;
+  if (with_times) {
+    add_field("t", PointField::FLOAT32, sizeof(float), output);
+  }
+  const std::uint32_t intensity_offset = output.point_step;
+  if (with_intensities) {
+    add_field("intensity", PointField::FLOAT32, sizeof(float), output);
+  }
+
+  if (!layout.supported) {
+    spdlog::warn("unsupported point cloud layout for encoding");
+    output.width = 0;
+    output.row_step = 0;
+    output.data.clear();
+    return;
+  }
+
+  const double inv_resolution = encoding.voxel_resolution > 0.0 ? 1.0 / encoding.voxel_resolution : 0.0;
+  const double max_coord = std::numeric_limits<std::int16_t>::max();
+  voxels.clear();
+
+  // INT16 coordinates are relative to the center of the bounding box so that the cloud extent, not its distance from the frame origin, sets the range
+  Eigen::Vector3d origin = Eigen::Vector3d::Zero();
+  double scale = encoding.quantization;
+  if (quantize) {
+    Eigen::Array3d min_pt = Eigen::Array3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Array3d max_pt = Eigen::Array3d::Constant(std::numeric_limits<double>::lowest());
+    for (size_t i = 0; i < view.size(); i++) {
+      const Eigen::Vector4d pt = view.point(i);
+      if (pt.allFinite()) {
+        min_pt = min_pt.min(pt.head<3>().array());
+        max_pt = max_pt.max(pt.head<3>().array());
+      }
+    }
+
+    if ((min_pt <= max_pt).all()) {
+      origin = (0.5 * (min_pt + max_pt)).matrix();
+      const double half_extent = (0.5 * (max_pt - min_pt)).maxCoeff();
+      // A relative margin keeps float32 rounding of the input (at most a small fraction of a step, clamped below) from coarsening the step
+      if (half_extent > max_coord * scale * (1.0 + 1e-6)) {
+        scale = half_extent / max_coord;
+        rescaled++;
+      }
+    }
+  }
+  const double inv_scale = 1.0 / scale;
+
+  size_t num_points = 0;
+  output.data.resize(static_cast<size_t>(output.point_step) * view.size() + (quantize ? int16_frame_size : 0));
+  for (size_t i = 0; i < view.size(); i++) {
+    const Eigen::Vector4d pt = view.point(i);
+    if (!pt.allFinite()) {
+      continue;
+    }
+
+    if (inv_resolution > 0.0 && !voxels.insert(voxel_key(pt, inv_resolution)).second) {
+      continue;
+    }
+
+    std::uint8_t* dst = output.data.data() + output.point_step * num_points;
+    if (quantize) {
+      // Clamped against rounding at the bounding box faces
+      const Eigen::Array3d coord = ((pt.head<3>() - origin) * inv_scale).array().round().min(max_coord).max(-max_coord);
+      const Eigen::Matrix<std::int16_t, 3, 1> quantized = coord.cast<std::int16_t>();
+      std::memcpy(dst, quantized.data(), sizeof(std::int16_t) * 3);
+    } else {
+      const Eigen::Vector3f coord = pt.head<3>().cast<float>();
+      std::memcpy(dst, coord.data(), sizeof(float) * 3);
+    }
+
+    if (with_times) {
+      const float t = view.time(i);
+      std::memcpy(dst + time_offset, &t, sizeof(float));
+    }
+    if (with_intensities) {
+      const float intensity = view.intensity(i);
+      std::memcpy(dst + intensity_offset, &intensity, sizeof(float));
+    }
+    num_points++;
+  }
+
+  output.width = num_points;
+  output.row_step = output.point_step * num_points;
+  if (quantize) {
+    const double frame[4] = {origin.x(), origin.y(), origin.z(), scale};
+    std::memcpy(output.data.data() + output.row_step, frame, int16_frame_size);
+    output.row_step += int16_frame_size;
+  }
+  output.data.resize(output.row_step);
+}
+
+}  // namespace glim
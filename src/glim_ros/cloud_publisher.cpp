@@ -0,0 +1,127 @@
+#include <glim_ros/cloud_publisher.hpp>
+
+#include <spdlog/spdlog.h>
+
+#ifdef GLIM_ROS_HAS_POINT_CLOUD_TRANSPORT
+#include <point_cloud_transport/point_cloud_transport.hpp>
+#endif
+
+namespace glim {
+
+struct CloudPublisher::TransportPublisher {
+#ifdef GLIM_ROS_HAS_POINT_CLOUD_TRANSPORT
+  TransportPublisher(rclcpp::Node& node, const std::string& base_topic, const rclcpp::QoS& qos) : node(&node), base_topic(base_topic), qos(qos) {}
+
+  /// @brief Advertise the topic on first use.
+  ///        PointCloudTransport needs a shared_ptr to the node, which is not available while the owner of the node is being constructed.
+  point_cloud_transport::Publisher* get() {
+    if (!transport && node) {
+      try {
+        transport.reset(new point_cloud_transport::PointCloudTransport(node->shared_from_this()));
+        pub = transport->advertise(base_topic, qos.get_rmw_qos_profile());
+      } catch (const std::bad_weak_ptr&) {
+        spdlog::warn("{}: node is not owned by a shared_ptr (publish the encoded cloud without compression)", base_topic);
+        fallback_pub = node->create_publisher<sensor_msgs::msg::PointCloud2>(base_topic, qos);
+      }
+      node = nullptr;
+    }
+    return transport ? &pub : nullptr;
+  }
+
+  rclcpp::Node* node;
+  std::string base_topic;
+  rclcpp::QoS qos;
+
+  std::unique_ptr<point_cloud_transport::PointCloudTransport> transport;
+  point_cloud_transport::Publisher pub;
+  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> fallback_pub;
+#endif
+};
+
+CloudPublisher::CloudPublisher(rclcpp::Node& node, const std::string& topic, const rclcpp::QoS& qos, int pool_size, const CloudEncoding& encoding)
+: pool_size(std::max(1, pool_size)),
+  cursor(0) {
+  // Intra-process communication does not support transient local durability
+  rclcpp::PublisherOptions options;
+  intra_process = node.get_node_options().use_intra_process_comms();
+  transient_local = qos.get_rmw_qos_profile().durability == RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL;
+  if (intra_process && transient_local) {
+    intra_process = false;
+    options.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+  }
+
+  pub = node.create_publisher<PointCloud2>(topic, qos, options);
+
+  if (!encoding.enabled()) {
+    return;
+  }
+
+  encoder.reset(new CloudEncoder(encoding));
+  encoded_msg.reset(new PointCloud2);
+
+  const std::string encoded_topic = topic + "/encoded";
+  if (encoding.transport) {
+#ifdef GLIM_ROS_HAS_POINT_CLOUD_TRANSPORT
+    // point_cloud_transport does not expand "~", so the topic is resolved against the node name
+    const std::string base_topic = encoded_topic[0] == '~' ? node.get_fully_qualified_name() + encoded_topic.substr(1) : encoded_topic;
+    transport_pub.reset(new TransportPublisher(node, base_topic, qos));
+#else
+    spdlog::warn("{}: built without point_cloud_transport (publish the encoded cloud without compression)", encoded_topic);
+#endif
+  }
+
+  if (!transport_pub) {
+    encoded_pub = node.create_publisher<PointCloud2>(encoded_topic, qos, options);
+  }
+
+  spdlog::info("{}: {}", encoded_topic, encoding.to_string());
+}
+
+CloudPublisher::~CloudPublisher() {}
+
+size_t CloudPublisher::encoded_subscription_count() const {
+#ifdef GLIM_ROS_HAS_POINT_CLOUD_TRANSPORT
+  if (transport_pub) {
+    if (const auto transport = transport_pub->get()) {
+      return transport->getNumSubscribers();
+    }
+    return transport_pub->fallback_pub ? transport_pub->fallback_pub->get_subscription_count() : 0;
+  }
+#endif
+  return encoded_pub ? encoded_pub->get_subscription_count() : 0;
+}
+
+void CloudPublisher::publish_encoded(const PointCloud2& msg) {
+  encoder->encode(msg, *encoded_msg);
+
+#ifdef GLIM_ROS_HAS_POINT_CLOUD_TRANSPORT
+  if (transport_pub) {
+    if (const auto transport = transport_pub->get()) {
+      transport->publish(*encoded_msg);
+    } else if (transport_pub->fallback_pub) {
+      transport_pub->fallback_pub->publish(*encoded_msg);
+    }
+    return;
+  }
+#endif
+  encoded_pub->publish(*encoded_msg);
+}
+
+std::shared_ptr<CloudPublisher::PointCloud2> CloudPublisher::acquire() {
+  for (size_t i = 0; i < pool.size(); i++) {
+    const auto& msg = pool[(cursor + i) % pool.size()];
+    if (msg.use_count() == 1) {
+      cursor = (cursor + i + 1) % pool.size();
+      return msg;
+    }
+  }
+
+  // All pooled messages are still in use (e.g., held by intra-process subscribers)
+  auto msg = std::make_shared<PointCloud2>();
+  if (pool.size() < pool_size) {
+    pool.emplace_back(msg);
+  }
+  return msg;
+}
+
+}  // namespace glim
@@ -0,0 +1,172 @@
+#include <glim_ros/dump_prefetcher.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <spdlog/spdlog.h>
+
+namespace glim {
+
+namespace {
+
+/// @brief MemAvailable in /proc/meminfo (free pages if unavailable) [bytes]
+size_t available_memory() {
+  std::ifstream ifs("/proc/meminfo");
+  std::string key;
+  size_t value;
+  std::string unit;
+  while (ifs >> key >> value >> unit) {
+    if (key == "MemAvailable:") {
+      return value * 1024;
+    }
+  }
+
+  return static_cast<size_t>(sysconf(_SC_AVPHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace
+
+DumpPrefetcher::DumpPrefetcher(const std::string& dump_path, int num_threads, size_t max_bytes)
+: max_bytes(max_bytes ? max_bytes : available_memory() / 2),
+  kill_switch(false),
+  cursor(0),
+  bytes_reserved(0),
+  bytes_prefetched(0),
+  num_prefetched(0),
+  num_running(0) {
+  std::error_code ec;
+  if (!std::filesystem::is_directory(dump_path, ec)) {
+    spdlog::warn("{} is not a directory (skip prefetching)", dump_path);
+    return;
+  }
+
+  std::vector<std::filesystem::path> top_files;
+  std::vector<std::filesystem::path> submap_dirs;
+  for (const auto& entry : std::filesystem::directory_iterator(dump_path, ec)) {
+    if (entry.is_regular_file(ec)) {
+      top_files.emplace_back(entry.path());
+    } else if (entry.is_directory(ec)) {
+      submap_dirs.emplace_back(entry.path());
+    }
+  }
+
+  // Submap directories are zero-padded indices (e.g., 000042), so the lexicographic order is the load order
+  std::sort(top_files.begin(), top_files.end());
+  std::sort(submap_dirs.begin(), submap_dirs.end());
+
+  const auto add_file = [&](const std::filesystem::path& path) {
+    const auto size = std::filesystem::file_size(path, ec);
+    if (!ec && size) {
+      files.emplace_back(File{path.string(), static_cast<size_t>(size)});
+    }
+  };
+
+  std::for_each(top_files.begin(), top_files.end(), add_file);
+  for (const auto& dir : submap_dirs) {
+    std::vector<std::filesystem::path> submap_files;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+      if (entry.is_regular_file(ec)) {
+        submap_files.emplace_back(entry.path());
+      }
+    }
+    std::sort(submap_files.begin(), submap_files.end());
+    std::for_each(submap_files.begin(), submap_files.end(), add_file);
+  }
+
+  size_t total_bytes = 0;
+  for (const auto& file : files) {
+    total_bytes += file.size;
+  }
+
+  spdlog::info(
+    "prefetching {} files ({:.1f}MB) of {} with {} threads (cap={:.1f}MB)",
+    files.size(),
+    total_bytes / 1e6,
+    dump_path,
+    num_threads,
+    this->max_bytes / 1e6);
+
+  start_time = std::chrono::steady_clock::now();
+  num_running = num_threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([this] { prefetch_task(); });
+  }
+}
+
+DumpPrefetcher::~DumpPrefetcher() {
+  kill_switch = true;
+  wait();
+}
+
+void DumpPrefetcher::wait() {
+  for (auto& thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void DumpPrefetcher::prefetch_task() {
+  while (!kill_switch) {
+    const size_t i = cursor++;
+    if (i >= files.size()) {
+      break;
+    }
+
+    // Stop once the cap is reached (the file that crosses the cap is skipped)
+    if (bytes_reserved.fetch_add(files[i].size) + files[i].size > max_bytes) {
+      spdlog::debug("prefetch memory cap reached at {}", files[i].path);
+      cursor = files.size();
+      break;
+    }
+
+    if (prefetch(files[i])) {
+      bytes_prefetched += files[i].size;
+      num_prefetched++;
+    }
+  }
+
+  // The last thread to finish reports the result
+  if (--num_running == 0) {
+    const auto t2 = std::chrono::steady_clock::now();
+    spdlog::info(
+      "prefetched {}/{} files ({:.1f}MB) in {:.3f}s",
+      num_prefetched.load(),
+      files.size(),
+      bytes_prefetched / 1e6,
+      std::chrono::duration<double>(t2 - start_time).count());
+  }
+}
+
+bool DumpPrefetcher::prefetch(const File& file) {
+  const int fd = open(file.path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  void* mapped = mmap(nullptr, file.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  // Readahead is requested for the whole file, and touching each page makes this thread wait for the I/O
+  // so that several files are read concurrently. The pages stay in the page cache after unmapping.
+  madvise(mapped, file.size, MADV_WILLNEED);
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const volatile char* data = static_cast<const volatile char*>(mapped);
+  char sum = 0;
+  for (size_t offset = 0; offset < file.size && !kill_switch; offset += page_size) {
+    sum ^= data[offset];
+  }
+  (void)sum;
+
+  munmap(mapped, file.size);
+  return true;
+}
+
+}  // namespace glim
@@ -0,0 +1,156 @@
+#include <glim_ros/flow_controller.hpp>
+
+#include <thread>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <glim_ros/pipeline_notifier.hpp>
+
+namespace glim {
+
+FlowControllerParams::FlowControllerParams() {
+  high_watermark.odometry = 8;
+  high_watermark.sub_mapping = 32;
+  high_watermark.global_mapping = 16;
+  low_watermark.odometry = 2;
+  low_watermark.sub_mapping = 8;
+  low_watermark.global_mapping = 4;
+  drain_timeout = 10.0;
+  extension_wait_timeout = 1.0;
+  report_interval = 5.0;
+}
+
+FlowController::FlowController(const std::shared_ptr<GlimROS>& glim, const FlowControllerParams& params)
+: glim(glim),
+  params(validate(params)),
+  num_inserted(0),
+  blocked_time(0),
+  t_begin(Clock::now()),
+  last_report_time(t_begin),
+  last_num_inserted(0),
+  last_num_processed(0),
+  last_blocked_time(0) {}
+
+FlowController::~FlowController() {
+  if (num_inserted) {
+    spdlog::info("throughput: {:.1f} frames/s on average (blocked by the pipeline {:.1f}% of the time)", average_throughput(), 100.0 * blocked_ratio());
+  }
+}
+
+FlowControllerParams FlowController::validate(FlowControllerParams params) {
+  // Odometry holds the last frame until IMU data covering it arrives, so a stage may never drain to zero while the input is blocked
+  const auto clamp = [](const char* name, size_t& watermark) {
+    if (watermark < 1) {
+      spdlog::warn("{}_low_watermark must be >= 1 (use 1)", name);
+      watermark = 1;
+    }
+  };
+  clamp("odometry", params.low_watermark.odometry);
+  clamp("sub_mapping", params.low_watermark.sub_mapping);
+  clamp("global_mapping", params.low_watermark.global_mapping);
+  return params;
+}
+
+void FlowController::frame_inserted() {
+  num_inserted++;
+
+  PipelineWorkload workload = glim->workload();
+  if (!saturated(workload)) {
+    report(workload);
+    return;
+  }
+
+  spdlog::debug("throttling (workload odometry={} sub_mapping={} global_mapping={})", workload.odometry, workload.sub_mapping, workload.global_mapping);
+
+  // Wait until every stage drains down to its low watermark (or the timeout, so that a stalled stage cannot block the input forever)
+  const auto t0 = Clock::now();
+  const auto deadline = t0 + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(params.drain_timeout));
+  std::uint64_t generation = glim->notifier()->generation();
+  while (rclcpp::ok() && !drained(workload)) {
+    if (Clock::now() > deadline) {
+      spdlog::warn(
+        "pipeline has not drained for {:.1f} sec (resume the input, workload odometry={} sub_mapping={} global_mapping={})",
+        params.drain_timeout,
+        workload.odometry,
+        workload.sub_mapping,
+        workload.global_mapping);
+      break;
+    }
+
+    // Sub/global mapping do not notify on every consumed input. Re-check the queues at least every 10 msec.
+    generation = glim->notifier()->wait(generation, std::chrono::milliseconds(10));
+    rclcpp::spin_some(glim);
+    glim->timer_callback();
+    workload = glim->workload();
+  }
+
+  blocked_time += Clock::now() - t0;
+  report(workload);
+}
+
+void FlowController::wait_extensions() {
+  const auto t0 = Clock::now();
+  auto sleep_duration = std::chrono::milliseconds(1);
+  while (glim->needs_wait()) {
+    rclcpp::spin_some(glim);
+    std::this_thread::sleep_for(sleep_duration);
+    sleep_duration = std::min<std::chrono::milliseconds>(sleep_duration * 2, std::chrono::milliseconds(10));
+    spdlog::debug("throttling (waiting for extension modules)");
+
+    if (Clock::now() - t0 > std::chrono::duration<double>(params.extension_wait_timeout)) {
+      spdlog::warn("throttling timeout (an extension module may be hanged)");
+      break;
+    }
+  }
+}
+
+double FlowController::average_throughput() const {
+  const double elapsed = std::chrono::duration<double>(Clock::now() - t_begin).count();
+  return elapsed > 0.0 ? num_inserted / elapsed : 0.0;
+}
+
+double FlowController::blocked_ratio() const {
+  const auto elapsed = Clock::now() - t_begin;
+  return elapsed.count() > 0 ? std::chrono::duration<double>(blocked_time) / elapsed : 0.0;
+}
+
+bool FlowController::saturated(const PipelineWorkload& workload) const {
+  return workload.odometry >= params.high_watermark.odometry || workload.sub_mapping >= params.high_watermark.sub_mapping ||
+         workload.global_mapping >= params.high_watermark.global_mapping;
+}
+
+bool FlowController::drained(const PipelineWorkload& workload) const {
+  return workload.odometry <= params.low_watermark.odometry && workload.sub_mapping <= params.low_watermark.sub_mapping &&
+         workload.global_mapping <= params.low_watermark.global_mapping;
+}
+
+void FlowController::report(const PipelineWorkload& workload) {
+  const auto now = Clock::now();
+  const double elapsed = std::chrono::duration<double>(now - last_report_time).count();
+  if (elapsed < params.report_interval) {
+    return;
+  }
+
+  const size_t num_processed = num_inserted - std::min(num_inserted, workload.odometry);
+  const double ingest_rate = (num_inserted - last_num_inserted) / elapsed;
+  const double odometry_rate = (num_processed - std::min(num_processed, last_num_processed)) / elapsed;
+  const double blocked = std::chrono::duration<double>(blocked_time - last_blocked_time).count() / elapsed;
+
+  // While the input is blocked, the odometry rate is the sustainable throughput of the pipeline.
+  // Otherwise, the input is the bottleneck and the pipeline could run faster.
+  spdlog::info(
+    "throughput: input={:.1f} frames/s odometry={:.1f} frames/s blocked={:.0f}% ({}) workload: odometry={} sub_mapping={} global_mapping={}",
+    ingest_rate,
+    odometry_rate,
+    100.0 * blocked,
+    blocked > 0.1 ? "pipeline-bound" : "input-bound",
+    workload.odometry,
+    workload.sub_mapping,
+    workload.global_mapping);
+
+  last_report_time = now;
+  last_num_inserted = num_inserted;
+  last_num_processed = num_processed;
+  last_blocked_time = blocked_time;
+}
+
+}  // namespace glim
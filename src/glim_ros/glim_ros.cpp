@@ -2,9 +2,15 @@
 
 #define GLIM_ROS2
 
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 #include <deque>
 #include <thread>
+#include <future>
+#include <fstream>
 #include <iostream>
+#include <filesystem>
 #include <functional>
 #include <boost/format.hpp>
 #include <spdlog/spdlog.h>
@@ -18,6 +24,7 @@
 
 #include <sensor_msgs/msg/imu.hpp>
 #include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
 #include <sensor_msgs/msg/point_cloud2.hpp>
 
 #include <gtsam_points/optimizers/linearization_hook.hpp>
@@ -33,11 +40,33 @@
 #include <glim/odometry/async_odometry_estimation.hpp>
 #include <glim/mapping/async_sub_mapping.hpp>
 #include <glim/mapping/async_global_mapping.hpp>
+#include <glim/odometry/callbacks.hpp>
+#include <glim/mapping/callbacks.hpp>
 #include <glim_ros/ros_compatibility.hpp>
+#include <glim_ros/point_cloud2_view.hpp>
+#include <glim_ros/pipeline_notifier.hpp>
+#include <glim_ros/pipeline_stats.hpp>
+#include <glim_ros/image_decoder.hpp>
+#include <glim_ros/map_writer.hpp>
+#include <glim_ros/memory_usage.hpp>
+#include <glim_ros/sensor_merge_queue.hpp>
+#include <glim_ros/task_scheduler.hpp>
+#include <glim_ros/thread_affinity.hpp>
+#include <glim_ros/load_shedding.hpp>
 
 namespace glim {
 
 GlimROS::GlimROS(const rclcpp::NodeOptions& options) : Node("glim_ros", options) {
+  // Startup timing breakdown (logged at the end of the constructor)
+  const auto startup_t0 = std::chrono::steady_clock::now();
+  auto phase_t0 = startup_t0;
+  std::vector<std::pair<std::string, double>> startup_timings;
+  const auto end_phase = [&](const std::string& phase) {
+    const auto t = std::chrono::steady_clock::now();
+    startup_timings.emplace_back(phase, std::chrono::duration<double>(t - phase_t0).count());
+    phase_t0 = t;
+  };
+
   // Setup logger
   auto logger = spdlog::stdout_color_mt("glim");
   logger->sinks().push_back(get_ringbuffer_sink());
@@ -62,6 +91,10 @@ GlimROS::GlimROS(const rclcpp::NodeOptions& options) : Node("glim_ros", options)
     spdlog::info("dump_on_unload={}", dump_on_unload);
   }
 
+  dump_path = "/tmp/dump";
+  this->declare_parameter<std::string>("dump_path", dump_path);
+  this->get_parameter<std::string>("dump_path", dump_path);
+
   std::string config_path;
   this->declare_parameter<std::string>("config_path", "config");
   this->get_parameter<std::string>("config_path", config_path);
@@ -80,6 +113,25 @@ GlimROS::GlimROS(const rclcpp::NodeOptions& options) : Node("glim_ros", options)
   points_time_offset = config_ros.param<double>("glim_ros", "points_time_offset", 0.0);
   acc_scale = config_ros.param<double>("glim_ros", "acc_scale", 1.0);
 
+  // IMU messages are fanned out to the stages in batches (imu_batch_size <= 1 inserts every message immediately)
+  imu_batch_size = config_ros.param<int>("glim_ros", "imu_batch_size", 16);
+  imu_batch_max_delay = config_ros.param<double>("glim_ros", "imu_batch_max_delay", 0.01);
+  imu_batch.reserve(std::max(1, imu_batch_size));
+  imu_flushing.reserve(std::max(1, imu_batch_size));
+
+  // Resident set size budget shared with the components (e.g., the viewer releases map memory when it is exceeded)
+  MemoryUsage::instance().set_budget(config_ros.param<double>("glim_ros", "memory_budget_mb", 0.0) * 1e6);
+
+  // Stages that receive images (images are not subscribed nor decoded if none of them uses images)
+  image_to_odometry = config_ros.param<bool>("glim_ros", "image_to_odometry", true);
+  image_to_sub_mapping = config_ros.param<bool>("glim_ros", "image_to_sub_mapping", true);
+  image_to_global_mapping = config_ros.param<bool>("glim_ros", "image_to_global_mapping", true);
+
+  // Read points directly from the message buffer with a cached field layout
+  if (config_ros.param<bool>("glim_ros", "use_points_view", true)) {
+    points_layout.reset(new glim::PointCloud2LayoutCache);
+  }
+
   // Setup GPU-based linearization
 #ifdef BUILD_GTSAM_POINTS_GPU
   gtsam_points::LinearizationHook::register_hook([]() { return gtsam_points::create_nonlinear_factor_set_gpu(); });
@@ -89,45 +141,38 @@ GlimROS::GlimROS(const rclcpp::NodeOptions& options) : Node("glim_ros", options)
   time_keeper.reset(new glim::TimeKeeper);
   preprocessor.reset(new glim::CloudPreprocessor);
 
-  // Odometry estimation
-  glim::Config config_odometry(glim::GlobalConfig::get_config_path("config_odometry"));
-  const std::string odometry_estimation_so_name = config_odometry.param<std::string>("odometry_estimation", "so_name", "libodometry_estimation_cpu.so");
-  spdlog::info("load {}", odometry_estimation_so_name);
-
-  std::shared_ptr<glim::OdometryEstimationBase> odom = OdometryEstimationBase::load_module(odometry_estimation_so_name);
-  if (!odom) {
-    spdlog::critical("failed to load odometry estimation module");
-    abort();
+  // Load shedding in live operation: escalated while odometry falls behind the subscribed inputs and restored once the backlog clears
+  LoadSheddingParams shedding_params;
+  shedding_params.enabled = config_ros.param<bool>("glim_ros", "load_shedding", false);
+  shedding_params.high_workload = config_ros.param<int>("glim_ros", "shedding_high_workload", shedding_params.high_workload);
+  shedding_params.low_workload = config_ros.param<int>("glim_ros", "shedding_low_workload", shedding_params.low_workload);
+  shedding_params.high_latency = config_ros.param<double>("glim_ros", "shedding_high_latency", shedding_params.high_latency);
+  shedding_params.low_latency = config_ros.param<double>("glim_ros", "shedding_low_latency", shedding_params.low_latency);
+  shedding_params.escalate_interval = config_ros.param<double>("glim_ros", "shedding_escalate_interval", shedding_params.escalate_interval);
+  shedding_params.restore_interval = config_ros.param<double>("glim_ros", "shedding_restore_interval", shedding_params.restore_interval);
+  shedding_params.max_level = static_cast<LoadSheddingLevel>(
+    std::clamp(config_ros.param<int>("glim_ros", "shedding_max_level", static_cast<int>(shedding_params.max_level)), 0, static_cast<int>(LoadSheddingLevel::SKIP_FRAMES)));
+  LoadShedding::instance().set_params(shedding_params);
+
+  shedding_frame_skip = std::max(1, config_ros.param<int>("glim_ros", "shedding_frame_skip", 2));
+  shedding_image_queue_size = std::max(1, config_ros.param<int>("glim_ros", "shedding_image_queue_size", 30));
+  num_subscribed_frames = 0;
+  latest_input_stamp = 0.0;
+  latest_odometry_stamp = std::make_shared<std::atomic<double>>(0.0);
+  if (shedding_params.enabled) {
+    const double downsample_factor = config_ros.param<double>("glim_ros", "shedding_downsample_factor", 2.0);
+    CloudPreprocessorParams coarse_params;
+    coarse_params.downsample_resolution *= downsample_factor;
+    coarse_params.downsample_target = std::max(1, static_cast<int>(coarse_params.downsample_target / downsample_factor));
+    coarse_params.downsample_rate /= downsample_factor;
+    coarse_preprocessor.reset(new CloudPreprocessor(coarse_params));
   }
-  odometry_estimation.reset(new glim::AsyncOdometryEstimation(odom, odom->requires_imu()));
 
-  // Sub mapping
-  if (config_ros.param<bool>("glim_ros", "enable_local_mapping", true)) {
-    const std::string sub_mapping_so_name =
-      glim::Config(glim::GlobalConfig::get_config_path("config_sub_mapping")).param<std::string>("sub_mapping", "so_name", "libsub_mapping.so");
-    if (!sub_mapping_so_name.empty()) {
-      spdlog::info("load {}", sub_mapping_so_name);
-      auto sub = SubMappingBase::load_module(sub_mapping_so_name);
-      if (sub) {
-        sub_mapping.reset(new AsyncSubMapping(sub));
-      }
-    }
-  }
+  // Each stage is created under its CPU set, NUMA binding, and scheduling policy so that its threads inherit them
+  spdlog::info("process thread affinity: {}", ScopedThreadAffinity::current());
+  end_phase("config");
 
-  // Global mapping
-  if (config_ros.param<bool>("glim_ros", "enable_global_mapping", true)) {
-    const std::string global_mapping_so_name =
-      glim::Config(glim::GlobalConfig::get_config_path("config_global_mapping")).param<std::string>("global_mapping", "so_name", "libglobal_mapping.so");
-    if (!global_mapping_so_name.empty()) {
-      spdlog::info("load {}", global_mapping_so_name);
-      auto global = GlobalMappingBase::load_module(global_mapping_so_name);
-      if (global) {
-        global_mapping.reset(new AsyncGlobalMapping(global));
-      }
-    }
-  }
-
-  // Extention modules
+  // GlobalConfig must not be modified once the module tasks are launched because they read it in other threads
   const auto extensions = config_ros.param<std::vector<std::string>>("glim_ros", "extension_modules");
   if (extensions && !extensions->empty()) {
     for (const auto& extension : *extensions) {
@@ -146,57 +191,344 @@ GlimROS::GlimROS(const rclcpp::NodeOptions& options) : Node("glim_ros", options)
         break;
       }
     }
+  }
 
-    for (const auto& extension : *extensions) {
-      spdlog::info("load {}", extension);
-      auto ext_module = ExtensionModule::load_module(extension);
-      if (ext_module == nullptr) {
-        spdlog::error("failed to load {}", extension);
-        continue;
-      } else {
-        extension_modules.push_back(ext_module);
+  // The mapping modules are loaded and constructed concurrently with each other and with the ROS setup below
+  // (dlopen and the module constructors, including CUDA context creation of GPU modules, dominate the startup time)
+  const auto launch = config_ros.param<bool>("glim_ros", "parallel_module_loading", true) ? std::launch::async : std::launch::deferred;
+  const auto elapsed = [](const std::chrono::steady_clock::time_point& t0) { return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count(); };
+
+  // Odometry estimation
+  auto odometry_loaded = std::async(launch, [&] {
+    const auto t0 = std::chrono::steady_clock::now();
+    ScopedThreadAffinity affinity(ThreadAffinity::load(config_ros, "odometry"));
+    glim::Config config_odometry(glim::GlobalConfig::get_config_path("config_odometry"));
+    const std::string odometry_estimation_so_name = config_odometry.param<std::string>("odometry_estimation", "so_name", "libodometry_estimation_cpu.so");
+    spdlog::info("load {}", odometry_estimation_so_name);
+
+    std::shared_ptr<glim::OdometryEstimationBase> odom = OdometryEstimationBase::load_module(odometry_estimation_so_name);
+    if (!odom) {
+      spdlog::critical("failed to load odometry estimation module");
+      abort();
+    }
+    odometry_estimation.reset(new glim::AsyncOdometryEstimation(odom, odom->requires_imu()));
+    return elapsed(t0);
+  });
+
+  // Sub mapping
+  auto sub_mapping_loaded = std::async(launch, [&] {
+    const auto t0 = std::chrono::steady_clock::now();
+    if (config_ros.param<bool>("glim_ros", "enable_local_mapping", true)) {
+      ScopedThreadAffinity affinity(ThreadAffinity::load(config_ros, "sub_mapping"));
+      const std::string sub_mapping_so_name =
+        glim::Config(glim::GlobalConfig::get_config_path("config_sub_mapping")).param<std::string>("sub_mapping", "so_name", "libsub_mapping.so");
+      if (!sub_mapping_so_name.empty()) {
+        spdlog::info("load {}", sub_mapping_so_name);
+        auto sub = SubMappingBase::load_module(sub_mapping_so_name);
+        if (sub) {
+          sub_mapping.reset(new AsyncSubMapping(sub));
+        }
+      }
+    }
+    return elapsed(t0);
+  });
 
-        auto ext_module_ros = std::dynamic_pointer_cast<ExtensionModuleROS2>(ext_module);
-        if (ext_module_ros) {
-          const auto subs = ext_module_ros->create_subscriptions(*this);
-          extension_subs.insert(extension_subs.end(), subs.begin(), subs.end());
+  // Global mapping
+  auto global_mapping_loaded = std::async(launch, [&] {
+    const auto t0 = std::chrono::steady_clock::now();
+    if (config_ros.param<bool>("glim_ros", "enable_global_mapping", true)) {
+      ScopedThreadAffinity affinity(ThreadAffinity::load(config_ros, "global_mapping"));
+      const std::string global_mapping_so_name =
+        glim::Config(glim::GlobalConfig::get_config_path("config_global_mapping")).param<std::string>("global_mapping", "so_name", "libglobal_mapping.so");
+      if (!global_mapping_so_name.empty()) {
+        spdlog::info("load {}", global_mapping_so_name);
+        auto global = GlobalMappingBase::load_module(global_mapping_so_name);
+        if (global) {
+          global_mapping.reset(new AsyncGlobalMapping(global));
+        }
+      }
+    }
+    return elapsed(t0);
+  });
+  end_phase("launch_modules");
+
+  // Extension modules and the shared worker pool
+  {
+    // Worker pool shared by the extension modules (must be started before they are loaded)
+    ScopedThreadAffinity affinity(ThreadAffinity::load(config_ros, "extensions"));
+    TaskScheduler::instance().start(config_ros.param<int>("glim_ros", "scheduler_threads", 2), config_ros.param<int>("glim_ros", "scheduler_nice", 5));
+
+    // Extention modules
+    if (extensions && !extensions->empty()) {
+      for (const auto& extension : *extensions) {
+        spdlog::info("load {}", extension);
+        auto ext_module = ExtensionModule::load_module(extension);
+        if (ext_module == nullptr) {
+          spdlog::error("failed to load {}", extension);
+          continue;
+        } else {
+          extension_modules.push_back(ext_module);
+
+          auto ext_module_ros = std::dynamic_pointer_cast<ExtensionModuleROS2>(ext_module);
+          if (ext_module_ros) {
+            const auto subs = ext_module_ros->create_subscriptions(*this);
+            extension_subs.insert(extension_subs.end(), subs.begin(), subs.end());
+          }
         }
       }
     }
   }
 
-  // ROS-related
+  end_phase("extensions");
+
+  // ROS-related (subscriptions are created while the mapping modules are still loading so that discovery completes early.
+  // Messages received until the executor starts spinning are held in the subscription queues.)
   using std::placeholders::_1;
   const std::string imu_topic = config_ros.param<std::string>("glim_ros", "imu_topic", "");
   const std::string points_topic = config_ros.param<std::string>("glim_ros", "points_topic", "");
   const std::string image_topic = config_ros.param<std::string>("glim_ros", "image_topic", "");
   const std::string wheel_topic = config_ros.param<std::string>("glim_ros", "wheel_topic", "");
 
+  // Callback groups
+  // Each sensor stream has its own group so that, on a multi-threaded executor, IMU callbacks are not blocked by points preprocessing.
+  // Extension module subscriptions are kept in the default callback group of the node.
+  imu_callback_group = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  points_callback_group = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  image_callback_group = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  raw_odom_callback_group = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  timer_callback_group = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+
+  rclcpp::SubscriptionOptions imu_options;
+  imu_options.callback_group = imu_callback_group;
+  rclcpp::SubscriptionOptions points_options;
+  points_options.callback_group = points_callback_group;
+  rclcpp::SubscriptionOptions image_options;
+  image_options.callback_group = image_callback_group;
+  rclcpp::SubscriptionOptions raw_odom_options;
+  raw_odom_options.callback_group = raw_odom_callback_group;
+
+  // Reorder the subscribed sensor streams by sensor time before they reach the stages (0 = insert them in arrival order)
+  const double merge_latency = config_ros.param<double>("glim_ros", "merge_latency", 0.0);
+  if (merge_latency > 0.0) {
+    merge_queue.reset(new SensorMergeQueue(
+      merge_latency,
+      imu_time_offset,
+      points_time_offset,
+      [this](double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel) { insert_imu(stamp, linear_acc, angular_vel); },
+      [this](const RawPoints::Ptr& raw_points) { insert_raw_points(raw_points); },
+      [this](double stamp, const cv::Mat& image) { insert_image(stamp, image); }));
+  }
+
   // Subscribers
   auto imu_qos = rclcpp::SensorDataQoS();
   imu_qos.get_rmw_qos_profile().depth = 1000;
-  imu_sub = this->create_subscription<sensor_msgs::msg::Imu>(imu_topic, imu_qos, std::bind(&GlimROS::imu_callback, this, _1));
-  points_sub = this->create_subscription<sensor_msgs::msg::PointCloud2>(points_topic, rclcpp::SensorDataQoS(), std::bind(&GlimROS::points_callback, this, _1));
-  image_sub = image_transport::create_subscription(this, image_topic, std::bind(&GlimROS::image_callback, this, _1), "raw", rmw_qos_profile_sensor_data);
-  raw_odom_sub = this->create_subscription<sensor_msgs::msg::JointState>(wheel_topic, imu_qos, std::bind(&GlimROS::raw_odom_callback, this, _1));
+  if (merge_queue) {
+    imu_sub = this->create_subscription<sensor_msgs::msg::Imu>(
+      imu_topic,
+      imu_qos,
+      [this](const sensor_msgs::msg::Imu::SharedPtr msg) {
+        const double imu_stamp = msg->header.stamp.sec + msg->header.stamp.nanosec / 1e9;
+        const Eigen::Vector3d linear_acc(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z);
+        const Eigen::Vector3d angular_vel(msg->angular_velocity.x, msg->angular_velocity.y, msg->angular_velocity.z);
+        merge_queue->push_imu(imu_stamp, linear_acc, angular_vel);
+      },
+      imu_options);
+  } else {
+    imu_sub = this->create_subscription<sensor_msgs::msg::Imu>(imu_topic, imu_qos, std::bind(&GlimROS::imu_callback, this, _1), imu_options);
+  }
+  points_sub = this->create_subscription<sensor_msgs::msg::PointCloud2>(
+    points_topic,
+    rclcpp::SensorDataQoS(),
+    std::bind(&GlimROS::subscribed_points_callback, this, _1),
+    points_options);
+  if (image_enabled()) {
+    // Images are decoded off the callback thread and handed to the stages in order
+    const int image_decoding_threads = config_ros.param<int>("glim_ros", "image_decoding_threads", 1);
+    const int image_queue_size = config_ros.param<int>("glim_ros", "image_queue_size", 4);
+    image_decoder.reset(new ImageDecoder(image_decoding_threads, image_queue_size, [this](double stamp, const cv::Mat& image) { subscribed_image_callback(stamp, image); }));
+
+    // Compressed images are subscribed directly and decoded into cv::Mat (image_transport would convert them into Image first)
+    if (config_ros.param<bool>("glim_ros", "image_compressed", false)) {
+      compressed_image_sub = this->create_subscription<sensor_msgs::msg::CompressedImage>(
+        image_topic,
+        rclcpp::SensorDataQoS(),
+        std::bind(&GlimROS::compressed_image_callback, this, _1),
+        image_options);
+    } else {
+      image_sub = image_transport::create_subscription(this, image_topic, std::bind(&GlimROS::image_callback, this, _1), "raw", rmw_qos_profile_sensor_data, image_options);
+    }
+  }
+  raw_odom_sub = this->create_subscription<sensor_msgs::msg::JointState>(wheel_topic, imu_qos, std::bind(&GlimROS::raw_odom_callback, this, _1), raw_odom_options);
 
   for (const auto& sub : this->extension_subscriptions()) {
     spdlog::debug("subscribe to {}", sub->topic);
     sub->create_subscriber(*this);
   }
+  end_phase("ros_setup");
+
+  // The stages must be ready before they are connected to the callbacks and the result delivery
+  const double odometry_load_time = odometry_loaded.get();
+  const double sub_mapping_load_time = sub_mapping_loaded.get();
+  const double global_mapping_load_time = global_mapping_loaded.get();
+  end_phase("wait_modules");
+
+  // Notify new outputs of the stages (used for result delivery and flow control)
+  // Each callback announces one result (an estimation frame or a submap) that the stage is about to push to its output queue
+  pipeline_notifier = std::make_shared<PipelineNotifier>();
+  pending_results = std::make_shared<std::atomic<std::int64_t>>(0);
+  std::weak_ptr<PipelineNotifier> notifier = pipeline_notifier;
+  std::weak_ptr<std::atomic<std::int64_t>> pending = pending_results;
+  const auto notify = [notifier, pending] {
+    if (auto locked = pending.lock()) {
+      (*locked)++;
+    }
+    if (auto locked = notifier.lock()) {
+      locked->notify();
+    }
+  };
+
+  OdometryEstimationCallbacks::on_new_frame.add([notify](const EstimationFrame::ConstPtr&) { notify(); });
+
+  // Odometry lag behind the input (for load shedding)
+  std::weak_ptr<std::atomic<double>> odometry_stamp = latest_odometry_stamp;
+  OdometryEstimationCallbacks::on_new_frame.add([odometry_stamp](const EstimationFrame::ConstPtr& frame) {
+    if (auto locked = odometry_stamp.lock()) {
+      *locked = frame->stamp;
+    }
+  });
+  SubMappingCallbacks::on_new_submap.add([notify](const SubMap::ConstPtr&) { notify(); });
+
+  // Per-stage latency instrumentation (stages running in the module threads are timed through their callbacks)
+  pipeline_stats = std::make_shared<PipelineStats>();
+  std::weak_ptr<PipelineStats> stats = pipeline_stats;
+  OdometryEstimationCallbacks::on_insert_frame.add([stats](const PreprocessedFrame::Ptr& frame) {
+    if (auto locked = stats.lock()) {
+      locked->end(PipelineStage::ODOMETRY_QUEUE, frame->stamp);
+      locked->begin(PipelineStage::ODOMETRY, frame->stamp);
+    }
+  });
+  OdometryEstimationCallbacks::on_new_frame.add([stats](const EstimationFrame::ConstPtr& frame) {
+    if (auto locked = stats.lock()) {
+      locked->end(PipelineStage::ODOMETRY, frame->stamp);
+    }
+  });
+  SubMappingCallbacks::on_insert_frame.add([stats](const EstimationFrame::ConstPtr& frame) {
+    if (auto locked = stats.lock()) {
+      locked->end(PipelineStage::SUB_MAPPING_QUEUE, frame->stamp);
+      locked->begin(PipelineStage::SUB_MAPPING, frame->stamp);
+    }
+  });
+  SubMappingCallbacks::on_new_submap.add([stats](const SubMap::ConstPtr&) {
+    if (auto locked = stats.lock()) {
+      locked->end_latest(PipelineStage::SUB_MAPPING);
+    }
+  });
+  GlobalMappingCallbacks::on_insert_submap.add([stats](const SubMap::ConstPtr& submap) {
+    if (auto locked = stats.lock()) {
+      locked->end(PipelineStage::GLOBAL_MAPPING_QUEUE, submap->id);
+      locked->begin(PipelineStage::GLOBAL_MAPPING, submap->id);
+    }
+  });
+  GlobalMappingCallbacks::on_update_submaps.add([stats](const std::vector<SubMap::Ptr>&) {
+    if (auto locked = stats.lock()) {
+      locked->end_latest(PipelineStage::GLOBAL_MAPPING);
+    }
+  });
+
+  // Save settings
+  // save_format: "glim" (dump loadable by glim), "chunked" (chunked map written by MapWriter into <dump>/map), or "both"
+  // The glim dump is always written in full, while the chunked map is written incrementally and finishes early even for large maps.
+  // The chunked map is opt-in because it costs extra disk I/O and holds the submap points until they are written.
+  const std::string save_format = config_ros.param<std::string>("glim_ros", "save_format", "glim");
+  save_glim_dump = save_format != "chunked";
+  save_parallel = config_ros.param<bool>("glim_ros", "save_parallel", true);
+
+  // Periodic checkpoints of the chunked map and the glim dump into checkpoint_path (default: <dump_path>/checkpoint)
+  // The glim dump in <checkpoint_path>/glim is what the mapping can be recovered from (it can be loaded by glim like a final dump),
+  // while the chunked map only holds the submap points and poses. Writing the glim dump blocks the global mapping for a while
+  // on large maps, so checkpoint_glim_dump=false makes checkpoints cheap at the cost of a checkpoint that cannot be loaded back.
+  const double checkpoint_interval = config_ros.param<double>("glim_ros", "checkpoint_interval", 0.0);
+  checkpoint_path = config_ros.param<std::string>("glim_ros", "checkpoint_path", dump_path + "/checkpoint");
+  checkpoint_glim_dump = config_ros.param<bool>("glim_ros", "checkpoint_glim_dump", true);
+  if (checkpoint_interval > 0.0 && !checkpoint_glim_dump) {
+    spdlog::warn("checkpoint_glim_dump is disabled (checkpoints cannot be loaded to recover the mapping)");
+  }
+
+  if (save_format == "chunked" || save_format == "both" || checkpoint_interval > 0.0) {
+    MapWriterParams map_writer_params;
+    map_writer_params.submaps_per_chunk = config_ros.param<int>("glim_ros", "map_chunk_submaps", map_writer_params.submaps_per_chunk);
+    map_writer_params.num_threads = config_ros.param<int>("glim_ros", "map_save_threads", map_writer_params.num_threads);
+    map_writer_params.compress = config_ros.param<bool>("glim_ros", "map_compress", map_writer_params.compress);
+    map_writer = std::make_shared<MapWriter>(map_writer_params);
+
+    std::weak_ptr<MapWriter> writer = map_writer;
+    GlobalMappingCallbacks::on_insert_submap.add([writer](const SubMap::ConstPtr& submap) {
+      if (auto locked = writer.lock()) {
+        locked->insert_submap(submap);
+      }
+    });
+    GlobalMappingCallbacks::on_update_submaps.add([writer](const std::vector<SubMap::Ptr>& submaps) {
+      if (auto locked = writer.lock()) {
+        locked->update_poses(submaps);
+      }
+    });
+  }
+
+  if (save_format != "glim" && save_format != "chunked" && save_format != "both") {
+    spdlog::warn("unknown save_format {} (use glim instead)", save_format);
+  }
+  write_chunked_map = save_format == "chunked" || save_format == "both";
+
+  checkpoint_kill_switch = false;
+  if (checkpoint_interval > 0.0) {
+    spdlog::info("checkpoint every {} sec to {}", checkpoint_interval, checkpoint_path);
+    checkpoint_thread = std::thread([this, checkpoint_interval] { checkpoint_task(checkpoint_interval); });
+  }
+
+  // Publish the statistics on /diagnostics and write them to the dump directory
+  const double stats_interval = config_ros.param<double>("glim_ros", "stats_interval", 5.0);
+  if (stats_interval > 0.0) {
+    diagnostics_pub = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+    stats_timer = this->create_wall_timer(std::chrono::duration<double>(stats_interval), [this]() { publish_stats(); }, timer_callback_group);
+  }
 
-  // Start timer
-  timer = this->create_wall_timer(std::chrono::milliseconds(1), [this]() { timer_callback(); });
+  // Result delivery
+  kill_switch = false;
+  if (config_ros.param<bool>("glim_ros", "event_driven_pipeline", true)) {
+    // Deliver results as soon as the stages notify new outputs. The timer remains as a fallback.
+    pipeline_thread = std::thread([this] { pipeline_task(); });
+
+    timer = this->create_wall_timer(std::chrono::milliseconds(100), [this]() { timer_callback(); }, timer_callback_group);
+  } else {
+    timer = this->create_wall_timer(std::chrono::milliseconds(1), [this]() { timer_callback(); }, timer_callback_group);
+  }
+
+  end_phase("threads");
+
+  std::string breakdown;
+  for (const auto& timing : startup_timings) {
+    breakdown += (boost::format(" %s=%.1fms") % timing.first % (timing.second * 1e3)).str();
+  }
+  spdlog::info("startup took {:.1f}ms:{}", elapsed(startup_t0) * 1e3, breakdown);
+  spdlog::info(
+    "module loading (concurrent={}): odometry={:.1f}ms sub_mapping={:.1f}ms global_mapping={:.1f}ms",
+    launch == std::launch::async,
+    odometry_load_time * 1e3,
+    sub_mapping_load_time * 1e3,
+    global_mapping_load_time * 1e3);
 
   spdlog::debug("initialized");
 }
 
 GlimROS::~GlimROS() {
   spdlog::debug("quit");
+  image_decoder.reset();
+  merge_queue.reset();
+  stop_checkpoint_thread();
+  stop_pipeline_thread();
   extension_modules.clear();
 
   if (dump_on_unload) {
-    std::string dump_path = "/tmp/dump";
     wait(true);
     save(dump_path);
   }
@@ -217,51 +549,243 @@ void GlimROS::raw_odom_callback(const sensor_msgs::msg::JointState::SharedPtr ms
 void GlimROS::imu_callback(const sensor_msgs::msg::Imu::SharedPtr msg) {
   spdlog::trace("IMU: {}.{}", msg->header.stamp.sec, msg->header.stamp.nanosec);
 
-  const double imu_stamp = msg->header.stamp.sec + msg->header.stamp.nanosec / 1e9 + imu_time_offset;
-  const Eigen::Vector3d linear_acc = acc_scale * Eigen::Vector3d(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z);
+  const double imu_stamp = msg->header.stamp.sec + msg->header.stamp.nanosec / 1e9;
+  const Eigen::Vector3d linear_acc(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z);
   const Eigen::Vector3d angular_vel(msg->angular_velocity.x, msg->angular_velocity.y, msg->angular_velocity.z);
 
-  if (!time_keeper->validate_imu_stamp(imu_stamp)) {
-    spdlog::warn("skip an invalid IMU data (stamp={})", imu_stamp);
+  if (imu_batch_size <= 1) {
+    insert_imu(imu_stamp, linear_acc, angular_vel);
     return;
   }
 
-  odometry_estimation->insert_imu(imu_stamp, linear_acc, angular_vel);
+  // The batch is flushed once it is full or its oldest sample is getting stale (bounds the latency added to odometry)
+  bool flush = false;
+  {
+    std::lock_guard<std::mutex> lock(imu_batch_mutex);
+    imu_batch.push_back(imu_stamp, linear_acc, angular_vel);
+    flush = imu_batch.size() >= static_cast<size_t>(imu_batch_size) || imu_stamp - imu_batch.stamps.front() >= imu_batch_max_delay;
+  }
+
+  if (flush) {
+    flush_imu_batch();
+  }
+}
+
+void GlimROS::flush_imu_batch() {
+  if (imu_batch_size <= 1) {
+    return;
+  }
+
+  // The pending batch is swapped out so that imu_callback can keep accumulating while the samples are fanned out.
+  // Both buffers keep their capacity, so flushing does not allocate.
+  std::lock_guard<std::mutex> flush_lock(imu_flush_mutex);
+  {
+    std::lock_guard<std::mutex> lock(imu_batch_mutex);
+    if (imu_batch.empty()) {
+      return;
+    }
+    imu_flushing.swap(imu_batch);
+  }
+
+  insert_imu_batch(imu_flushing);
+  imu_flushing.clear();
+}
+
+void GlimROS::insert_imu_batch(ImuBatch& batch) {
+  // Validate and correct all the samples in place under a single time keeper lock
+  size_t num_valid = 0;
+  {
+    std::lock_guard<std::mutex> lock(time_keeper_mutex);
+    for (size_t i = 0; i < batch.size(); i++) {
+      const double imu_stamp = batch.stamps[i] + imu_time_offset;
+      if (!time_keeper->validate_imu_stamp(imu_stamp)) {
+        spdlog::warn("skip an invalid IMU data (stamp={})", imu_stamp);
+        continue;
+      }
+
+      batch.stamps[num_valid] = imu_stamp;
+      batch.linear_acc[num_valid] = acc_scale * batch.linear_acc[i];
+      batch.angular_vel[num_valid] = batch.angular_vel[i];
+      num_valid++;
+    }
+  }
+  batch.resize(num_valid);
+
+  // The glim stages take single samples into their own input queues, so the same batch is read by reference and
+  // fed stage by stage (each stage queue is filled in a burst instead of interleaving the three stages per sample)
+  const auto insert = [&](auto& stage) {
+    for (size_t i = 0; i < batch.size(); i++) {
+      stage.insert_imu(batch.stamps[i], batch.linear_acc[i], batch.angular_vel[i]);
+    }
+  };
+
+  insert(*odometry_estimation);
   if (sub_mapping) {
-    sub_mapping->insert_imu(imu_stamp, linear_acc, angular_vel);
+    insert(*sub_mapping);
   }
   if (global_mapping) {
-    global_mapping->insert_imu(imu_stamp, linear_acc, angular_vel);
+    insert(*global_mapping);
   }
 }
 
-void GlimROS::image_callback(const sensor_msgs::msg::Image::ConstSharedPtr msg) {
-  spdlog::trace("image: {}.{}", msg->header.stamp.sec, msg->header.stamp.nanosec);
+void GlimROS::insert_imu(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel) {
+  // Samples batched by imu_callback must reach the stages first
+  flush_imu_batch();
+
+  const double imu_stamp = stamp + imu_time_offset;
+  const Eigen::Vector3d scaled_acc = acc_scale * linear_acc;
 
-  auto cv_image = cv_bridge::toCvCopy(msg, "bgr8");
+  {
+    std::lock_guard<std::mutex> lock(time_keeper_mutex);
+    if (!time_keeper->validate_imu_stamp(imu_stamp)) {
+      spdlog::warn("skip an invalid IMU data (stamp={})", imu_stamp);
+      return;
+    }
+  }
 
-  const double stamp = msg->header.stamp.sec + msg->header.stamp.nanosec / 1e9;
-  odometry_estimation->insert_image(stamp, cv_image->image);
+  odometry_estimation->insert_imu(imu_stamp, scaled_acc, angular_vel);
   if (sub_mapping) {
-    sub_mapping->insert_image(stamp, cv_image->image);
+    sub_mapping->insert_imu(imu_stamp, scaled_acc, angular_vel);
   }
   if (global_mapping) {
-    global_mapping->insert_image(stamp, cv_image->image);
+    global_mapping->insert_imu(imu_stamp, scaled_acc, angular_vel);
+  }
+}
+
+void GlimROS::image_callback(const sensor_msgs::msg::Image::ConstSharedPtr msg) {
+  spdlog::trace("image: {}.{}", msg->header.stamp.sec, msg->header.stamp.nanosec);
+
+  if (image_decoder) {
+    image_decoder->submit(msg);
+  }
+}
+
+void GlimROS::compressed_image_callback(const sensor_msgs::msg::CompressedImage::ConstSharedPtr msg) {
+  spdlog::trace("compressed_image: {}.{}", msg->header.stamp.sec, msg->header.stamp.nanosec);
+
+  if (image_decoder) {
+    image_decoder->submit(msg);
+  }
+}
+
+void GlimROS::insert_image(double stamp, const cv::Mat& image) {
+  if (image_to_odometry) {
+    odometry_estimation->insert_image(stamp, image);
+  }
+  if (sub_mapping && image_to_sub_mapping) {
+    sub_mapping->insert_image(stamp, image);
+  }
+  if (global_mapping && image_to_global_mapping) {
+    global_mapping->insert_image(stamp, image);
   }
 }
 
 size_t GlimROS::points_callback(const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg) {
   spdlog::trace("points: {}.{}", msg->header.stamp.sec, msg->header.stamp.nanosec);
 
-  auto raw_points = glim::extract_raw_points(msg);
+  auto raw_points = extract_points(msg);
   if (raw_points == nullptr) {
     spdlog::warn("failed to extract points from message");
     return 0;
   }
 
+  return insert_raw_points(raw_points);
+}
+
+void GlimROS::subscribed_points_callback(const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg) {
+  // Load shedding is evaluated only for the live inputs (the offline tools insert data directly and apply flow control instead)
+  auto& shedding = LoadShedding::instance();
+  const size_t odometry_workload = odometry_estimation->workload();
+  const double odometry_stamp = latest_odometry_stamp->load();
+  const double latency = odometry_stamp > 0.0 ? std::max(0.0, latest_input_stamp - odometry_stamp) : 0.0;
+  const LoadSheddingLevel last_level = shedding.level();
+  if (shedding.update(odometry_workload, latency)) {
+    spdlog::warn(
+      "load shedding level {} -> {} (workload={} latency={:.3f}s)",
+      LoadShedding::level_name(last_level),
+      LoadShedding::level_name(shedding.level()),
+      odometry_workload,
+      latency);
+  }
+
+  if (shedding.active(LoadSheddingLevel::SKIP_FRAMES) && (num_subscribed_frames++ % shedding_frame_skip)) {
+    shedding.count_skipped_frame();
+    return;
+  }
+
+  if (!merge_queue) {
+    points_callback(msg);
+    return;
+  }
+
+  auto raw_points = extract_points(msg);
+  if (raw_points == nullptr) {
+    spdlog::warn("failed to extract points from message");
+    return;
+  }
+  merge_queue->push_points(raw_points);
+}
+
+void GlimROS::subscribed_image_callback(double stamp, const cv::Mat& image) {
+  // Called in the order of the images (by the image decoder), so deferred images can be released here without reordering
+  auto& shedding = LoadShedding::instance();
+  if (shedding.active(LoadSheddingLevel::DEFER_IMAGES)) {
+    if (deferred_images.size() >= static_cast<size_t>(shedding_image_queue_size)) {
+      deferred_images.pop_front();
+      shedding.count_dropped_image();
+    }
+    deferred_images.emplace_back(stamp, image);
+    shedding.count_deferred_image();
+    return;
+  }
+
+  deferred_images.emplace_back(stamp, image);
+  for (const auto& deferred : deferred_images) {
+    if (merge_queue) {
+      merge_queue->push_image(deferred.first, deferred.second);
+    } else {
+      insert_image(deferred.first, deferred.second);
+    }
+  }
+  deferred_images.clear();
+}
+
+RawPoints::Ptr GlimROS::extract_points(const sensor_msgs::msg::PointCloud2::ConstSharedPtr& msg) {
+  const auto t0 = PipelineStats::Clock::now();
+  RawPoints::Ptr raw_points;
+  if (points_layout) {
+    raw_points = PointCloud2View(*msg, points_layout->get(*msg)).to_raw_points();
+  }
+  if (raw_points == nullptr) {
+    // Fallback for layouts not supported by PointCloud2View
+    raw_points = glim::extract_raw_points(msg);
+  }
+
+  pipeline_stats->record(PipelineStage::EXTRACT, PipelineStats::Clock::now() - t0);
+  return raw_points;
+}
+
+size_t GlimROS::insert_raw_points(const RawPoints::Ptr& raw_points) {
+  // IMU samples received before the frame must reach the stages first
+  flush_imu_batch();
+
+  auto t1 = PipelineStats::Clock::now();
+
   raw_points->stamp += points_time_offset;
-  time_keeper->process(raw_points);
-  auto preprocessed = preprocessor->preprocess(raw_points);
+  {
+    std::lock_guard<std::mutex> lock(time_keeper_mutex);
+    time_keeper->process(raw_points);
+  }
+  latest_input_stamp = raw_points->stamp;
+
+  auto t0 = PipelineStats::Clock::now();
+  pipeline_stats->record(PipelineStage::TIME_KEEPER, t0 - t1);
+
+  const bool coarse = coarse_preprocessor && LoadShedding::instance().active(LoadSheddingLevel::COARSE_POINTS);
+  auto preprocessed = (coarse ? coarse_preprocessor : preprocessor)->preprocess(raw_points);
+
+  t1 = PipelineStats::Clock::now();
+  pipeline_stats->record(PipelineStage::PREPROCESS, t1 - t0);
 
   if (keep_raw_points) {
     // note: Raw points are used only in extension modules for visualization purposes.
@@ -269,6 +793,7 @@ size_t GlimROS::points_callback(const sensor_msgs::msg::PointCloud2::ConstShared
     preprocessed->raw_points = raw_points;
   }
 
+  pipeline_stats->begin(PipelineStage::ODOMETRY_QUEUE, preprocessed->stamp);
   odometry_estimation->insert_frame(preprocessed);
 
   const size_t workload = odometry_estimation->workload();
@@ -287,49 +812,308 @@ bool GlimROS::needs_wait() {
   return false;
 }
 
+PipelineWorkload GlimROS::workload() const {
+  PipelineWorkload workload;
+  workload.odometry = odometry_estimation->workload();
+  workload.sub_mapping = sub_mapping ? sub_mapping->workload() : 0;
+  workload.global_mapping = global_mapping ? global_mapping->workload() : 0;
+  return workload;
+}
+
 void GlimROS::timer_callback() {
+  flush_imu_batch();
+
   for (const auto& ext_module : extension_modules) {
     if (!ext_module->ok()) {
       rclcpp::shutdown();
     }
   }
 
+  deliver_results();
+}
+
+size_t GlimROS::deliver_results() {
+  std::lock_guard<std::mutex> lock(results_mutex);
+
   std::vector<glim::EstimationFrame::ConstPtr> estimation_frames;
   std::vector<glim::EstimationFrame::ConstPtr> marginalized_frames;
   odometry_estimation->get_results(estimation_frames, marginalized_frames);
+  size_t delivered = estimation_frames.size();
 
   if (sub_mapping) {
     for (const auto& frame : marginalized_frames) {
+      pipeline_stats->begin(PipelineStage::SUB_MAPPING_QUEUE, frame->stamp);
       sub_mapping->insert_frame(frame);
     }
 
     auto submaps = sub_mapping->get_results();
+    delivered += submaps.size();
     if (global_mapping) {
       for (const auto& submap : submaps) {
+        pipeline_stats->begin(PipelineStage::GLOBAL_MAPPING_QUEUE, submap->id);
         global_mapping->insert_submap(submap);
       }
     }
   }
+
+  *pending_results -= delivered;
+  return delivered;
+}
+
+void GlimROS::pipeline_task() {
+  std::uint64_t generation = pipeline_notifier->generation();
+  while (!kill_switch) {
+    generation = pipeline_notifier->wait(generation, std::chrono::milliseconds(100));
+
+    // Callbacks are invoked by the stages right before they push the results to their output queues.
+    // Keep collecting until every announced result has been delivered, waking up early on new announcements.
+    auto backoff = std::chrono::microseconds(50);
+    auto last_delivery = std::chrono::steady_clock::now();
+    while (!kill_switch && pending_results->load() > 0) {
+      if (deliver_results()) {
+        backoff = std::chrono::microseconds(50);
+        last_delivery = std::chrono::steady_clock::now();
+        continue;
+      }
+
+      // Announced results that never show up would keep this loop polling (should not happen)
+      if (std::chrono::steady_clock::now() - last_delivery > std::chrono::milliseconds(100)) {
+        spdlog::debug("{} announced results were not delivered", pending_results->load());
+        *pending_results = 0;
+        break;
+      }
+
+      generation = pipeline_notifier->wait(generation, backoff);
+      backoff = std::min<std::chrono::microseconds>(backoff * 2, std::chrono::milliseconds(1));
+    }
+  }
+}
+
+void GlimROS::stop_pipeline_thread() {
+  kill_switch = true;
+  pipeline_notifier->notify();
+  if (pipeline_thread.joinable()) {
+    pipeline_thread.join();
+  }
+}
+
+void GlimROS::checkpoint_task(double interval) {
+  std::unique_lock<std::mutex> lock(checkpoint_mutex);
+  while (true) {
+    checkpoint_cv.wait_for(lock, std::chrono::duration<double>(interval), [this] { return checkpoint_kill_switch; });
+    if (checkpoint_kill_switch) {
+      return;
+    }
+
+    lock.unlock();
+    checkpoint();
+    lock.lock();
+  }
+}
+
+void GlimROS::stop_checkpoint_thread() {
+  {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex);
+    checkpoint_kill_switch = true;
+  }
+  checkpoint_cv.notify_all();
+
+  if (checkpoint_thread.joinable()) {
+    checkpoint_thread.join();
+  }
+}
+
+bool GlimROS::checkpoint() {
+  const auto t0 = std::chrono::steady_clock::now();
+
+  std::error_code ec;
+  std::filesystem::create_directories(checkpoint_path, ec);
+
+  // The writer snapshots the submap list (submap points are shared and immutable) and writes only new submaps.
+  // It does not block the global mapping, so it runs on a lowest-priority thread to not compete with the mapping threads.
+  auto map_saved = std::async(std::launch::async, [this] {
+    if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19)) {
+      spdlog::debug("failed to lower the priority of the checkpoint writer thread");
+    }
+    return map_writer && map_writer->save(checkpoint_path + "/map");
+  });
+
+  // The glim dump holds the global mapping lock while it is written but is the only recoverable part (see checkpoint_glim_dump).
+  // It is written at normal priority (on the calling thread) so that the optimization does not wait behind a low-priority thread under load.
+  // It is written into a temporary directory and swapped in so that a crash during the checkpoint keeps the previous one.
+  bool succeeded = true;
+  if (global_mapping && checkpoint_glim_dump) {
+    namespace fs = std::filesystem;
+    const fs::path dump_dir = fs::path(checkpoint_path) / "glim";
+    const fs::path temp_dir = fs::path(checkpoint_path) / "glim.tmp";
+    const fs::path old_dir = fs::path(checkpoint_path) / "glim.old";
+
+    fs::remove_all(temp_dir, ec);
+    fs::create_directories(temp_dir, ec);
+    global_mapping->save(temp_dir.string());
+
+    fs::remove_all(old_dir, ec);
+    fs::rename(dump_dir, old_dir, ec);
+    fs::rename(temp_dir, dump_dir, ec);
+    if (ec) {
+      spdlog::warn("failed to replace the glim dump checkpoint: {}", ec.message());
+      succeeded = false;
+    }
+    fs::remove_all(old_dir, ec);
+  }
+  succeeded = map_saved.get() && succeeded;
+
+  std::ofstream ofs(checkpoint_path + "/checkpoint.txt");
+  ofs << "stamp: " << std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count() << std::endl;
+  ofs << "num_submaps: " << (map_writer ? map_writer->num_submaps() : 0) << std::endl;
+  ofs << "succeeded: " << succeeded << std::endl;
+
+  spdlog::debug("checkpoint written to {} ({:.3f} sec)", checkpoint_path, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+  return succeeded;
+}
+
+void GlimROS::publish_stats() {
+  const auto window = pipeline_stats->window();
+  const auto load = workload();
+
+  auto msg = std::make_unique<diagnostic_msgs::msg::DiagnosticArray>();
+  msg->header.stamp = this->now();
+
+  const auto make_value = [](const std::string& key, const std::string& value) {
+    diagnostic_msgs::msg::KeyValue kv;
+    kv.key = key;
+    kv.value = value;
+    return kv;
+  };
+
+  for (const auto& stage : window) {
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.name = "glim_ros: " + stage.name;
+    status.hardware_id = "glim";
+    status.message = (boost::format("p50=%.3fms p99=%.3fms") % (stage.p50 * 1e3) % (stage.p99 * 1e3)).str();
+    status.values.emplace_back(make_value("count", std::to_string(stage.count)));
+    status.values.emplace_back(make_value("rate_hz", std::to_string(stage.rate)));
+    status.values.emplace_back(make_value("mean_ms", std::to_string(stage.mean * 1e3)));
+    status.values.emplace_back(make_value("p50_ms", std::to_string(stage.p50 * 1e3)));
+    status.values.emplace_back(make_value("p99_ms", std::to_string(stage.p99 * 1e3)));
+    status.values.emplace_back(make_value("max_ms", std::to_string(stage.max * 1e3)));
+    msg->status.emplace_back(status);
+  }
+
+  diagnostic_msgs::msg::DiagnosticStatus workload_status;
+  workload_status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  workload_status.name = "glim_ros: workload";
+  workload_status.hardware_id = "glim";
+  workload_status.values.emplace_back(make_value("odometry", std::to_string(load.odometry)));
+  workload_status.values.emplace_back(make_value("sub_mapping", std::to_string(load.sub_mapping)));
+  workload_status.values.emplace_back(make_value("global_mapping", std::to_string(load.global_mapping)));
+  msg->status.emplace_back(workload_status);
+
+  const auto& shedding = LoadShedding::instance();
+  if (shedding.enabled()) {
+    diagnostic_msgs::msg::DiagnosticStatus shedding_status;
+    shedding_status.level = shedding.level() == LoadSheddingLevel::NONE ? diagnostic_msgs::msg::DiagnosticStatus::OK : diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    shedding_status.name = "glim_ros: load_shedding";
+    shedding_status.hardware_id = "glim";
+    shedding_status.message = LoadShedding::level_name(shedding.level());
+    shedding_status.values.emplace_back(make_value("level", std::to_string(static_cast<int>(shedding.level()))));
+    shedding_status.values.emplace_back(make_value("escalations", std::to_string(shedding.num_escalations())));
+    shedding_status.values.emplace_back(make_value("restorations", std::to_string(shedding.num_restorations())));
+    shedding_status.values.emplace_back(make_value("shedding_time_sec", std::to_string(shedding.shedding_time())));
+    shedding_status.values.emplace_back(make_value("skipped_frames", std::to_string(shedding.num_skipped_frames())));
+    shedding_status.values.emplace_back(make_value("deferred_images", std::to_string(shedding.num_deferred_images())));
+    shedding_status.values.emplace_back(make_value("dropped_images", std::to_string(shedding.num_dropped_images())));
+    msg->status.emplace_back(shedding_status);
+  }
+
+  if (merge_queue) {
+    diagnostic_msgs::msg::DiagnosticStatus merge_status;
+    merge_status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    merge_status.name = "glim_ros: merge_queue";
+    merge_status.hardware_id = "glim";
+    merge_status.values.emplace_back(make_value("held", std::to_string(merge_queue->size())));
+    merge_status.values.emplace_back(make_value("expired", std::to_string(merge_queue->num_expired())));
+    merge_status.values.emplace_back(make_value("late", std::to_string(merge_queue->num_late())));
+    msg->status.emplace_back(merge_status);
+  }
+
+  // Memory usage of the process and the components that report it
+  const auto& memory_usage = MemoryUsage::instance();
+  const size_t rss = MemoryUsage::resident_set_size();
+  diagnostic_msgs::msg::DiagnosticStatus memory_status;
+  memory_status.level = memory_usage.over_budget() ? diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+  memory_status.name = "glim_ros: memory";
+  memory_status.hardware_id = "glim";
+  memory_status.message = (boost::format("rss=%.1fMB") % (rss / 1e6)).str();
+  memory_status.values.emplace_back(make_value("rss_mb", std::to_string(rss / 1e6)));
+  memory_status.values.emplace_back(make_value("budget_mb", std::to_string(memory_usage.budget() / 1e6)));
+  for (const auto& component : memory_usage.components()) {
+    memory_status.values.emplace_back(make_value(component.first + "_mb", std::to_string(component.second / 1e6)));
+  }
+  msg->status.emplace_back(memory_status);
+
+  if (memory_usage.over_budget()) {
+    spdlog::warn("memory usage exceeds the budget (rss={:.1f}MB budget={:.1f}MB)", rss / 1e6, memory_usage.budget() / 1e6);
+  }
+
+  diagnostics_pub->publish(std::move(msg));
+
+  spdlog::debug("pipeline stats\n{}", PipelineStats::format(window));
+  write_stats(dump_path);
+}
+
+void GlimROS::write_stats(const std::string& path) const {
+  std::lock_guard<std::mutex> lock(stats_file_mutex);
+
+  std::error_code ec;
+  std::filesystem::create_directories(path, ec);
+
+  // Replaced by renaming so that readers (and a crash) never see a partially written file
+  const std::string filename = path + "/pipeline_stats.txt";
+  const std::string temp_filename = filename + ".tmp";
+  std::ofstream ofs(temp_filename);
+  ofs << PipelineStats::format(pipeline_stats->total());
+  ofs.close();
+
+  if (!ofs || std::rename(temp_filename.c_str(), filename.c_str())) {
+    spdlog::warn("failed to write pipeline stats to {}", path);
+    std::remove(temp_filename.c_str());
+  }
 }
 
 void GlimROS::wait(bool auto_quit) {
+  if (merge_queue) {
+    merge_queue->flush();
+  }
+  flush_imu_batch();
+
+  stop_checkpoint_thread();
+  stop_pipeline_thread();
+
   spdlog::info("waiting for odometry estimation");
   odometry_estimation->join();
 
   if (sub_mapping) {
     std::vector<glim::EstimationFrame::ConstPtr> estimation_results;
     std::vector<glim::EstimationFrame::ConstPtr> marginalized_frames;
-    odometry_estimation->get_results(estimation_results, marginalized_frames);
-    for (const auto& marginalized_frame : marginalized_frames) {
-      sub_mapping->insert_frame(marginalized_frame);
+    {
+      std::lock_guard<std::mutex> lock(results_mutex);
+      odometry_estimation->get_results(estimation_results, marginalized_frames);
+      for (const auto& marginalized_frame : marginalized_frames) {
+        pipeline_stats->begin(PipelineStage::SUB_MAPPING_QUEUE, marginalized_frame->stamp);
+        sub_mapping->insert_frame(marginalized_frame);
+      }
     }
 
     spdlog::info("waiting for local mapping");
     sub_mapping->join();
 
+    std::lock_guard<std::mutex> lock(results_mutex);
     const auto submaps = sub_mapping->get_results();
     if (global_mapping) {
       for (const auto& submap : submaps) {
+        pipeline_stats->begin(PipelineStage::GLOBAL_MAPPING_QUEUE, submap->id);
         global_mapping->insert_submap(submap);
       }
       spdlog::info("waiting for global mapping");
@@ -348,10 +1132,36 @@ void GlimROS::wait(bool auto_quit) {
 }
 
 void GlimROS::save(const std::string& path) {
-  global_mapping->save(path);
-  for (auto& module : extension_modules) {
-    module->at_exit(path);
+  const auto t0 = std::chrono::steady_clock::now();
+
+  // The global mapping dump, the chunked map (in its own <path>/map directory), and the extension modules write independent files and are saved concurrently
+  std::vector<std::pair<std::string, std::future<void>>> tasks;
+  const auto run = [&](const std::string& name, const std::function<void()>& task) {
+    tasks.emplace_back(name, std::async(save_parallel ? std::launch::async : std::launch::deferred, task));
+  };
+
+  if (global_mapping && save_glim_dump) {
+    run("global_mapping", [this, path] { global_mapping->save(path); });
+  }
+  if (map_writer && write_chunked_map) {
+    run("map_writer", [this, path] { map_writer->save(path + "/map"); });
   }
+  for (size_t i = 0; i < extension_modules.size(); i++) {
+    run("extension_module_" + std::to_string(i), [module = extension_modules[i], path] { module->at_exit(path); });
+  }
+
+  for (auto& task : tasks) {
+    try {
+      task.second.get();
+    } catch (const std::exception& e) {
+      spdlog::error("failed to save {}: {}", task.first, e.what());
+    }
+  }
+
+  // Written after the other outputs so that it does not race with writers that (re)create the directory
+  write_stats(path);
+
+  spdlog::info("saved to {} ({:.3f} sec)", path, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
 }
 
 }  // namespace glim
@@ -0,0 +1,253 @@
+#include <glim_ros/global_map_cache.hpp>
+
+#include <unistd.h>
+#include <cstring>
+#include <random>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <boost/format.hpp>
+#include <spdlog/spdlog.h>
+#include <gtsam_points/types/point_cloud_cpu.hpp>
+#include <glim_ros/point_cloud2_packer.hpp>
+
+namespace glim {
+
+namespace {
+
+const PointCloud2Packing packing(false, false);
+
+}  // namespace
+
+GlobalMapCacheParams::GlobalMapCacheParams() {
+  voxel_resolution = 0.25;
+  translation_tolerance = 1e-3;
+  rotation_tolerance = 1e-3;
+  max_memory = 0;
+}
+
+GlobalMapCache::GlobalMapCache(const GlobalMapCacheParams& params) : params(params), use_clock(0), total_num_points(0) {
+  if (params.spill_dir.empty()) {
+    return;
+  }
+
+  // Spill files go to a directory owned by this instance so that processes (or caches) sharing spill_dir never overwrite each other
+  std::error_code ec;
+  std::filesystem::create_directories(params.spill_dir, ec);
+
+  std::random_device seed;
+  for (int i = 0; i < 8 && spill_path.empty(); i++) {
+    const std::string path = (boost::format("%s/glim_spill_%d_%08x") % params.spill_dir % getpid() % seed()).str();
+    if (std::filesystem::create_directory(path, ec)) {
+      spill_path = path;
+    }
+  }
+
+  if (spill_path.empty()) {
+    spdlog::warn("failed to create a spill directory in {} (local points of evicted submaps are dropped)", params.spill_dir);
+  } else {
+    spdlog::debug("spill directory: {}", spill_path);
+  }
+}
+
+GlobalMapCache::~GlobalMapCache() {
+  if (!spill_path.empty()) {
+    std::error_code ec;
+    std::filesystem::remove_all(spill_path, ec);
+  }
+}
+
+void GlobalMapCache::insert(double stamp, const gtsam_points::PointCloud::ConstPtr& points, const Eigen::Isometry3d& T_world_origin) {
+  Submap submap;
+  submap.stamp = stamp;
+  submap.T_world_origin = T_world_origin;
+  submap.local_points = params.voxel_resolution > 0.0 ? gtsam_points::voxelgrid_sampling(points, params.voxel_resolution) : points;
+  submap.num_points = submap.local_points->size();
+  submap.last_used = use_clock++;
+  submap.evicted = false;
+  transform(submap);
+
+  total_num_points += submap.num_points;
+  submaps.emplace_back(std::move(submap));
+  updated.emplace_back(true);
+
+  if (params.max_memory) {
+    enforce_budget(params.max_memory, true);
+  }
+}
+
+std::vector<int> GlobalMapCache::update_poses(const Poses& poses) {
+  std::vector<int> changed;
+
+  const size_t num_submaps = std::min(poses.size(), submaps.size());
+  for (size_t i = 0; i < num_submaps; i++) {
+    auto& submap = submaps[i];
+    const Eigen::Isometry3d delta = submap.T_world_origin.inverse() * poses[i];
+    const double translation = delta.translation().norm();
+    const double rotation = Eigen::AngleAxisd(delta.linear()).angle();
+    if (translation < params.translation_tolerance && rotation < params.rotation_tolerance) {
+      continue;
+    }
+
+    submap.T_world_origin = poses[i];
+    if (!transform(submap)) {
+      continue;
+    }
+
+    submap.last_used = use_clock++;
+    updated[i] = true;
+    changed.emplace_back(i);
+  }
+
+  if (params.max_memory && !changed.empty()) {
+    enforce_budget(params.max_memory, true);
+  }
+
+  return changed;
+}
+
+size_t GlobalMapCache::memory_usage() const {
+  size_t bytes = 0;
+  for (const auto& submap : submaps) {
+    bytes += submap.world_points.capacity();
+    if (submap.local_points) {
+      bytes += submap.local_points->size() * sizeof(Eigen::Vector4d);
+    }
+  }
+  return bytes;
+}
+
+void GlobalMapCache::enforce_budget(size_t max_bytes, bool allow_eviction) {
+  size_t usage = memory_usage();
+  if (usage <= max_bytes) {
+    return;
+  }
+
+  // Least recently used first (the latest submap is kept because it is likely to be updated soon)
+  std::vector<int> order(submaps.size() ? submaps.size() - 1 : 0);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int lhs, int rhs) { return submaps[lhs].last_used < submaps[rhs].last_used; });
+
+  int num_dropped = 0;
+  for (int i : order) {
+    if (usage <= max_bytes) {
+      break;
+    }
+
+    if (submaps[i].local_points) {
+      usage -= submaps[i].local_points->size() * sizeof(Eigen::Vector4d);
+      spill(i);
+      num_dropped += submaps[i].spill_file.empty();
+    }
+  }
+
+  if (num_dropped) {
+    spdlog::warn("dropped local points of {} submaps without a spill directory (they no longer follow pose corrections and the published map may be stale)", num_dropped);
+  }
+
+  if (usage <= max_bytes) {
+    return;
+  }
+
+  if (!allow_eviction) {
+    return;
+  }
+
+  int num_evicted = 0;
+  for (int i : order) {
+    if (usage <= max_bytes) {
+      break;
+    }
+
+    auto& submap = submaps[i];
+    if (!submap.evicted) {
+      usage -= submap.world_points.capacity();
+      total_num_points -= submap.num_points;
+      std::vector<std::uint8_t>().swap(submap.world_points);
+      submap.evicted = true;
+      num_evicted++;
+    }
+  }
+
+  spdlog::debug("evicted {} submaps from the global map cache (usage={} bytes)", num_evicted, usage);
+}
+
+void GlobalMapCache::spill(int i) {
+  auto& submap = submaps[i];
+
+  if (!spill_path.empty()) {
+    const std::string filename = (boost::format("%s/submap_%06d.bin") % spill_path % i).str();
+    std::ofstream ofs(filename, std::ios::binary);
+    for (size_t j = 0; j < submap.local_points->size(); j++) {
+      const Eigen::Vector3f pt = submap.local_points->points[j].head<3>().cast<float>();
+      ofs.write(reinterpret_cast<const char*>(pt.data()), sizeof(float) * 3);
+    }
+
+    if (ofs) {
+      submap.spill_file = filename;
+    } else {
+      spdlog::warn("failed to spill submap points to {}", filename);
+    }
+  }
+
+  submap.local_points.reset();
+}
+
+std::vector<int> GlobalMapCache::take_updated() {
+  std::vector<int> indices;
+  for (size_t i = 0; i < updated.size(); i++) {
+    if (updated[i]) {
+      indices.emplace_back(i);
+      updated[i] = false;
+    }
+  }
+  return indices;
+}
+
+void GlobalMapCache::submap_to_pointcloud2(int i, const std::string& frame_id, sensor_msgs::msg::PointCloud2& msg) const {
+  const auto& submap = submaps[i];
+  init_pointcloud2(frame_id, submap.stamp, submap.world_points.size() / packing.point_step, packing, msg);
+  std::memcpy(msg.data.data(), submap.world_points.data(), submap.world_points.size());
+}
+
+void GlobalMapCache::to_pointcloud2(const std::string& frame_id, double stamp, sensor_msgs::msg::PointCloud2& msg) const {
+  init_pointcloud2(frame_id, stamp, total_num_points, packing, msg);
+
+  std::uint8_t* data = msg.data.data();
+  for (const auto& submap : submaps) {
+    std::memcpy(data, submap.world_points.data(), submap.world_points.size());
+    data += submap.world_points.size();
+  }
+}
+
+bool GlobalMapCache::transform(Submap& submap) const {
+  if (submap.evicted) {
+    return false;
+  }
+
+  gtsam_points::PointCloud::ConstPtr local_points = submap.local_points;
+  if (!local_points) {
+    if (submap.spill_file.empty()) {
+      // Local points were dropped without a spill directory (world points are kept at the last pose)
+      return false;
+    }
+
+    // Reload spilled points only for re-transformation
+    std::vector<Eigen::Vector3f> spilled(submap.num_points);
+    std::ifstream ifs(submap.spill_file, std::ios::binary);
+    ifs.read(reinterpret_cast<char*>(spilled.data()), sizeof(Eigen::Vector3f) * spilled.size());
+    if (!ifs) {
+      spdlog::warn("failed to read spilled submap points from {}", submap.spill_file);
+      return false;
+    }
+
+    local_points = std::make_shared<gtsam_points::PointCloudCPU>(spilled.data(), spilled.size());
+  }
+
+  submap.world_points.resize(packing.point_step * local_points->size());
+  transform_and_pack(submap.T_world_origin, *local_points, packing, submap.world_points.data());
+  return true;
+}
+
+}  // namespace glim
@@ -0,0 +1,154 @@
+#include <glim_ros/image_decoder.hpp>
+
+#include <spdlog/spdlog.h>
+#include <opencv2/imgcodecs.hpp>
+#include <glim_ros/ros_compatibility.hpp>
+
+namespace glim {
+
+namespace {
+
+template <typename Stamp>
+double to_sec(const Stamp& stamp) {
+  return stamp.sec + stamp.nanosec / 1e9;
+}
+
+}  // namespace
+
+ImageDecoder::ImageDecoder(int num_threads, int max_queue_size, const Callback& callback)
+: max_queue_size(std::max(1, max_queue_size)),
+  callback(callback),
+  kill_switch(false),
+  num_submitted(0),
+  num_emitted(0),
+  num_dropped_(0) {
+  for (int i = 0; i < num_threads; i++) {
+    decoding_threads.emplace_back([this] { decoding_task(); });
+  }
+}
+
+ImageDecoder::~ImageDecoder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    kill_switch = true;
+  }
+  task_submitted.notify_all();
+
+  for (auto& thread : decoding_threads) {
+    thread.join();
+  }
+}
+
+void ImageDecoder::submit(const sensor_msgs::msg::Image::ConstSharedPtr& msg) {
+  submit(Task{0, msg, nullptr});
+}
+
+void ImageDecoder::submit(const sensor_msgs::msg::CompressedImage::ConstSharedPtr& msg) {
+  submit(Task{0, nullptr, msg});
+}
+
+bool ImageDecoder::decode(const sensor_msgs::msg::Image& msg, cv::Mat& image) {
+  try {
+    image = cv_bridge::toCvCopy(msg, "bgr8")->image;
+  } catch (const std::exception& e) {
+    spdlog::warn("failed to convert image (encoding={}): {}", msg.encoding, e.what());
+    return false;
+  }
+  return true;
+}
+
+bool ImageDecoder::decode(const sensor_msgs::msg::CompressedImage& msg, cv::Mat& image) {
+  try {
+    // imdecode writes BGR8 directly (no intermediate Image message)
+    image = cv::imdecode(msg.data, cv::IMREAD_COLOR);
+  } catch (const std::exception& e) {
+    spdlog::warn("failed to decode compressed image (format={}): {}", msg.format, e.what());
+    return false;
+  }
+
+  if (image.empty()) {
+    spdlog::warn("failed to decode compressed image (format={})", msg.format);
+    return false;
+  }
+  return true;
+}
+
+void ImageDecoder::submit(Task&& task) {
+  if (decoding_threads.empty()) {
+    cv::Mat image;
+    const bool decoded = task.image ? decode(*task.image, image) : decode(*task.compressed_image, image);
+    const double stamp = task.image ? to_sec(task.image->header.stamp) : to_sec(task.compressed_image->header.stamp);
+    if (decoded) {
+      callback(stamp, image);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (num_submitted - num_emitted >= static_cast<size_t>(max_queue_size)) {
+      num_dropped_++;
+      spdlog::debug("image decoder is saturated (dropped={})", num_dropped_.load());
+      return;
+    }
+
+    task.seq = num_submitted++;
+    tasks.emplace_back(std::move(task));
+  }
+  task_submitted.notify_one();
+}
+
+void ImageDecoder::decoding_task() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      task_submitted.wait(lock, [&] { return kill_switch || !tasks.empty(); });
+      if (kill_switch) {
+        return;
+      }
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    cv::Mat image;
+    const bool decoded = task.image ? decode(*task.image, image) : decode(*task.compressed_image, image);
+    const double stamp = task.image ? to_sec(task.image->header.stamp) : to_sec(task.compressed_image->header.stamp);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      // Failed images are kept as empty placeholders so that their successors are not blocked
+      completed.emplace(task.seq, std::make_pair(stamp, decoded ? image : cv::Mat()));
+    }
+
+    emit_completed();
+  }
+}
+
+void ImageDecoder::emit_completed() {
+  std::lock_guard<std::mutex> emit_lock(emit_mutex);
+
+  while (true) {
+    std::pair<double, cv::Mat> next;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      const auto found = completed.find(num_emitted);
+      if (found == completed.end()) {
+        return;
+      }
+
+      next = std::move(found->second);
+      completed.erase(found);
+    }
+
+    if (!next.second.empty()) {
+      callback(next.first, next.second);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    num_emitted++;
+  }
+}
+
+}  // namespace glim
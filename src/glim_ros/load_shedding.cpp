@@ -0,0 +1,10 @@
+#include <glim_ros/load_shedding.hpp>
+
+namespace glim {
+
+LoadShedding& LoadShedding::instance() {
+  static LoadShedding shedding;
+  return shedding;
+}
+
+}  // namespace glim
@@ -0,0 +1,182 @@
+#include <glim_ros/map_server.hpp>
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#define GLIM_ROS2
+#include <glim/mapping/callbacks.hpp>
+#include <glim/util/logging.hpp>
+#include <glim/util/config.hpp>
+#include <glim_ros/cloud_encoding.hpp>
+#include <glim_ros/memory_usage.hpp>
+#include <glim_ros/task_scheduler.hpp>
+#include <glim_ros/load_shedding.hpp>
+
+namespace glim {
+
+MapServer::MapServer() : logger(create_module_logger("map_server")) {
+  const Config config(GlobalConfig::get_config_path("config_ros"));
+
+  map_frame_id = config.param<std::string>("glim_ros", "map_frame_id", "map");
+  max_points = config.param<int>("glim_ros", "map_server_max_points", 2000000);
+  rebuild_threads = std::max(1, config.param<int>("glim_ros", "map_server_rebuild_threads", 2));
+
+  TiledMapParams params;
+  params.tile_size = config.param<double>("glim_ros", "map_server_tile_size", params.tile_size);
+  params.translation_tolerance = config.param<double>("glim_ros", "map_server_translation_tolerance", params.translation_tolerance);
+  params.rotation_tolerance = config.param<double>("glim_ros", "map_server_rotation_tolerance", params.rotation_tolerance);
+
+  std::vector<double> lod_resolutions = config.param<std::vector<double>>("glim_ros", "map_server_lod_resolutions", params.lod_resolutions);
+  lod_resolutions.erase(std::remove_if(lod_resolutions.begin(), lod_resolutions.end(), [](double r) { return r <= 0.0; }), lod_resolutions.end());
+  std::sort(lod_resolutions.begin(), lod_resolutions.end());
+  if (lod_resolutions.empty()) {
+    logger->warn("no valid map_server_lod_resolutions (use the default levels)");
+  } else {
+    params.lod_resolutions = lod_resolutions;
+  }
+
+  map.reset(new TiledMap(params));
+  logger->info("tile_size={} lod_levels={} (resolution={}-{})", params.tile_size, params.lod_resolutions.size(), params.lod_resolutions.front(), params.lod_resolutions.back());
+
+  using std::placeholders::_1;
+  GlobalMappingCallbacks::on_update_submaps.add(std::bind(&MapServer::on_update_submaps, this, _1));
+}
+
+MapServer::~MapServer() {
+  if (update_task) {
+    update_task->cancel();
+  }
+}
+
+std::vector<GenericTopicSubscription::Ptr> MapServer::create_subscriptions(rclcpp::Node& node) {
+  const Config config(GlobalConfig::get_config_path("config_ros"));
+  const double update_interval = config.param<double>("glim_ros", "map_server_update_interval", 1.0);
+
+  // Responses follow use_sim_time of the node
+  clock = node.get_clock();
+  const CloudEncoding region_encoding = CloudEncoding::load(config, "map_region");
+  if (region_encoding.enabled()) {
+    region_encoder.reset(new CloudEncoder(region_encoding));
+  }
+
+  // Queries wait for the tile rebuild holding the map, so they are served in their own callback group to keep the other callbacks running
+  service_group = node.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  region_service = node.create_service<GetMapRegion>(
+    "~/get_map_region",
+    [this](const GetMapRegion::Request::SharedPtr request, GetMapRegion::Response::SharedPtr response) { on_request(request, response); },
+    rmw_qos_profile_services_default,
+    service_group);
+
+  // Tiles are rebuilt at NORMAL priority so that the rebuild never occupies the workers left for LOW tasks (e.g., the viewer),
+  // and the task is woken when a submap arrives
+  std::lock_guard<std::mutex> lock(input_mutex);
+  const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(update_interval));
+  update_task = TaskScheduler::instance().schedule_periodic("map_server", interval, TaskPriority::NORMAL, [this] { update(); });
+
+  return {};
+}
+
+void MapServer::on_update_submaps(const std::vector<SubMap::Ptr>& submaps) {
+  const SubMap::ConstPtr latest_submap = submaps.back();
+
+  TiledMap::Poses poses(submaps.size());
+  for (size_t i = 0; i < submaps.size(); i++) {
+    poses[i] = submaps[i]->T_world_origin;
+  }
+
+  std::shared_ptr<PeriodicTask> task;
+  {
+    std::lock_guard<std::mutex> lock(input_mutex);
+    new_submaps.emplace_back(SubmapUpdate{latest_submap->odom_frames.front()->stamp, latest_submap->frame, latest_submap->T_world_origin});
+    latest_poses = std::move(poses);
+    task = update_task;
+  }
+
+  if (task) {
+    task->wake();
+  }
+}
+
+void MapServer::on_request(const GetMapRegion::Request::SharedPtr& request, const GetMapRegion::Response::SharedPtr& response) {
+  TiledMap::Query query;
+  query.min_pt << request->min_pt.x, request->min_pt.y, request->min_pt.z;
+  query.max_pt << request->max_pt.x, request->max_pt.y, request->max_pt.z;
+  query.resolution = request->resolution;
+  query.max_points = request->max_points ? std::min<size_t>(request->max_points, max_points) : max_points;
+
+  // Z bounds may be infinite, but XY bounds determine the tiles to visit
+  if (!query.min_pt.head<2>().allFinite() || !query.max_pt.head<2>().allFinite() || (query.max_pt.array() < query.min_pt.array()).any()) {
+    response->success = false;
+    response->message = "invalid region (XY bounds must be finite and min_pt must not exceed max_pt)";
+    logger->warn(response->message);
+    return;
+  }
+
+  if (!(query.resolution >= 0.0)) {
+    response->success = false;
+    response->message = "invalid resolution (must be non-negative)";
+    logger->warn(response->message);
+    return;
+  }
+
+  sensor_msgs::msg::PointCloud2 points;
+  {
+    std::lock_guard<std::mutex> lock(map_mutex);
+    response->level = map->query(query, map_frame_id, clock->now().seconds(), points);
+  }
+
+  if (region_encoder) {
+    region_encoder->encode(points, response->points);
+  } else {
+    response->points = std::move(points);
+  }
+
+  response->success = true;
+  logger->debug("served map region (level={} num_points={})", response->level, response->points.width);
+}
+
+void MapServer::update() {
+  std::vector<SubmapUpdate> submaps;
+  TiledMap::Poses poses;
+  {
+    std::lock_guard<std::mutex> lock(input_mutex);
+    submaps.swap(new_submaps);
+    poses.swap(latest_poses);
+  }
+
+  std::lock_guard<std::mutex> lock(map_mutex);
+
+  for (const auto& submap : submaps) {
+    map->insert(submap.stamp, submap.points, submap.T_world_origin);
+  }
+
+  if (!poses.empty()) {
+    const int num_moved = map->update_poses(poses);
+    if (num_moved) {
+      logger->debug("{} submaps moved", num_moved);
+    }
+  }
+
+  // Tile rebuilding is deferred while load shedding is active (dirty tiles are kept and rebuilt later)
+  if (map->num_dirty() && !LoadShedding::instance().active(LoadSheddingLevel::PAUSE_VIEWER)) {
+    const auto t1 = std::chrono::steady_clock::now();
+    const auto rebuilt = map->rebuild(rebuild_threads);
+    const auto t2 = std::chrono::steady_clock::now();
+
+    MemoryUsage::instance().report("map_server", map->memory_usage());
+    logger->debug(
+      "rebuilt {} tiles in {:.3f}ms (submaps={} tiles={})",
+      rebuilt.size(),
+      std::chrono::duration<double>(t2 - t1).count() * 1e3,
+      map->num_submaps(),
+      map->num_tiles());
+  }
+}
+
+}  // namespace glim
+
+extern "C" glim::ExtensionModule* create_extension_module() {
+  return new glim::MapServer();
+}
@@ -0,0 +1,305 @@
+#include <glim_ros/map_writer.hpp>
+
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <boost/format.hpp>
+#include <spdlog/spdlog.h>
+
+#ifdef GLIM_ROS_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace glim {
+
+namespace {
+
+constexpr char chunk_magic[8] = {'G', 'L', 'I', 'M', 'C', 'H', 'N', 'K'};
+constexpr std::uint32_t chunk_version = 1;
+
+template <typename T>
+void append(std::vector<std::uint8_t>& buffer, const T& value) {
+  const size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(T));
+  std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+}  // namespace
+
+MapWriterParams::MapWriterParams() {
+  submaps_per_chunk = 16;
+  num_threads = 4;
+  compress = false;
+}
+
+MapWriter::MapWriter(const MapWriterParams& params) : params(params) {
+#ifndef GLIM_ROS_HAS_ZLIB
+  if (params.compress) {
+    spdlog::warn("map chunk compression is not available (built without zlib)");
+  }
+#endif
+}
+
+MapWriter::~MapWriter() {}
+
+void MapWriter::insert_submap(const SubMap::ConstPtr& submap) {
+  if (!submap->frame) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  submap_index[submap->id] = submaps.size();
+  submaps.emplace_back(Submap{submap->id, submap->T_world_origin, submap->frame->size(), submap->frame});
+}
+
+void MapWriter::update_poses(const std::vector<SubMap::Ptr>& updated) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& submap : updated) {
+    const auto found = submap_index.find(submap->id);
+    if (found != submap_index.end()) {
+      submaps[found->second].T_world_origin = submap->T_world_origin;
+    }
+  }
+}
+
+size_t MapWriter::num_submaps() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return submaps.size();
+}
+
+bool MapWriter::save(const std::string& path) {
+  std::lock_guard<std::mutex> save_lock(save_mutex);
+
+  // Snapshot the submap list (point clouds are shared and immutable)
+  std::vector<Submap> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = submaps;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(path, ec);
+  if (ec) {
+    spdlog::warn("failed to create {}: {}", path, ec.message());
+    return false;
+  }
+
+  // Chunk states are kept per output path so that saving to the checkpoint and to the final path do not invalidate each other
+  const std::string key = std::filesystem::weakly_canonical(path, ec).string();
+  auto& chunks = saved_chunks[ec ? path : key];
+
+  // Chunks to be (re)written: new chunks and the last chunk if it was partial
+  const size_t submaps_per_chunk = std::max(1, params.submaps_per_chunk);
+  const size_t num_chunks = (snapshot.size() + submaps_per_chunk - 1) / submaps_per_chunk;
+  std::vector<size_t> dirty_chunks;
+  chunks.resize(num_chunks);
+  size_t num_linked = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    const size_t expected = std::min(submaps_per_chunk, snapshot.size() - i * submaps_per_chunk);
+    if (chunks[i].num_submaps == expected) {
+      continue;
+    }
+
+    // Submaps are append-only and immutable, so a chunk with the same number of submaps in another path has the same content
+    bool linked = false;
+    for (const auto& [src_path, src_chunks] : saved_chunks) {
+      if (&src_chunks != &chunks && i < src_chunks.size() && src_chunks[i].num_submaps == expected && link_chunk(src_path, path, src_chunks[i])) {
+        chunks[i] = src_chunks[i];
+        linked = true;
+        num_linked++;
+        break;
+      }
+    }
+
+    if (!linked) {
+      dirty_chunks.emplace_back(i);
+    }
+  }
+
+  // Encode and write the chunks in parallel
+  std::atomic_size_t cursor(0);
+  std::atomic_bool succeeded(true);
+  const auto task = [&] {
+    for (size_t i = cursor++; i < dirty_chunks.size(); i = cursor++) {
+      const size_t chunk_id = dirty_chunks[i];
+      const auto first = snapshot.begin() + chunk_id * submaps_per_chunk;
+      const auto last = snapshot.begin() + std::min(snapshot.size(), (chunk_id + 1) * submaps_per_chunk);
+      Chunk chunk;
+      if (write_chunk(path, chunk_id, std::vector<Submap>(first, last), chunk)) {
+        chunks[chunk_id] = chunk;
+      } else {
+        chunks[chunk_id] = Chunk();
+        succeeded = false;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  const size_t num_threads = std::min<size_t>(std::max(1, params.num_threads), dirty_chunks.size());
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(task);
+  }
+  task();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (!succeeded) {
+    return false;
+  }
+
+  // Full chunks never change, and saves to other paths link the written file, so their points are no longer needed
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < num_chunks && chunks[i].num_submaps == submaps_per_chunk; i++) {
+      for (size_t j = i * submaps_per_chunk; j < (i + 1) * submaps_per_chunk; j++) {
+        submaps[j].points.reset();
+      }
+    }
+  }
+
+  spdlog::debug("{} / {} map chunks written to {} ({} linked)", dirty_chunks.size(), num_chunks, path, num_linked);
+  return write_manifest(path, snapshot, chunks);
+}
+
+bool MapWriter::write_chunk(const std::string& path, size_t chunk_id, const std::vector<Submap>& chunk_submaps, Chunk& chunk) const {
+  chunk.filename = (boost::format("chunk_%06d.bin") % chunk_id).str();
+  chunk.num_submaps = chunk_submaps.size();
+  chunk.num_points = 0;
+
+  std::vector<std::uint8_t> payload;
+  for (const auto& submap : chunk_submaps) {
+    const auto& points = submap.points;
+    if (!points) {
+      spdlog::warn("points of submap {} were released and chunk {} cannot be linked from a previous save", submap.id, chunk_id);
+      return false;
+    }
+
+    const std::uint32_t flags = points->intensities ? 1 : 0;
+    append<std::int32_t>(payload, submap.id);
+    append<std::uint32_t>(payload, flags);
+    append<std::uint64_t>(payload, points->size());
+
+    payload.reserve(payload.size() + sizeof(float) * points->size() * 4);
+    for (size_t i = 0; i < points->size(); i++) {
+      const Eigen::Vector3f pt = points->points[i].head<3>().cast<float>();
+      append(payload, pt.x());
+      append(payload, pt.y());
+      append(payload, pt.z());
+    }
+    if (flags & 1) {
+      for (size_t i = 0; i < points->size(); i++) {
+        append(payload, static_cast<float>(points->intensities[i]));
+      }
+    }
+
+    chunk.num_points += points->size();
+  }
+
+  const std::uint64_t raw_size = payload.size();
+  std::uint32_t compressed = 0;
+
+#ifdef GLIM_ROS_HAS_ZLIB
+  if (params.compress) {
+    uLongf compressed_size = compressBound(payload.size());
+    std::vector<std::uint8_t> compressed_payload(compressed_size);
+    if (compress2(compressed_payload.data(), &compressed_size, payload.data(), payload.size(), Z_BEST_SPEED) == Z_OK) {
+      compressed_payload.resize(compressed_size);
+      payload.swap(compressed_payload);
+      compressed = 1;
+    } else {
+      spdlog::warn("failed to compress map chunk {} (stored uncompressed)", chunk_id);
+    }
+  }
+#endif
+
+  // Written to a temporary file and renamed so that the previous chunk stays valid until it is replaced
+  const std::string filename = path + "/" + chunk.filename;
+  const std::string temp_filename = filename + ".tmp";
+  std::ofstream ofs(temp_filename, std::ios::binary);
+  const std::uint64_t stored_size = payload.size();
+  ofs.write(chunk_magic, sizeof(chunk_magic));
+  ofs.write(reinterpret_cast<const char*>(&chunk_version), sizeof(chunk_version));
+  ofs.write(reinterpret_cast<const char*>(&compressed), sizeof(compressed));
+  ofs.write(reinterpret_cast<const char*>(&raw_size), sizeof(raw_size));
+  ofs.write(reinterpret_cast<const char*>(&stored_size), sizeof(stored_size));
+  ofs.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+  ofs.close();
+
+  if (!ofs || std::rename(temp_filename.c_str(), filename.c_str())) {
+    spdlog::warn("failed to write map chunk {}", filename);
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+
+  chunk.stored_bytes = sizeof(chunk_magic) + sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t) * 2 + stored_size;
+  return true;
+}
+
+bool MapWriter::link_chunk(const std::string& src_path, const std::string& dst_path, const Chunk& chunk) const {
+  // Chunk files are replaced by renaming and never modified in place, so the source and the link can be updated independently
+  const std::string filename = dst_path + "/" + chunk.filename;
+  const std::string temp_filename = filename + ".tmp";
+  const std::string src_filename = src_path + "/" + chunk.filename;
+
+  std::error_code ec;
+  std::filesystem::remove(temp_filename, ec);
+  std::filesystem::create_hard_link(src_filename, temp_filename, ec);
+  if (ec) {
+    ec.clear();
+    std::filesystem::copy_file(src_filename, temp_filename, ec);
+  }
+
+  if (ec || std::rename(temp_filename.c_str(), filename.c_str())) {
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool MapWriter::write_manifest(const std::string& path, const std::vector<Submap>& manifest_submaps, const std::vector<Chunk>& manifest_chunks) const {
+  const size_t submaps_per_chunk = std::max(1, params.submaps_per_chunk);
+  const std::string filename = path + "/manifest.json";
+  const std::string temp_filename = filename + ".tmp";
+
+  std::ofstream ofs(temp_filename);
+  ofs << "{\n";
+  ofs << "  \"version\": " << chunk_version << ",\n";
+  ofs << "  \"submaps_per_chunk\": " << submaps_per_chunk << ",\n";
+
+  ofs << "  \"chunks\": [\n";
+  for (size_t i = 0; i < manifest_chunks.size(); i++) {
+    const auto& chunk = manifest_chunks[i];
+    ofs << boost::format("    {\"file\": \"%s\", \"num_submaps\": %d, \"num_points\": %d, \"bytes\": %d}") % chunk.filename % chunk.num_submaps % chunk.num_points %
+             chunk.stored_bytes;
+    ofs << (i + 1 < manifest_chunks.size() ? ",\n" : "\n");
+  }
+  ofs << "  ],\n";
+
+  ofs << "  \"submaps\": [\n";
+  for (size_t i = 0; i < manifest_submaps.size(); i++) {
+    const auto& submap = manifest_submaps[i];
+    const Eigen::Matrix4d T = submap.T_world_origin.matrix();
+    ofs << boost::format("    {\"id\": %d, \"chunk\": %d, \"num_points\": %d, \"T_world_origin\": [") % submap.id % (i / submaps_per_chunk) % submap.num_points;
+    for (int j = 0; j < 16; j++) {
+      ofs << boost::format("%.9g") % T(j / 4, j % 4) << (j < 15 ? ", " : "");
+    }
+    ofs << "]}" << (i + 1 < manifest_submaps.size() ? ",\n" : "\n");
+  }
+  ofs << "  ]\n";
+  ofs << "}\n";
+  ofs.close();
+
+  if (!ofs || std::rename(temp_filename.c_str(), filename.c_str())) {
+    spdlog::warn("failed to write map manifest {}", filename);
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace glim
@@ -0,0 +1,10 @@
+#include <glim_ros/memory_usage.hpp>
+
+namespace glim {
+
+MemoryUsage& MemoryUsage::instance() {
+  static MemoryUsage usage;
+  return usage;
+}
+
+}  // namespace glim
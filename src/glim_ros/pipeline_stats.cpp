@@ -0,0 +1,143 @@
+#include <glim_ros/pipeline_stats.hpp>
+
+#include <sstream>
+#include <boost/format.hpp>
+
+namespace glim {
+
+namespace {
+
+// Begins without matching ends (e.g., frames rejected by a stage) are discarded beyond this
+constexpr size_t max_pending = 1024;
+
+}  // namespace
+
+PipelineStats::PipelineStats() : t0(Clock::now()), last_window_time(t0) {}
+
+PipelineStats::~PipelineStats() {}
+
+const char* PipelineStats::stage_name(PipelineStage stage) {
+  switch (stage) {
+    case PipelineStage::EXTRACT:
+      return "extract";
+    case PipelineStage::TIME_KEEPER:
+      return "time_keeper";
+    case PipelineStage::PREPROCESS:
+      return "preprocess";
+    case PipelineStage::ODOMETRY_QUEUE:
+      return "odometry_queue";
+    case PipelineStage::ODOMETRY:
+      return "odometry";
+    case PipelineStage::SUB_MAPPING_QUEUE:
+      return "sub_mapping_queue";
+    case PipelineStage::SUB_MAPPING:
+      return "sub_mapping";
+    case PipelineStage::GLOBAL_MAPPING_QUEUE:
+      return "global_mapping_queue";
+    case PipelineStage::GLOBAL_MAPPING:
+      return "global_mapping";
+    default:
+      return "unknown";
+  }
+}
+
+void PipelineStats::begin(PipelineStage stage, double key) {
+  auto& p = pending[static_cast<int>(stage)];
+  std::lock_guard<std::mutex> lock(p.mutex);
+  p.queue.emplace_back(key, Clock::now());
+  if (p.queue.size() > max_pending) {
+    p.queue.pop_front();
+  }
+}
+
+void PipelineStats::end(PipelineStage stage, double key) {
+  const auto now = Clock::now();
+
+  auto& p = pending[static_cast<int>(stage)];
+  std::unique_lock<std::mutex> lock(p.mutex);
+  while (!p.queue.empty() && p.queue.front().first < key) {
+    p.queue.pop_front();
+  }
+
+  if (p.queue.empty() || p.queue.front().first != key) {
+    return;
+  }
+
+  const auto begin_time = p.queue.front().second;
+  p.queue.pop_front();
+  lock.unlock();
+
+  record(stage, now - begin_time);
+}
+
+void PipelineStats::end_latest(PipelineStage stage) {
+  const auto now = Clock::now();
+
+  auto& p = pending[static_cast<int>(stage)];
+  std::unique_lock<std::mutex> lock(p.mutex);
+  if (p.queue.empty()) {
+    return;
+  }
+
+  const auto begin_time = p.queue.back().second;
+  p.queue.clear();
+  lock.unlock();
+
+  record(stage, now - begin_time);
+}
+
+std::vector<PipelineStats::StageSummary> PipelineStats::window() {
+  // Taken under the lock so that concurrent window() calls do not split the window max between them
+  std::lock_guard<std::mutex> lock(window_mutex);
+  std::array<LatencyHistogram::Snapshot, num_stages> snapshots;
+  for (int i = 0; i < num_stages; i++) {
+    snapshots[i] = histograms[i].take_window();
+  }
+
+  const auto now = Clock::now();
+  const double duration = std::chrono::duration<double>(now - last_window_time).count();
+
+  std::array<LatencyHistogram::Snapshot, num_stages> diffs;
+  for (int i = 0; i < num_stages; i++) {
+    diffs[i] = snapshots[i] - last_window[i];
+  }
+
+  last_window_time = now;
+  last_window = snapshots;
+  return summarize(diffs, duration);
+}
+
+std::vector<PipelineStats::StageSummary> PipelineStats::total() const {
+  std::array<LatencyHistogram::Snapshot, num_stages> snapshots;
+  for (int i = 0; i < num_stages; i++) {
+    snapshots[i] = histograms[i].snapshot();
+  }
+  return summarize(snapshots, std::chrono::duration<double>(Clock::now() - t0).count());
+}
+
+std::vector<PipelineStats::StageSummary> PipelineStats::summarize(const std::array<LatencyHistogram::Snapshot, num_stages>& snapshots, double duration) const {
+  std::vector<StageSummary> summaries(num_stages);
+  for (int i = 0; i < num_stages; i++) {
+    const auto& snapshot = snapshots[i];
+    auto& summary = summaries[i];
+    summary.name = stage_name(static_cast<PipelineStage>(i));
+    summary.count = snapshot.count;
+    summary.rate = duration > 0.0 ? snapshot.count / duration : 0.0;
+    summary.mean = snapshot.mean();
+    summary.p50 = snapshot.quantile(0.5);
+    summary.p99 = snapshot.quantile(0.99);
+    summary.max = snapshot.max();
+  }
+  return summaries;
+}
+
+std::string PipelineStats::format(const std::vector<StageSummary>& summaries) {
+  std::stringstream sst;
+  sst << boost::format("%-22s %10s %10s %10s %10s %10s %10s\n") % "stage" % "count" % "rate[Hz]" % "mean[ms]" % "p50[ms]" % "p99[ms]" % "max[ms]";
+  for (const auto& s : summaries) {
+    sst << boost::format("%-22s %10d %10.2f %10.3f %10.3f %10.3f %10.3f\n") % s.name % s.count % s.rate % (s.mean * 1e3) % (s.p50 * 1e3) % (s.p99 * 1e3) % (s.max * 1e3);
+  }
+  return sst.str();
+}
+
+}  // namespace glim
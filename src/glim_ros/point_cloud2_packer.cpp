@@ -0,0 +1,87 @@
+#include <glim_ros/point_cloud2_packer.hpp>
+
+#include <cstring>
+#include <sensor_msgs/msg/point_field.hpp>
+#include <glim/util/ros_cloud_converter.hpp>
+
+namespace glim {
+
+namespace {
+
+// Clouds smaller than this are packed in the calling thread (thread startup would dominate)
+[[maybe_unused]] constexpr long parallel_threshold = 32768;
+
+}  // namespace
+
+void init_pointcloud2(const std::string& frame_id, double stamp, size_t num_points, const PointCloud2Packing& packing, sensor_msgs::msg::PointCloud2& msg) {
+  static const std::string field_names[] = {"x", "y", "z", "t", "intensity"};
+  const int num_fields = 3 + packing.with_times + packing.with_intensities;
+
+  msg.header.frame_id = frame_id;
+  msg.header.stamp = from_sec(stamp);
+  msg.width = num_points;
+  msg.height = 1;
+
+  msg.fields.resize(num_fields);
+  for (int i = 0; i < num_fields; i++) {
+    const int name_index = (i == 3 && !packing.with_times) ? 4 : i;
+    msg.fields[i].name = field_names[name_index];
+    msg.fields[i].offset = sizeof(float) * i;
+    msg.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+    msg.fields[i].count = 1;
+  }
+
+  msg.is_bigendian = false;
+  msg.point_step = packing.point_step;
+  msg.row_step = packing.point_step * num_points;
+  msg.data.resize(msg.row_step);
+  msg.is_dense = true;
+}
+
+sensor_msgs::msg::PointCloud2::SharedPtr create_pointcloud2(const std::string& frame_id, double stamp, size_t num_points, const PointCloud2Packing& packing) {
+  auto msg = std::make_shared<sensor_msgs::msg::PointCloud2>();
+  init_pointcloud2(frame_id, stamp, num_points, packing, *msg);
+  return msg;
+}
+
+void transform_and_pack(const Eigen::Isometry3d& T, const gtsam_points::PointCloud& frame, const PointCloud2Packing& packing, std::uint8_t* data, [[maybe_unused]] bool parallel) {
+  // 3x4 affine part (points are homogeneous with w = 1)
+  const Eigen::Matrix<double, 3, 4> T_affine = T.matrix().topRows<3>();
+  const long num_points = frame.size();
+
+  const size_t time_offset = sizeof(float) * 3;
+  const size_t intensity_offset = sizeof(float) * (3 + packing.with_times);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (parallel && num_points >= parallel_threshold)
+#endif
+  for (long i = 0; i < num_points; i++) {
+    std::uint8_t* point = data + packing.point_step * i;
+
+    const Eigen::Vector3f transformed = (T_affine * frame.points[i]).cast<float>();
+    std::memcpy(point, transformed.data(), sizeof(float) * 3);
+
+    if (packing.with_times) {
+      const float t = frame.times[i];
+      std::memcpy(point + time_offset, &t, sizeof(float));
+    }
+    if (packing.with_intensities) {
+      const float intensity = frame.intensities[i];
+      std::memcpy(point + intensity_offset, &intensity, sizeof(float));
+    }
+  }
+}
+
+void transform_to_pointcloud2(const std::string& frame_id, double stamp, const Eigen::Isometry3d& T, const gtsam_points::PointCloud& frame, sensor_msgs::msg::PointCloud2& msg) {
+  const PointCloud2Packing packing(frame.times != nullptr, frame.intensities != nullptr);
+  init_pointcloud2(frame_id, stamp, frame.size(), packing, msg);
+  transform_and_pack(T, frame, packing, msg.data.data());
+}
+
+sensor_msgs::msg::PointCloud2::SharedPtr transform_to_pointcloud2(const std::string& frame_id, double stamp, const Eigen::Isometry3d& T, const gtsam_points::PointCloud& frame) {
+  auto msg = std::make_shared<sensor_msgs::msg::PointCloud2>();
+  transform_to_pointcloud2(frame_id, stamp, T, frame, *msg);
+  return msg;
+}
+
+}  // namespace glim
@@ -0,0 +1,160 @@
+#include <glim_ros/point_cloud2_view.hpp>
+
+#include <cmath>
+#include <sensor_msgs/msg/point_field.hpp>
+
+namespace glim {
+
+namespace {
+
+template <typename T>
+double read_as_double(const std::uint8_t* ptr) {
+  T value;
+  std::memcpy(&value, ptr, sizeof(T));
+  return static_cast<double>(value);
+}
+
+PointCloud2Field make_field(const sensor_msgs::msg::PointField& field) {
+  using sensor_msgs::msg::PointField;
+
+  PointCloud2Field accessor;
+  accessor.offset = field.offset;
+  accessor.datatype = field.datatype;
+
+  switch (field.datatype) {
+    case PointField::INT8:
+      accessor.read = &read_as_double<std::int8_t>;
+      break;
+    case PointField::UINT8:
+      accessor.read = &read_as_double<std::uint8_t>;
+      break;
+    case PointField::INT16:
+      accessor.read = &read_as_double<std::int16_t>;
+      break;
+    case PointField::UINT16:
+      accessor.read = &read_as_double<std::uint16_t>;
+      break;
+    case PointField::INT32:
+      accessor.read = &read_as_double<std::int32_t>;
+      break;
+    case PointField::UINT32:
+      accessor.read = &read_as_double<std::uint32_t>;
+      break;
+    case PointField::FLOAT32:
+      accessor.read = &read_as_double<float>;
+      break;
+    case PointField::FLOAT64:
+      accessor.read = &read_as_double<double>;
+      break;
+  }
+
+  return accessor;
+}
+
+bool is_float(const PointCloud2Field& field) {
+  using sensor_msgs::msg::PointField;
+  return field.datatype == PointField::FLOAT32 || field.datatype == PointField::FLOAT64;
+}
+
+}  // namespace
+
+PointCloud2Layout::ConstPtr PointCloud2Layout::resolve(const sensor_msgs::msg::PointCloud2& msg, const std::string& intensity_channel) {
+  using sensor_msgs::msg::PointField;
+
+  auto layout = std::make_shared<PointCloud2Layout>();
+  layout->point_step = msg.point_step;
+  layout->fields = msg.fields;
+  layout->supported = !msg.is_bigendian;
+
+  for (const auto& field : msg.fields) {
+    if (field.name == "x") {
+      layout->x = make_field(field);
+    } else if (field.name == "y") {
+      layout->y = make_field(field);
+    } else if (field.name == "z") {
+      layout->z = make_field(field);
+    } else if (field.name == "t" || field.name == "time" || field.name == "time_stamp" || field.name == "timestamp") {
+      // Same time field names and units as glim::extract_raw_points (UINT32 timestamps are in nanoseconds)
+      layout->time = make_field(field);
+      if (field.datatype == PointField::UINT32) {
+        layout->time.scale = 1e-9;
+      } else if (!is_float(layout->time)) {
+        layout->supported = false;
+      }
+    } else if (field.name == intensity_channel) {
+      layout->intensity = make_field(field);
+    } else if (field.name == "rgb" || field.name == "rgba") {
+      // Colors are left to glim::extract_raw_points
+      layout->supported = false;
+    }
+  }
+
+  if (!layout->x.valid() || !layout->y.valid() || !layout->z.valid()) {
+    layout->supported = false;
+  } else if (!is_float(layout->x) || layout->x.datatype != layout->y.datatype || layout->x.datatype != layout->z.datatype) {
+    layout->supported = false;
+  }
+
+  layout->packed_xyz = layout->supported && layout->x.datatype == PointField::FLOAT32 && layout->y.offset == layout->x.offset + 4 && layout->z.offset == layout->y.offset + 4;
+
+  return layout;
+}
+
+bool PointCloud2Layout::matches(const sensor_msgs::msg::PointCloud2& msg) const {
+  if (msg.point_step != point_step || msg.fields.size() != fields.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < fields.size(); i++) {
+    const auto& lhs = fields[i];
+    const auto& rhs = msg.fields[i];
+    if (lhs.offset != rhs.offset || lhs.datatype != rhs.datatype || lhs.name != rhs.name) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const PointCloud2Layout& PointCloud2LayoutCache::get(const sensor_msgs::msg::PointCloud2& msg) {
+  if (!layout || !layout->matches(msg)) {
+    layout = PointCloud2Layout::resolve(msg, intensity_channel);
+  }
+  return *layout;
+}
+
+RawPoints::Ptr PointCloud2View::to_raw_points() const {
+  if (!layout.supported) {
+    return nullptr;
+  }
+
+  auto raw_points = std::make_shared<RawPoints>();
+  raw_points->stamp = stamp;
+  raw_points->points.reserve(num_points);
+  if (has_times()) {
+    raw_points->times.reserve(num_points);
+  }
+  if (has_intensities()) {
+    raw_points->intensities.reserve(num_points);
+  }
+
+  for (size_t i = 0; i < num_points; i++) {
+    const std::uint8_t* pt = at(i);
+    const Eigen::Vector4d p = point(i);
+    if (!std::isfinite(p.x()) || !std::isfinite(p.y()) || !std::isfinite(p.z())) {
+      continue;
+    }
+
+    raw_points->points.emplace_back(p);
+    if (has_times()) {
+      raw_points->times.emplace_back(layout.time(pt));
+    }
+    if (has_intensities()) {
+      raw_points->intensities.emplace_back(layout.intensity(pt));
+    }
+  }
+
+  return raw_points;
+}
+
+}  // namespace glim
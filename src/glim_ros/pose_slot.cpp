@@ -0,0 +1,51 @@
+#include <glim_ros/pose_slot.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <spdlog/spdlog.h>
+
+namespace glim {
+
+SharedPoseSlot::SharedPoseSlot(const std::string& name, bool create) : name(name), owner(create), slot_(nullptr) {
+  const int fd = shm_open(name.c_str(), create ? (O_CREAT | O_RDWR) : O_RDWR, 0644);
+  if (fd < 0) {
+    spdlog::warn("failed to open shared memory {}", name);
+    return;
+  }
+
+  if (create && ftruncate(fd, sizeof(PoseSlot))) {
+    spdlog::warn("failed to resize shared memory {}", name);
+    close(fd);
+    return;
+  }
+
+  void* ptr = mmap(nullptr, sizeof(PoseSlot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    spdlog::warn("failed to map shared memory {}", name);
+    return;
+  }
+
+  slot_ = static_cast<PoseSlot*>(ptr);
+  if (create) {
+    slot_->sequence.store(0, std::memory_order_relaxed);
+    std::memset(static_cast<void*>(&slot_->sample), 0, sizeof(PoseSample));
+    slot_->magic = PoseSlot::magic_number;
+  } else if (slot_->magic != PoseSlot::magic_number) {
+    spdlog::warn("shared memory {} does not hold a pose slot", name);
+    munmap(slot_, sizeof(PoseSlot));
+    slot_ = nullptr;
+  }
+}
+
+SharedPoseSlot::~SharedPoseSlot() {
+  if (slot_) {
+    munmap(slot_, sizeof(PoseSlot));
+  }
+  if (owner) {
+    shm_unlink(name.c_str());
+  }
+}
+
+}  // namespace glim
@@ -0,0 +1,214 @@
+#include <glim_ros/pose_streamer.hpp>
+
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+#define GLIM_ROS2
+#include <glim/odometry/callbacks.hpp>
+#include <glim/mapping/callbacks.hpp>
+#include <glim/util/logging.hpp>
+#include <glim/util/config.hpp>
+#include <glim/util/trajectory_manager.hpp>
+#include <glim/util/ros_cloud_converter.hpp>
+#include <glim_ros/task_scheduler.hpp>
+
+namespace glim {
+
+PoseStreamer::PoseStreamer() : logger(create_module_logger("pose_stream")) {
+  const Config config(GlobalConfig::get_config_path("config_ros"));
+
+  map_frame_id = config.param<std::string>("glim_ros", "map_frame_id", "map");
+  imu_frame_id = config.param<std::string>("glim_ros", "imu_frame_id", "imu");
+  gravity = config.param<double>("glim_ros", "pose_stream_gravity", 9.80665);
+  max_propagation = config.param<double>("glim_ros", "pose_stream_max_propagation", 0.5);
+
+  anchored = false;
+  anchor_stamp = 0.0;
+  state_stamp = 0.0;
+  T_odom_imu.setIdentity();
+  v_odom_imu.setZero();
+  angular_vel.setZero();
+  imu_bias.setZero();
+  T_world_odom.setIdentity();
+  trajectory.reset(new TrajectoryManager);
+
+  // The latest pose is placed in POSIX shared memory for consumers in other processes (e.g., controllers)
+  const std::string shm_name = config.param<std::string>("glim_ros", "pose_stream_shm_name", "");
+  if (!shm_name.empty()) {
+    shared_slot.reset(new SharedPoseSlot(shm_name, true));
+    if (shared_slot->slot()) {
+      logger->info("pose stream is written to shared memory {}", shm_name);
+    }
+  }
+  if (!shared_slot || !shared_slot->slot()) {
+    local_slot.reset(new PoseSlot);
+    local_slot->magic = PoseSlot::magic_number;
+    local_slot->sequence = 0;
+  }
+  slot = local_slot ? local_slot.get() : shared_slot->slot();
+
+  last_published = 0;
+  publishing = false;
+
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  using std::placeholders::_3;
+  OdometryEstimationCallbacks::on_insert_imu.add(std::bind(&PoseStreamer::on_insert_imu, this, _1, _2, _3));
+  OdometryEstimationCallbacks::on_new_frame.add(std::bind(&PoseStreamer::on_new_frame, this, _1));
+  GlobalMappingCallbacks::on_update_submaps.add(std::bind(&PoseStreamer::on_update_submaps, this, _1));
+}
+
+PoseStreamer::~PoseStreamer() {
+  if (publish_task) {
+    publish_task->cancel();
+  }
+}
+
+std::vector<GenericTopicSubscription::Ptr> PoseStreamer::create_subscriptions(rclcpp::Node& node) {
+  odom_pub = node.create_publisher<nav_msgs::msg::Odometry>("~/imu_rate_odom", rclcpp::QoS(10).best_effort());
+
+  // Woken for every propagated pose. Consecutive poses are coalesced if publishing falls behind.
+  publish_task = TaskScheduler::instance().schedule_periodic("pose_streamer", std::chrono::milliseconds(100), TaskPriority::HIGH, [this] { publish_latest(); });
+  publishing.store(true, std::memory_order_release);
+
+  return {};
+}
+
+void PoseStreamer::on_insert_imu(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel) {
+  const ImuSample imu{stamp, linear_acc, angular_vel};
+  imu_buffer.emplace_back(imu);
+  while (!imu_buffer.empty() && imu_buffer.front().stamp < stamp - 2.0 * max_propagation) {
+    imu_buffer.pop_front();
+  }
+
+  if (!anchored || stamp <= state_stamp) {
+    return;
+  }
+
+  propagate(imu);
+  write_pose();
+}
+
+void PoseStreamer::on_new_frame(const EstimationFrame::ConstPtr& frame) {
+  {
+    std::lock_guard<std::mutex> lock(trajectory_mutex);
+    trajectory->add_odom(frame->stamp, frame->T_world_imu, 1);
+    T_world_odom = trajectory->get_T_world_odom();
+  }
+
+  // Reset the state to the new anchor and re-propagate the IMU samples received after it
+  anchored = true;
+  anchor_stamp = frame->stamp;
+  state_stamp = frame->stamp;
+  T_odom_imu = frame->T_world_imu;
+  v_odom_imu = frame->v_world_imu;
+  imu_bias = frame->imu_bias;
+
+  while (!imu_buffer.empty() && imu_buffer.front().stamp <= frame->stamp) {
+    imu_buffer.pop_front();
+  }
+  for (const auto& imu : imu_buffer) {
+    propagate(imu);
+  }
+
+  write_pose();
+}
+
+void PoseStreamer::on_update_submaps(const std::vector<SubMap::Ptr>& submaps) {
+  const SubMap::ConstPtr latest_submap = submaps.back();
+  const double stamp_endpoint_R = latest_submap->odom_frames.back()->stamp;
+  const Eigen::Isometry3d T_world_endpoint_R = latest_submap->T_world_origin * latest_submap->T_origin_endpoint_R;
+
+  // The odometry thread picks up the new world correction with the next anchor
+  std::lock_guard<std::mutex> lock(trajectory_mutex);
+  trajectory->update_anchor(stamp_endpoint_R, T_world_endpoint_R);
+}
+
+void PoseStreamer::propagate(const ImuSample& imu) {
+  const double dt = imu.stamp - state_stamp;
+  if (dt <= 0.0) {
+    return;
+  }
+
+  if (imu.stamp - anchor_stamp > max_propagation) {
+    // The anchor is too old to be trusted (e.g., odometry is stalled)
+    return;
+  }
+
+  const Eigen::Vector3d acc = imu.linear_acc - imu_bias.head<3>();
+  angular_vel = imu.angular_vel - imu_bias.tail<3>();
+
+  const Eigen::Vector3d acc_odom = T_odom_imu.linear() * acc - Eigen::Vector3d(0.0, 0.0, gravity);
+  T_odom_imu.translation() += v_odom_imu * dt + 0.5 * acc_odom * dt * dt;
+  v_odom_imu += acc_odom * dt;
+
+  const double angle = angular_vel.norm() * dt;
+  if (angle > 1e-12) {
+    const Eigen::Quaterniond delta(Eigen::AngleAxisd(angle, angular_vel.normalized()));
+    T_odom_imu.linear() = (Eigen::Quaterniond(T_odom_imu.linear()) * delta).normalized().toRotationMatrix();
+  }
+
+  state_stamp = imu.stamp;
+}
+
+void PoseStreamer::write_pose() {
+  const Eigen::Isometry3d T_world_imu = T_world_odom * T_odom_imu;
+  const Eigen::Quaterniond quat_world_imu(T_world_imu.linear());
+  const Eigen::Vector3d v_world_imu = T_world_odom.linear() * v_odom_imu;
+
+  PoseSample sample;
+  sample.stamp = state_stamp;
+  sample.anchor_stamp = anchor_stamp;
+  Eigen::Map<Eigen::Vector3d>(sample.position) = T_world_imu.translation();
+  Eigen::Map<Eigen::Vector4d>(sample.orientation) = quat_world_imu.coeffs();
+  Eigen::Map<Eigen::Vector3d>(sample.linear_velocity) = v_world_imu;
+  Eigen::Map<Eigen::Vector3d>(sample.angular_velocity) = angular_vel;
+  slot->write(sample);
+
+  if (publishing.load(std::memory_order_acquire)) {
+    publish_task->wake();
+  }
+}
+
+void PoseStreamer::publish_latest() {
+  const std::uint64_t count = slot->count();
+  PoseSample sample;
+  if (count == last_published || !slot->read(sample)) {
+    return;
+  }
+  last_published = count;
+
+  if (!odom_pub->get_subscription_count()) {
+    return;
+  }
+
+  auto odom = std::make_unique<nav_msgs::msg::Odometry>();
+  odom->header.stamp = from_sec(sample.stamp);
+  odom->header.frame_id = map_frame_id;
+  odom->child_frame_id = imu_frame_id;
+  odom->pose.pose.position.x = sample.position[0];
+  odom->pose.pose.position.y = sample.position[1];
+  odom->pose.pose.position.z = sample.position[2];
+  odom->pose.pose.orientation.x = sample.orientation[0];
+  odom->pose.pose.orientation.y = sample.orientation[1];
+  odom->pose.pose.orientation.z = sample.orientation[2];
+  odom->pose.pose.orientation.w = sample.orientation[3];
+
+  // Twist in the child (IMU) frame
+  const Eigen::Quaterniond quat_world_imu(sample.orientation[3], sample.orientation[0], sample.orientation[1], sample.orientation[2]);
+  const Eigen::Vector3d v_imu = quat_world_imu.conjugate() * Eigen::Map<const Eigen::Vector3d>(sample.linear_velocity);
+  odom->twist.twist.linear.x = v_imu.x();
+  odom->twist.twist.linear.y = v_imu.y();
+  odom->twist.twist.linear.z = v_imu.z();
+  odom->twist.twist.angular.x = sample.angular_velocity[0];
+  odom->twist.twist.angular.y = sample.angular_velocity[1];
+  odom->twist.twist.angular.z = sample.angular_velocity[2];
+
+  odom_pub->publish(std::move(odom));
+}
+
+}  // namespace glim
+
+extern "C" glim::ExtensionModule* create_extension_module() {
+  return new glim::PoseStreamer();
+}
@@ -1,6 +1,7 @@
 #include <glim_ros/rviz_viewer.hpp>
 
 #include <mutex>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include <rclcpp/clock.hpp>
 
@@ -12,6 +13,12 @@
 #include <glim/util/config.hpp>
 #include <glim/util/trajectory_manager.hpp>
 #include <glim/util/ros_cloud_converter.hpp>
+#include <glim_ros/global_map_cache.hpp>
+#include <glim_ros/point_cloud2_packer.hpp>
+#include <glim_ros/cloud_publisher.hpp>
+#include <glim_ros/memory_usage.hpp>
+#include <glim_ros/task_scheduler.hpp>
+#include <glim_ros/load_shedding.hpp>
 
 namespace glim {
 
@@ -30,29 +37,35 @@ RvizViewer::RvizViewer() : logger(create_module_logger("rviz")) {
   publish_imu2lidar = config.param<bool>("glim_ros", "publish_imu2lidar", true);
   tf_time_offset = config.param<double>("glim_ros", "tf_time_offset", 1e-6);
 
+  GlobalMapCacheParams globalmap_params;
+  globalmap_params.voxel_resolution = config.param<double>("glim_ros", "globalmap_voxel_resolution", 0.25);
+  globalmap_params.translation_tolerance = config.param<double>("glim_ros", "globalmap_translation_tolerance", 1e-3);
+  globalmap_params.rotation_tolerance = config.param<double>("glim_ros", "globalmap_rotation_tolerance", 1e-3);
+  globalmap_params.max_memory = config.param<double>("glim_ros", "globalmap_max_memory_mb", 0.0) * 1e6;
+  globalmap_params.spill_dir = config.param<std::string>("glim_ros", "globalmap_spill_dir", "");
+  globalmap_pub_interval = config.param<double>("glim_ros", "globalmap_pub_interval", 10.0);
+  globalmap.reset(new GlobalMapCache(globalmap_params));
+  globalmap_changed = false;
+  globalmap_budget_warned = false;
+  publishers_ready = false;
+
+  cloud_queue_size = config.param<int>("glim_ros", "viewer_cloud_queue_size", 2);
+  frame_queue.reset(new SPSCQueue<FrameTask>(config.param<int>("glim_ros", "viewer_frame_queue_size", 1024)));
+  num_frame_overflow = 0;
+  frame_seq = 0;
+
   last_globalmap_pub_time = rclcpp::Clock(rcl_clock_type_t::RCL_ROS_TIME).now();
   trajectory.reset(new TrajectoryManager);
 
-  set_callbacks();
-
-  kill_switch = false;
-  thread = std::thread([this] {
-    while (!kill_switch) {
-      const auto expected = std::chrono::milliseconds(10);
-      const auto t1 = std::chrono::high_resolution_clock::now();
-      spin_once();
-      const auto t2 = std::chrono::high_resolution_clock::now();
+  // The task is scheduled here so that the callbacks can always wake it, but it waits for publishers_ready.
+  // Publishing runs on the shared scheduler behind the mapping-related tasks and is woken early when a new odometry frame arrives
+  spin_task = TaskScheduler::instance().schedule_periodic("rviz_viewer", std::chrono::milliseconds(10), TaskPriority::LOW, [this] { spin_once(); });
 
-      if (t2 - t1 < expected) {
-        std::this_thread::sleep_for(expected - (t2 - t1));
-      }
-    }
-  });
+  set_callbacks();
 }
 
 RvizViewer::~RvizViewer() {
-  kill_switch = true;
-  thread.join();
+  spin_task->cancel();
 }
 
 std::vector<GenericTopicSubscription::Ptr> RvizViewer::create_subscriptions(rclcpp::Node& node) {
@@ -60,11 +73,16 @@ std::vector<GenericTopicSubscription::Ptr> RvizViewer::create_subscriptions(rclc
   tf_listener = std::make_unique<tf2_ros::TransformListener>(*tf_buffer);
   tf_broadcaster = std::make_unique<tf2_ros::TransformBroadcaster>(node);
 
-  points_pub = node.create_publisher<sensor_msgs::msg::PointCloud2>("~/points", 10);
-  aligned_points_pub = node.create_publisher<sensor_msgs::msg::PointCloud2>("~/aligned_points", 10);
+  // Each cloud topic can additionally be published with a reduced-bandwidth encoding on "<topic>/encoded" (e.g., "aligned_points_encoding: int16")
+  const Config config(GlobalConfig::get_config_path("config_ros"));
+  const int pool_size = 4;
+
+  points_pub = std::make_shared<CloudPublisher>(node, "~/points", 10, pool_size, CloudEncoding::load(config, "points"));
+  aligned_points_pub = std::make_shared<CloudPublisher>(node, "~/aligned_points", 10, pool_size, CloudEncoding::load(config, "aligned_points"));
 
-  points_corrected_pub = node.create_publisher<sensor_msgs::msg::PointCloud2>("~/points_corrected", 10);
-  aligned_points_corrected_pub = node.create_publisher<sensor_msgs::msg::PointCloud2>("~/aligned_points_corrected", 10);
+  points_corrected_pub = std::make_shared<CloudPublisher>(node, "~/points_corrected", 10, pool_size, CloudEncoding::load(config, "points_corrected"));
+  aligned_points_corrected_pub =
+    std::make_shared<CloudPublisher>(node, "~/aligned_points_corrected", 10, pool_size, CloudEncoding::load(config, "aligned_points_corrected"));
 
   rmw_qos_profile_t map_qos_profile = {
     RMW_QOS_POLICY_HISTORY_KEEP_LAST,
@@ -77,13 +95,18 @@ std::vector<GenericTopicSubscription::Ptr> RvizViewer::create_subscriptions(rclc
     RMW_QOS_LIVELINESS_LEASE_DURATION_DEFAULT,
     false};
   rclcpp::QoS map_qos(rclcpp::QoSInitialization(map_qos_profile.history, map_qos_profile.depth), map_qos_profile);
-  map_pub = node.create_publisher<sensor_msgs::msg::PointCloud2>("~/map", map_qos);
+  map_pub = std::make_shared<CloudPublisher>(node, "~/map", map_qos, pool_size, CloudEncoding::load(config, "map"));
+  map_updates_pub = std::make_shared<CloudPublisher>(node, "~/map_updates", rclcpp::QoS(100).reliable(), pool_size, CloudEncoding::load(config, "map_updates"));
   odom_pub = node.create_publisher<nav_msgs::msg::Odometry>("~/odom", 10);
   pose_pub = node.create_publisher<geometry_msgs::msg::PoseStamped>("~/pose", 10);
 
   odom_corrected_pub = node.create_publisher<nav_msgs::msg::Odometry>("~/odom_corrected", 10);
   pose_corrected_pub = node.create_publisher<geometry_msgs::msg::PoseStamped>("~/pose_corrected", 10);
 
+  // Publishes the members assigned above to the spin task
+  publishers_ready.store(true, std::memory_order_release);
+  spin_task->wake();
+
   return {};
 }
 
@@ -95,6 +118,58 @@ void RvizViewer::set_callbacks() {
 }
 
 void RvizViewer::odometry_new_frame(const EstimationFrame::ConstPtr& new_frame, bool corrected) {
+  // Called in the odometry thread. Only the frame pointer is passed to the viewer thread so that publishing never blocks odometry estimation
+  const FrameTask task{frame_seq++, new_frame, corrected, true};
+  if (num_frame_overflow || !frame_queue->try_push(task)) {
+    std::lock_guard<std::mutex> lock(frame_overflow_mutex);
+    frame_overflow.push_back(task);
+    num_frame_overflow = frame_overflow.size();
+  }
+
+  spin_task->wake();
+}
+
+void RvizViewer::process_frame_queue() {
+  frame_batch.clear();
+
+  // Take overflowed frames first so that every frame pushed before them is already in frame_queue
+  const bool overflowed = num_frame_overflow;
+  if (overflowed) {
+    std::lock_guard<std::mutex> lock(frame_overflow_mutex);
+    frame_batch.swap(frame_overflow);
+    num_frame_overflow = 0;
+  }
+
+  FrameTask task;
+  while (frame_queue->try_pop(task)) {
+    frame_batch.emplace_back(std::move(task));
+  }
+
+  if (overflowed) {
+    std::sort(frame_batch.begin(), frame_batch.end(), [](const FrameTask& lhs, const FrameTask& rhs) { return lhs.seq < rhs.seq; });
+  }
+
+  // TF, odom, and pose are published for every frame, while clouds are published only for the latest frames of each topic
+  // (and not at all while the pipeline sheds load)
+  const bool pause_clouds = LoadShedding::instance().active(LoadSheddingLevel::PAUSE_VIEWER);
+  int num_clouds[2] = {0, 0};
+  for (auto task = frame_batch.rbegin(); task != frame_batch.rend(); task++) {
+    task->publish_clouds = num_clouds[task->corrected]++ < cloud_queue_size && !pause_clouds;
+  }
+
+  int num_dropped = 0;
+  for (const auto& task : frame_batch) {
+    publish_frame(task.frame, task.corrected, task.publish_clouds);
+    num_dropped += !task.publish_clouds;
+  }
+
+  if (num_dropped) {
+    logger->debug("dropped clouds for {} frames", num_dropped);
+  }
+  frame_batch.clear();
+}
+
+void RvizViewer::publish_frame(const EstimationFrame::ConstPtr& new_frame, bool corrected, bool publish_clouds) {
   const Eigen::Isometry3d T_odom_imu = new_frame->T_world_imu;
   const Eigen::Quaterniond quat_odom_imu(T_odom_imu.linear());
   const Eigen::Vector3d v_odom_imu = new_frame->v_world_imu;
@@ -196,23 +271,24 @@ void RvizViewer::odometry_new_frame(const EstimationFrame::ConstPtr& new_frame,
   auto& odom_pub = !corrected ? this->odom_pub : this->odom_corrected_pub;
   if (odom_pub->get_subscription_count()) {
     // Publish sensor pose (without loop closure)
-    nav_msgs::msg::Odometry odom;
-    odom.header.stamp = stamp;
-    odom.header.frame_id = odom_frame_id;
-    odom.child_frame_id = imu_frame_id;
-    odom.pose.pose.position.x = T_odom_imu.translation().x();
-    odom.pose.pose.position.y = T_odom_imu.translation().y();
-    odom.pose.pose.position.z = T_odom_imu.translation().z();
-    odom.pose.pose.orientation.x = quat_odom_imu.x();
-    odom.pose.pose.orientation.y = quat_odom_imu.y();
-    odom.pose.pose.orientation.z = quat_odom_imu.z();
-    odom.pose.pose.orientation.w = quat_odom_imu.w();
-
-    odom.twist.twist.linear.x = v_odom_imu.x();
-    odom.twist.twist.linear.y = v_odom_imu.y();
-    odom.twist.twist.linear.z = v_odom_imu.z();
-
-    odom_pub->publish(odom);
+    // Published as unique_ptr so that intra-process subscribers take the message without a copy
+    auto odom = std::make_unique<nav_msgs::msg::Odometry>();
+    odom->header.stamp = stamp;
+    odom->header.frame_id = odom_frame_id;
+    odom->child_frame_id = imu_frame_id;
+    odom->pose.pose.position.x = T_odom_imu.translation().x();
+    odom->pose.pose.position.y = T_odom_imu.translation().y();
+    odom->pose.pose.position.z = T_odom_imu.translation().z();
+    odom->pose.pose.orientation.x = quat_odom_imu.x();
+    odom->pose.pose.orientation.y = quat_odom_imu.y();
+    odom->pose.pose.orientation.z = quat_odom_imu.z();
+    odom->pose.pose.orientation.w = quat_odom_imu.w();
+
+    odom->twist.twist.linear.x = v_odom_imu.x();
+    odom->twist.twist.linear.y = v_odom_imu.y();
+    odom->twist.twist.linear.z = v_odom_imu.z();
+
+    odom_pub->publish(std::move(odom));
 
     logger->debug("published odom (stamp={})", new_frame->stamp);
   }
@@ -220,23 +296,23 @@ void RvizViewer::odometry_new_frame(const EstimationFrame::ConstPtr& new_frame,
   auto& pose_pub = !corrected ? this->pose_pub : this->pose_corrected_pub;
   if (pose_pub->get_subscription_count()) {
     // Publish sensor pose (with loop closure)
-    geometry_msgs::msg::PoseStamped pose;
-    pose.header.stamp = stamp;
-    pose.header.frame_id = map_frame_id;
-    pose.pose.position.x = T_world_imu.translation().x();
-    pose.pose.position.y = T_world_imu.translation().y();
-    pose.pose.position.z = T_world_imu.translation().z();
-    pose.pose.orientation.x = quat_world_imu.x();
-    pose.pose.orientation.y = quat_world_imu.y();
-    pose.pose.orientation.z = quat_world_imu.z();
-    pose.pose.orientation.w = quat_world_imu.w();
-    pose_pub->publish(pose);
+    auto pose = std::make_unique<geometry_msgs::msg::PoseStamped>();
+    pose->header.stamp = stamp;
+    pose->header.frame_id = map_frame_id;
+    pose->pose.position.x = T_world_imu.translation().x();
+    pose->pose.position.y = T_world_imu.translation().y();
+    pose->pose.position.z = T_world_imu.translation().z();
+    pose->pose.orientation.x = quat_world_imu.x();
+    pose->pose.orientation.y = quat_world_imu.y();
+    pose->pose.orientation.z = quat_world_imu.z();
+    pose->pose.orientation.w = quat_world_imu.w();
+    pose_pub->publish(std::move(pose));
 
     logger->debug("published pose (stamp={})", new_frame->stamp);
   }
 
   auto& points_pub = !corrected ? this->points_pub : this->points_corrected_pub;
-  if (points_pub->get_subscription_count()) {
+  if (publish_clouds && points_pub->get_subscription_count()) {
     // Publish points in their own coordinate frame
     std::string frame_id;
     switch (new_frame->frame_id) {
@@ -251,30 +327,21 @@ void RvizViewer::odometry_new_frame(const EstimationFrame::ConstPtr& new_frame,
         break;
     }
 
-    auto points = frame_to_pointcloud2(frame_id, new_frame->stamp, *new_frame->frame);
-    points_pub->publish(*points);
+    points_pub->publish([&](sensor_msgs::msg::PointCloud2& msg) {
+      transform_to_pointcloud2(frame_id, new_frame->stamp, Eigen::Isometry3d::Identity(), *new_frame->frame, msg);
+    });
 
     logger->debug("published points (stamp={} num_points={})", new_frame->stamp, new_frame->frame->size());
   }
 
   auto& aligned_points_pub = !corrected ? this->aligned_points_pub : this->aligned_points_corrected_pub;
-  if (aligned_points_pub->get_subscription_count()) {
+  if (publish_clouds && aligned_points_pub->get_subscription_count()) {
     // Publish points aligned to the world frame to avoid some visualization issues in Rviz2
-    std::vector<Eigen::Vector4d> transformed(new_frame->frame->size());
-    for (int i = 0; i < new_frame->frame->size(); i++) {
-      transformed[i] = new_frame->T_world_sensor() * new_frame->frame->points[i];
-    }
+    aligned_points_pub->publish([&](sensor_msgs::msg::PointCloud2& msg) {
+      transform_to_pointcloud2(map_frame_id, new_frame->stamp, new_frame->T_world_sensor(), *new_frame->frame, msg);
+    });
 
-    gtsam_points::PointCloud frame;
-    frame.num_points = new_frame->frame->size();
-    frame.points = transformed.data();
-    frame.times = new_frame->frame->times;
-    frame.intensities = new_frame->frame->intensities;
-
-    auto points = frame_to_pointcloud2(map_frame_id, new_frame->stamp, frame);
-    aligned_points_pub->publish(*points);
-
-    logger->debug("published aligned_points (stamp={} num_points={})", new_frame->stamp, frame.size());
+    logger->debug("published aligned_points (stamp={} num_points={})", new_frame->stamp, new_frame->frame->size());
   }
 }
 
@@ -293,43 +360,55 @@ void RvizViewer::globalmap_on_update_submaps(const std::vector<SubMap::Ptr>& sub
     submap_poses[i] = submaps[i]->T_world_origin;
   }
 
-  // Invoke a submap concatenation task in the RvizViewer thread
-  invoke([this, latest_submap, submap_poses] {
-    this->submaps.push_back(latest_submap->frame);
+  const double submap_stamp = latest_submap->odom_frames.front()->stamp;
+
+  // Invoke a global map update task in the RvizViewer thread
+  invoke([this, latest_submap, submap_stamp, submap_poses] {
+    // Only the new submap and submaps moved by the optimization are (re-)transformed
+    globalmap->insert(submap_stamp, latest_submap->frame, latest_submap->T_world_origin);
+    globalmap->update_poses(submap_poses);
+
+    // Under memory pressure, spill the local points of all submaps except the latest (the published map is kept).
+    // Without a spill directory, local points are kept because dropping them would freeze the submaps at their current poses.
+    if (MemoryUsage::instance().over_budget()) {
+      if (globalmap->can_spill()) {
+        globalmap->enforce_budget(0, false);
+      } else if (!globalmap_budget_warned) {
+        logger->warn("memory budget exceeded but globalmap_spill_dir is not set (map memory is not released)");
+      }
+      globalmap_budget_warned = true;
+    } else {
+      globalmap_budget_warned = false;
+    }
+    MemoryUsage::instance().report("rviz_viewer_globalmap", globalmap->memory_usage());
+
+    const auto updated = globalmap->take_updated();
+    globalmap_changed |= !updated.empty();
 
-    if (!map_pub->get_subscription_count()) {
+    if (map_updates_pub->get_subscription_count()) {
+      // Publish each updated submap in the world frame (the stamp identifies the submap)
+      for (const int i : updated) {
+        map_updates_pub->publish([&](sensor_msgs::msg::PointCloud2& msg) { globalmap->submap_to_pointcloud2(i, map_frame_id, msg); });
+      }
+
+      logger->debug("published {} map updates", updated.size());
+    }
+
+    if (!map_pub->get_subscription_count() || !globalmap_changed) {
       return;
     }
 
-    // Publish global map every 10 seconds
+    // Publish the entire global map at a fixed interval
     const rclcpp::Time now = rclcpp::Clock(rcl_clock_type_t::RCL_ROS_TIME).now();
-    if (now - last_globalmap_pub_time < std::chrono::seconds(10)) {
+    if ((now - last_globalmap_pub_time).seconds() < globalmap_pub_interval) {
       return;
     }
     last_globalmap_pub_time = now;
+    globalmap_changed = false;
 
-    logger->warn("Publishing global map is computationally demanding and not recommended");
-
-    int total_num_points = 0;
-    for (const auto& submap : this->submaps) {
-      total_num_points += submap->size();
-    }
+    map_pub->publish([&](sensor_msgs::msg::PointCloud2& msg) { globalmap->to_pointcloud2(map_frame_id, now.seconds(), msg); });
 
-    // Concatenate all the submap points
-    gtsam_points::PointCloudCPU::Ptr merged(new gtsam_points::PointCloudCPU);
-    merged->num_points = total_num_points;
-    merged->points_storage.resize(total_num_points);
-    merged->points = merged->points_storage.data();
-
-    int begin = 0;
-    for (int i = 0; i < this->submaps.size(); i++) {
-      const auto& submap = this->submaps[i];
-      std::transform(submap->points, submap->points + submap->size(), merged->points + begin, [&](const Eigen::Vector4d& p) { return submap_poses[i] * p; });
-      begin += submap->size();
-    }
-
-    auto points_msg = frame_to_pointcloud2(map_frame_id, now.seconds(), *merged);
-    map_pub->publish(*points_msg);
+    logger->debug("published global map (submaps={} num_points={})", globalmap->size(), globalmap->num_points());
   });
 }
 
@@ -339,6 +418,13 @@ void RvizViewer::invoke(const std::function<void()>& task) {
 }
 
 void RvizViewer::spin_once() {
+  if (!publishers_ready.load(std::memory_order_acquire)) {
+    // Publishers are not created yet
+    return;
+  }
+
+  process_frame_queue();
+
   std::vector<std::function<void()>> invoke_queue;
 
   {
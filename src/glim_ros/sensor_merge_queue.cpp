@@ -0,0 +1,175 @@
+#include <glim_ros/sensor_merge_queue.hpp>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace glim {
+
+SensorMergeQueue::SensorMergeQueue(
+  double max_latency,
+  double imu_time_offset,
+  double points_time_offset,
+  const ImuCallback& imu_callback,
+  const PointsCallback& points_callback,
+  const ImageCallback& image_callback)
+: max_latency(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(max_latency))),
+  imu_time_offset(imu_time_offset),
+  points_time_offset(points_time_offset),
+  imu_callback(imu_callback),
+  points_callback(points_callback),
+  image_callback(image_callback),
+  kill_switch(false),
+  flush_request(false),
+  num_delivering(0),
+  imu_watermark(-std::numeric_limits<double>::infinity()),
+  last_released_imu(-std::numeric_limits<double>::infinity()),
+  last_released_points(-std::numeric_limits<double>::infinity()),
+  num_expired_(0),
+  num_late_(0) {
+  delivery_thread = std::thread([this] { delivery_task(); });
+}
+
+SensorMergeQueue::~SensorMergeQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    kill_switch = true;
+  }
+  input_pushed.notify_all();
+  delivery_thread.join();
+}
+
+void SensorMergeQueue::push_imu(double stamp, const Eigen::Vector3d& linear_acc, const Eigen::Vector3d& angular_vel) {
+  const double key = stamp + imu_time_offset;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (key < last_released_imu) {
+      num_late_++;
+    }
+    imu_watermark = std::max(imu_watermark, key);
+    inputs.emplace(key, Input{Clock::now() + max_latency, stamp, linear_acc, angular_vel, nullptr, cv::Mat()});
+  }
+  input_pushed.notify_one();
+}
+
+void SensorMergeQueue::push_points(const RawPoints::Ptr& raw_points) {
+  // Per-point times may be relative to the frame stamp or absolute (closer to the stamp than to zero)
+  double scan_end = 0.0;
+  if (!raw_points->times.empty()) {
+    scan_end = *std::max_element(raw_points->times.begin(), raw_points->times.end());
+    if (std::abs(scan_end - raw_points->stamp) < std::abs(scan_end)) {
+      scan_end -= raw_points->stamp;
+    }
+  }
+
+  const double key = raw_points->stamp + points_time_offset + std::max(0.0, scan_end);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (key < last_released_points) {
+      num_late_++;
+    }
+    inputs.emplace(key, Input{Clock::now() + max_latency, raw_points->stamp, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), raw_points, cv::Mat()});
+  }
+  input_pushed.notify_one();
+}
+
+void SensorMergeQueue::push_image(double stamp, const cv::Mat& image) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    inputs.emplace(stamp, Input{Clock::now() + max_latency, stamp, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), nullptr, image});
+  }
+  input_pushed.notify_one();
+}
+
+void SensorMergeQueue::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  flush_request = true;
+  input_pushed.notify_one();
+  delivered.wait(lock, [this] { return inputs.empty() && num_delivering == 0; });
+  flush_request = false;
+}
+
+size_t SensorMergeQueue::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return inputs.size();
+}
+
+bool SensorMergeQueue::releasable(const Input& input, double key, Clock::time_point now) const {
+  if (!input.raw_points) {
+    // IMU samples and images wait only behind frames waiting for IMU coverage
+    return true;
+  }
+
+  // Frames are not held if no IMU is streamed
+  return imu_watermark >= key || !std::isfinite(imu_watermark) || now >= input.deadline;
+}
+
+void SensorMergeQueue::delivery_task() {
+  std::vector<Input> released;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    const auto now = Clock::now();
+    const bool release_all = flush_request || kill_switch;
+
+    // Take the inputs at the head of the queue that can be released
+    while (!inputs.empty()) {
+      auto head = inputs.begin();
+      if (!release_all && !releasable(head->second, head->first, now)) {
+        break;
+      }
+
+      if (head->second.raw_points) {
+        if (imu_watermark < head->first && std::isfinite(imu_watermark)) {
+          num_expired_++;
+          spdlog::debug("release a frame without IMU coverage (scan_end={:.6f} imu={:.6f})", head->first, imu_watermark);
+        }
+        last_released_points = std::max(last_released_points, head->first);
+      } else if (!head->second.image.data) {
+        last_released_imu = std::max(last_released_imu, head->first);
+      }
+
+      released.emplace_back(std::move(head->second));
+      inputs.erase(head);
+    }
+
+    if (!released.empty()) {
+      // Deliver without the lock so that the subscriptions are not blocked by the stages
+      num_delivering = released.size();
+      lock.unlock();
+      for (const auto& input : released) {
+        deliver(input);
+      }
+      released.clear();
+      lock.lock();
+      num_delivering = 0;
+      delivered.notify_all();
+      continue;
+    }
+
+    if (inputs.empty()) {
+      delivered.notify_all();
+      if (kill_switch) {
+        break;
+      }
+      input_pushed.wait(lock);
+    } else {
+      // The head is a frame waiting for IMU coverage
+      input_pushed.wait_until(lock, inputs.begin()->second.deadline);
+    }
+  }
+}
+
+void SensorMergeQueue::deliver(const Input& input) {
+  if (input.raw_points) {
+    points_callback(input.raw_points);
+  } else if (input.image.data) {
+    image_callback(input.stamp, input.image);
+  } else {
+    imu_callback(input.stamp, input.linear_acc, input.angular_vel);
+  }
+}
+
+}  // namespace glim
@@ -0,0 +1,248 @@
+#include <glim_ros/stream_validator.hpp>
+
+#include <cmath>
+#include <limits>
+#include <Eigen/Core>
+#include <boost/format.hpp>
+#include <sensor_msgs/msg/point_field.hpp>
+
+namespace glim {
+
+StreamValidatorParams::StreamValidatorParams() {
+  min_range = 0.0;
+  max_range = 1000.0;
+  imu_gap_factor = 3.0;
+  max_acc_norm_diff = 1.0;
+}
+
+StreamStats::StreamStats() {
+  num_messages = 0;
+  num_stamp_errors = 0;
+  num_intervals = 0;
+  min_interval = std::numeric_limits<double>::max();
+  max_interval = 0.0;
+  sum_interval = 0.0;
+  sum_sq_interval = 0.0;
+  first_stamp = 0.0;
+  last_stamp = 0.0;
+
+  num_points = 0;
+  num_non_finite = 0;
+  num_out_of_range = 0;
+  num_time_disorder = 0;
+  num_without_times = 0;
+  num_unsupported = 0;
+  max_scan_duration = 0.0;
+
+  num_imu_gaps = 0;
+  num_imu_non_finite = 0;
+  sum_acc_norm = 0.0;
+}
+
+double StreamStats::rate() const {
+  return last_stamp > first_stamp ? (num_messages - 1) / (last_stamp - first_stamp) : 0.0;
+}
+
+double StreamStats::mean_interval() const {
+  return num_intervals ? sum_interval / num_intervals : 0.0;
+}
+
+double StreamStats::jitter() const {
+  if (num_intervals < 2) {
+    return 0.0;
+  }
+
+  const double mean = sum_interval / num_intervals;
+  return std::sqrt(std::max(0.0, sum_sq_interval / num_intervals - mean * mean));
+}
+
+StreamValidator::StreamValidator(const StreamValidatorParams& params)
+: params(params),
+  last_imu_stamp(0.0),
+  last_points_stamp(0.0),
+  imu_mean_interval(0.0) {}
+
+StreamValidator::~StreamValidator() {}
+
+void StreamValidator::update_interval(StreamStats& stats, double stamp, double& last_stamp) {
+  if (!stats.num_messages) {
+    stats.first_stamp = stamp;
+  }
+  stats.num_messages++;
+
+  if (last_stamp > 0.0) {
+    const double interval = stamp - last_stamp;
+    if (interval <= 0.0) {
+      stats.num_stamp_errors++;
+    } else if (stats.num_messages > 1) {
+      stats.min_interval = std::min(stats.min_interval, interval);
+      stats.max_interval = std::max(stats.max_interval, interval);
+      stats.sum_interval += interval;
+      stats.sum_sq_interval += interval * interval;
+      stats.num_intervals++;
+    }
+  }
+
+  stats.last_stamp = std::max(stats.last_stamp, stamp);
+  last_stamp = stamp;
+}
+
+void StreamValidator::validate(const sensor_msgs::msg::Imu& msg) {
+  const double stamp = msg.header.stamp.sec + msg.header.stamp.nanosec / 1e9;
+  const double last_stamp = last_imu_stamp;
+  update_interval(imu_stats, stamp, last_imu_stamp);
+
+  // Gaps are detected against an exponential moving average of the interval
+  const double interval = stamp - last_stamp;
+  if (last_stamp > 0.0 && interval > 0.0) {
+    if (imu_mean_interval > 0.0 && interval > params.imu_gap_factor * imu_mean_interval) {
+      imu_stats.num_imu_gaps++;
+    } else {
+      imu_mean_interval = imu_mean_interval > 0.0 ? 0.99 * imu_mean_interval + 0.01 * interval : interval;
+    }
+  }
+
+  const Eigen::Vector3d acc(msg.linear_acceleration.x, msg.linear_acceleration.y, msg.linear_acceleration.z);
+  const Eigen::Vector3d gyro(msg.angular_velocity.x, msg.angular_velocity.y, msg.angular_velocity.z);
+  if (!acc.allFinite() || !gyro.allFinite()) {
+    imu_stats.num_imu_non_finite++;
+    return;
+  }
+  imu_stats.sum_acc_norm += acc.norm();
+}
+
+void StreamValidator::validate(const sensor_msgs::msg::PointCloud2& msg) {
+  const double stamp = msg.header.stamp.sec + msg.header.stamp.nanosec / 1e9;
+  update_interval(points_stats, stamp, last_points_stamp);
+
+  const auto& layout = layout_cache.get(msg);
+  if (!layout.supported) {
+    points_stats.num_unsupported++;
+    return;
+  }
+
+  const PointCloud2View view(msg, layout);
+  points_stats.num_points += view.size();
+  validate_coordinates(view);
+
+  if (view.has_times()) {
+    validate_times(view);
+  } else {
+    points_stats.num_without_times++;
+  }
+}
+
+void StreamValidator::validate_coordinates(const PointCloud2View& view) {
+  const double min_sq = params.min_range * params.min_range;
+  const double max_sq = params.max_range * params.max_range;
+
+  const auto count = [&](const auto& xyz) {
+    // Non-finite points are excluded from the range check by the comparisons (NaN compares false)
+    const auto sq_norms = xyz.colwise().squaredNorm().array();
+    const auto finite = xyz.array().isFinite().colwise().all();
+    const size_t num_finite = finite.count();
+    const size_t num_in_range = (sq_norms >= min_sq && sq_norms <= max_sq).count();
+    points_stats.num_non_finite += xyz.cols() - num_finite;
+    points_stats.num_out_of_range += num_finite - num_in_range;
+  };
+
+  const auto& layout = view.layout;
+  if (layout.packed_xyz && layout.point_step % sizeof(float) == 0 && layout.x.offset % sizeof(float) == 0) {
+    // Strided map over the message buffer (vectorized, no copy)
+    using Stride = Eigen::OuterStride<Eigen::Dynamic>;
+    const float* xyz = reinterpret_cast<const float*>(view.data + layout.x.offset);
+    const Eigen::Map<const Eigen::Matrix<float, 3, Eigen::Dynamic>, Eigen::Unaligned, Stride> points(xyz, 3, view.size(), Stride(layout.point_step / sizeof(float)));
+    count(points.cast<double>());
+    return;
+  }
+
+  // Generic layouts are checked in blocks to bound the temporary buffer
+  constexpr size_t block_size = 1024;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> block(3, block_size);
+  for (size_t first = 0; first < view.size(); first += block_size) {
+    const size_t n = std::min(block_size, view.size() - first);
+    for (size_t i = 0; i < n; i++) {
+      block.col(i) = view.point(first + i).head<3>();
+    }
+    count(block.leftCols(n));
+  }
+}
+
+void StreamValidator::validate_times(const PointCloud2View& view) {
+  if (!view.size()) {
+    return;
+  }
+
+  double min_time = view.time(0);
+  double max_time = view.time(0);
+  double prev_time = view.time(0);
+  size_t num_disorder = 0;
+  for (size_t i = 1; i < view.size(); i++) {
+    const double t = view.time(i);
+    num_disorder += t < prev_time;
+    min_time = std::min(min_time, t);
+    max_time = std::max(max_time, t);
+    prev_time = t;
+  }
+
+  points_stats.num_time_disorder += num_disorder;
+  points_stats.max_scan_duration = std::max(points_stats.max_scan_duration, max_time - min_time);
+}
+
+void StreamValidator::take_window(StreamStats& imu, StreamStats& points) {
+  imu = imu_stats;
+  points = points_stats;
+  imu_stats = StreamStats();
+  points_stats = StreamStats();
+}
+
+std::vector<std::string> StreamValidator::warnings(const StreamStats& imu, const StreamStats& points) const {
+  std::vector<std::string> warnings;
+
+  if (!imu.num_messages) {
+    warnings.emplace_back("no IMU messages");
+  } else {
+    if (imu.num_stamp_errors) {
+      warnings.emplace_back((boost::format("%d IMU stamps did not increase") % imu.num_stamp_errors).str());
+    }
+    if (imu.num_imu_gaps) {
+      warnings.emplace_back((boost::format("%d IMU gaps (max interval=%.3fs)") % imu.num_imu_gaps % imu.max_interval).str());
+    }
+    if (imu.num_imu_non_finite) {
+      warnings.emplace_back((boost::format("%d non-finite IMU samples") % imu.num_imu_non_finite).str());
+    }
+
+    const size_t num_valid = imu.num_messages - imu.num_imu_non_finite;
+    const double acc_norm = num_valid ? imu.sum_acc_norm / num_valid : 0.0;
+    if (num_valid && std::abs(acc_norm - 9.80665) > params.max_acc_norm_diff) {
+      warnings.emplace_back((boost::format("mean IMU acc norm %.3f is far from gravity (not m/s^2 or acc_scale required?)") % acc_norm).str());
+    }
+  }
+
+  if (!points.num_messages) {
+    warnings.emplace_back("no point cloud messages");
+  } else {
+    if (points.num_stamp_errors) {
+      warnings.emplace_back((boost::format("%d point cloud stamps did not increase") % points.num_stamp_errors).str());
+    }
+    if (points.num_unsupported) {
+      warnings.emplace_back((boost::format("%d point clouds have layouts that cannot be validated") % points.num_unsupported).str());
+    }
+    if (points.num_without_times) {
+      warnings.emplace_back((boost::format("%d point clouds have no per-point times (deskewing is disabled)") % points.num_without_times).str());
+    }
+    if (points.num_time_disorder) {
+      warnings.emplace_back((boost::format("%d points are not ordered by time") % points.num_time_disorder).str());
+    }
+    if (points.num_points && points.num_non_finite > points.num_points / 2) {
+      warnings.emplace_back((boost::format("%.1f%% of points are non-finite") % (100.0 * points.num_non_finite / points.num_points)).str());
+    }
+    if (points.max_scan_duration > 2.0 * points.mean_interval() && points.mean_interval() > 0.0) {
+      warnings.emplace_back((boost::format("scan duration %.3fs exceeds the scan interval %.3fs (wrong time unit?)") % points.max_scan_duration % points.mean_interval()).str());
+    }
+  }
+
+  return warnings;
+}
+
+}  // namespace glim
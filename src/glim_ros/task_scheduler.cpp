@@ -0,0 +1,267 @@
+#include <glim_ros/task_scheduler.hpp>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace glim {
+
+namespace {
+
+// Used if tasks are submitted before start() is called
+constexpr int default_num_threads = 2;
+constexpr int default_nice = 5;
+
+// One worker is reserved for HIGH and NORMAL tasks, and LOW tasks need another one
+constexpr int min_num_threads = 2;
+
+}  // namespace
+
+void PeriodicTask::wake() {
+  scheduler->wake(shared_from_this());
+}
+
+void PeriodicTask::cancel() {
+  scheduler->cancel(shared_from_this());
+}
+
+TaskScheduler& TaskScheduler::instance() {
+  static TaskScheduler scheduler;
+  return scheduler;
+}
+
+TaskScheduler::TaskScheduler() : kill_switch(false), num_low_running(0) {}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    kill_switch = true;
+  }
+  task_pushed.notify_all();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void TaskScheduler::start(int num_threads, int nice) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!workers.empty()) {
+    spdlog::debug("task scheduler is already started with {} threads", workers.size());
+    return;
+  }
+
+  start_workers(num_threads, nice);
+}
+
+void TaskScheduler::start_workers(int num_threads, int nice) {
+  if (num_threads < min_num_threads) {
+    spdlog::warn("scheduler_threads={} is raised to {} (one worker is reserved for HIGH and NORMAL tasks)", num_threads, min_num_threads);
+    num_threads = min_num_threads;
+  }
+  spdlog::debug("start task scheduler (num_threads={} nice={})", num_threads, nice);
+  for (int i = 0; i < num_threads; i++) {
+    workers.emplace_back([this, nice] { worker_task(nice); });
+  }
+}
+
+size_t TaskScheduler::num_threads() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return workers.size();
+}
+
+void TaskScheduler::submit(TaskPriority priority, const Task& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty()) {
+      start_workers(default_num_threads, default_nice);
+    }
+    push_ready(Entry{priority, task, nullptr, 0});
+  }
+  task_pushed.notify_one();
+}
+
+void TaskScheduler::submit_after(Clock::duration delay, TaskPriority priority, const Task& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty()) {
+      start_workers(default_num_threads, default_nice);
+    }
+    timers.emplace(Clock::now() + delay, Entry{priority, task, nullptr, 0});
+  }
+  task_pushed.notify_one();
+}
+
+PeriodicTask::Ptr TaskScheduler::schedule_periodic(const std::string& name, Clock::duration interval, TaskPriority priority, const Task& task) {
+  PeriodicTask::Ptr periodic(new PeriodicTask(this, name, interval, priority, task));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty()) {
+      start_workers(default_num_threads, default_nice);
+    }
+    periodic->ready = true;
+    push_ready(Entry{priority, nullptr, periodic, periodic->generation});
+  }
+  task_pushed.notify_one();
+  return periodic;
+}
+
+void TaskScheduler::parallel_for(TaskPriority priority, int num_tasks, size_t n, const std::function<void(size_t)>& body) {
+  struct State {
+    std::atomic_size_t cursor{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t num_done = 0;
+  };
+
+  // Helpers starting after every index has been claimed return without touching body (it may be gone by then)
+  const auto state = std::make_shared<State>();
+  const auto work = [state, n, body = &body] {
+    for (size_t i = state->cursor++; i < n; i = state->cursor++) {
+      (*body)(i);
+
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (++state->num_done == n) {
+        state->finished.notify_all();
+      }
+    }
+  };
+
+  for (size_t i = 1; i < std::min<size_t>(std::max(1, num_tasks), n); i++) {
+    submit(priority, work);
+  }
+  work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&] { return state->num_done == n; });
+}
+
+void TaskScheduler::wake(const PeriodicTask::Ptr& periodic) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (periodic->canceled || periodic->ready) {
+      return;
+    }
+    if (periodic->running) {
+      periodic->woken = true;
+      return;
+    }
+
+    // Invalidate the pending timer entry
+    periodic->generation++;
+    periodic->ready = true;
+    push_ready(Entry{periodic->priority, nullptr, periodic, periodic->generation});
+  }
+  task_pushed.notify_one();
+}
+
+void TaskScheduler::cancel(const PeriodicTask::Ptr& periodic) {
+  std::unique_lock<std::mutex> lock(mutex);
+  periodic->canceled = true;
+  periodic->generation++;
+  task_finished.wait(lock, [&] { return !periodic->running; });
+}
+
+void TaskScheduler::push_ready(Entry&& entry) {
+  ready[static_cast<int>(entry.priority)].emplace_back(std::move(entry));
+}
+
+bool TaskScheduler::pop_ready(Entry& entry) {
+  // Keep one worker available for HIGH and NORMAL tasks (start_workers() ensures that there are at least two)
+  const size_t max_low_running = workers.size() - 1;
+
+  for (int i = 0; i < 3; i++) {
+    if (ready[i].empty() || (i == static_cast<int>(TaskPriority::LOW) && num_low_running >= max_low_running)) {
+      continue;
+    }
+
+    entry = std::move(ready[i].front());
+    ready[i].pop_front();
+    return true;
+  }
+
+  return false;
+}
+
+void TaskScheduler::worker_task(int nice) {
+  if (nice && setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice)) {
+    spdlog::debug("failed to set the priority of a task scheduler thread");
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    // Move expired timers into the ready queues
+    const auto now = Clock::now();
+    while (!timers.empty() && timers.begin()->first <= now) {
+      Entry entry = std::move(timers.begin()->second);
+      timers.erase(timers.begin());
+
+      if (entry.periodic) {
+        if (entry.periodic->canceled || entry.generation != entry.periodic->generation) {
+          continue;
+        }
+        entry.periodic->ready = true;
+      }
+      push_ready(std::move(entry));
+    }
+
+    Entry entry;
+    if (!pop_ready(entry)) {
+      if (kill_switch) {
+        break;
+      }
+
+      if (timers.empty()) {
+        task_pushed.wait(lock);
+      } else {
+        task_pushed.wait_until(lock, timers.begin()->first);
+      }
+      continue;
+    }
+
+    const auto& periodic = entry.periodic;
+    if (periodic) {
+      periodic->ready = false;
+      if (periodic->canceled) {
+        continue;
+      }
+      periodic->running = true;
+    }
+
+    const bool low = entry.priority == TaskPriority::LOW;
+    num_low_running += low;
+
+    const auto t0 = Clock::now();
+    lock.unlock();
+    try {
+      periodic ? periodic->task() : entry.task();
+    } catch (const std::exception& e) {
+      spdlog::error("task {} threw an exception: {}", periodic ? periodic->name : "(one-shot)", e.what());
+    }
+    lock.lock();
+
+    num_low_running -= low;
+
+    if (periodic) {
+      periodic->running = false;
+      if (periodic->woken && !periodic->canceled) {
+        periodic->woken = false;
+        periodic->ready = true;
+        push_ready(Entry{periodic->priority, nullptr, periodic, periodic->generation});
+      } else if (!periodic->canceled) {
+        timers.emplace(t0 + periodic->interval, Entry{periodic->priority, nullptr, periodic, periodic->generation});
+      }
+      task_finished.notify_all();
+    }
+
+    // A LOW task may have been held back by the running one
+    if (low) {
+      task_pushed.notify_one();
+    }
+  }
+}
+
+}  // namespace glim
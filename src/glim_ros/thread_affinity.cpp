@@ -0,0 +1,190 @@
+#include <glim_ros/thread_affinity.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <spdlog/spdlog.h>
+#include <glim/util/config.hpp>
+
+namespace glim {
+
+namespace {
+
+// set_mempolicy/get_mempolicy are called via syscall() to avoid depending on libnuma
+constexpr unsigned long max_numa_nodes = sizeof(unsigned long) * 8;
+
+long set_mempolicy(int mode, const unsigned long* nodes) {
+  return syscall(SYS_set_mempolicy, mode, nodes, nodes ? max_numa_nodes + 1 : 0);
+}
+
+long get_mempolicy(int* mode, unsigned long* nodes) {
+  return syscall(SYS_get_mempolicy, mode, nodes, max_numa_nodes + 1, nullptr, 0);
+}
+
+std::string format_cpus(const cpu_set_t& set) {
+  std::string str;
+  for (int i = 0; i < CPU_SETSIZE; i++) {
+    if (!CPU_ISSET(i, &set)) {
+      continue;
+    }
+
+    // Consecutive CPUs are formatted as a range (e.g., 0-3,8)
+    int last = i;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set)) {
+      last++;
+    }
+    str += (str.empty() ? "" : ",") + (last == i ? std::to_string(i) : std::to_string(i) + "-" + std::to_string(last));
+    i = last;
+  }
+  return str;
+}
+
+}  // namespace
+
+ThreadAffinity ThreadAffinity::load(const Config& config, const std::string& stage) {
+  ThreadAffinity affinity;
+  affinity.stage = stage;
+  affinity.cpus = config.param<std::vector<int>>("glim_ros", stage + "_cpus", std::vector<int>());
+  affinity.numa_node = config.param<int>("glim_ros", stage + "_numa_node", -1);
+  affinity.priority = config.param<int>("glim_ros", stage + "_priority", 0);
+  return affinity;
+}
+
+std::string ThreadAffinity::to_string() const {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  std::string str = "cpus=" + (cpus.empty() ? std::string("any") : format_cpus(set));
+  str += " numa_node=" + (numa_node < 0 ? std::string("default") : std::to_string(numa_node));
+  str += " sched=" + (priority > 0 ? "FIFO:" + std::to_string(priority) : std::string("OTHER"));
+  return str;
+}
+
+ScopedThreadAffinity::ScopedThreadAffinity(const ThreadAffinity& affinity) : empty(affinity.empty()) {
+  if (empty) {
+    return;
+  }
+
+  // Save the current settings to restore them on destruction
+  CPU_ZERO(&cpus);
+  pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+  sched_param param;
+  pthread_getschedparam(pthread_self(), &sched_policy, &param);
+  sched_priority = param.sched_priority;
+
+  mempolicy_nodes = 0;
+  if (get_mempolicy(&mempolicy_mode, &mempolicy_nodes)) {
+    mempolicy_mode = MPOL_DEFAULT;
+  }
+
+  spdlog::info("thread affinity of {}: requested {} -> {}", affinity.stage, affinity.to_string(), apply(affinity));
+}
+
+ScopedThreadAffinity::~ScopedThreadAffinity() {
+  if (empty) {
+    return;
+  }
+
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+  sched_param param;
+  param.sched_priority = sched_priority;
+  pthread_setschedparam(pthread_self(), sched_policy, &param);
+
+  set_mempolicy(mempolicy_mode, mempolicy_mode == MPOL_DEFAULT ? nullptr : &mempolicy_nodes);
+}
+
+std::string ScopedThreadAffinity::apply(const ThreadAffinity& affinity) {
+  std::string failures;
+
+  if (!affinity.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : affinity.cpus) {
+      if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        spdlog::warn("invalid CPU index {} for {}", cpu, affinity.stage);
+        continue;
+      }
+      CPU_SET(cpu, &set);
+    }
+
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err) {
+      failures += std::string(" (cpus: ") + std::strerror(err) + ")";
+    }
+  }
+
+  if (affinity.numa_node >= 0) {
+    if (affinity.numa_node >= static_cast<int>(max_numa_nodes)) {
+      failures += " (numa_node: out of range)";
+    } else {
+      const unsigned long nodes = 1ul << affinity.numa_node;
+      if (set_mempolicy(MPOL_BIND, &nodes)) {
+        failures += std::string(" (numa_node: ") + std::strerror(errno) + ")";
+      }
+    }
+  }
+
+  if (affinity.priority > 0) {
+    // Requires CAP_SYS_NICE or an rtprio limit (e.g., /etc/security/limits.conf)
+    sched_param param;
+    param.sched_priority = affinity.priority;
+    const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) {
+      failures += std::string(" (sched: ") + std::strerror(err) + ")";
+    }
+  }
+
+  if (!failures.empty()) {
+    spdlog::warn("failed to apply thread affinity of {}:{}", affinity.stage, failures);
+  }
+
+  return current() + (failures.empty() ? "" : " failed:" + failures);
+}
+
+std::string ScopedThreadAffinity::current() {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+
+  int policy;
+  sched_param param;
+  pthread_getschedparam(pthread_self(), &policy, &param);
+
+  int mode = MPOL_DEFAULT;
+  unsigned long nodes = 0;
+  if (get_mempolicy(&mode, &nodes)) {
+    mode = MPOL_DEFAULT;
+  }
+
+  std::string str = "cpus=" + format_cpus(set);
+  if (mode == MPOL_DEFAULT) {
+    str += " numa=default";
+  } else {
+    std::string node_list;
+    for (unsigned long i = 0; i < max_numa_nodes; i++) {
+      if (nodes & (1ul << i)) {
+        node_list += (node_list.empty() ? "" : ",") + std::to_string(i);
+      }
+    }
+    str += (mode == MPOL_BIND ? " numa=bind:" : " numa=policy" + std::to_string(mode) + ":") + node_list;
+  }
+  if (policy == SCHED_FIFO || policy == SCHED_RR) {
+    str += (policy == SCHED_FIFO ? " sched=FIFO:" : " sched=RR:") + std::to_string(param.sched_priority);
+  } else {
+    str += " sched=OTHER";
+  }
+
+  return str;
+}
+
+}  // namespace glim
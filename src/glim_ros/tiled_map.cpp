@@ -0,0 +1,329 @@
+#include <glim_ros/tiled_map.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <gtsam_points/types/point_cloud_cpu.hpp>
+#include <glim_ros/point_cloud2_packer.hpp>
+#include <glim_ros/task_scheduler.hpp>
+
+namespace glim {
+
+namespace {
+
+const PointCloud2Packing packing(false, false);
+
+}  // namespace
+
+TiledMapParams::TiledMapParams() {
+  tile_size = 50.0;
+  lod_resolutions = {0.2, 0.8, 3.2};
+  translation_tolerance = 1e-2;
+  rotation_tolerance = 1e-3;
+}
+
+TiledMap::TiledMap(const TiledMapParams& params) : params(params), num_dirty_tiles(0) {}
+
+TiledMap::~TiledMap() {}
+
+void TiledMap::insert(double stamp, const gtsam_points::PointCloud::ConstPtr& points, const Eigen::Isometry3d& T_world_origin) {
+  Submap submap;
+  submap.stamp = stamp;
+  submap.T_world_origin = T_world_origin;
+  submap.local_points = params.lod_resolutions.empty() ? points : gtsam_points::voxelgrid_sampling(points, params.lod_resolutions.front());
+
+  submap.local_bounds.setEmpty();
+  for (size_t i = 0; i < submap.local_points->size(); i++) {
+    submap.local_bounds.extend(submap.local_points->points[i].head<3>());
+  }
+
+  submaps.emplace_back(std::move(submap));
+  bin(submaps.size() - 1);
+}
+
+int TiledMap::update_poses(const Poses& poses) {
+  int num_moved = 0;
+
+  const size_t num_submaps = std::min(poses.size(), submaps.size());
+  for (size_t i = 0; i < num_submaps; i++) {
+    auto& submap = submaps[i];
+    const Eigen::Isometry3d delta = submap.T_world_origin.inverse() * poses[i];
+    const double translation = delta.translation().norm();
+    const double rotation = Eigen::AngleAxisd(delta.linear()).angle();
+    if (translation < params.translation_tolerance && rotation < params.rotation_tolerance) {
+      continue;
+    }
+
+    // Both the tiles the submap left and the tiles it moved into are rebuilt
+    unbin(i);
+    submap.T_world_origin = poses[i];
+    bin(i);
+    num_moved++;
+  }
+
+  return num_moved;
+}
+
+std::vector<TiledMap::TileKey> TiledMap::rebuild(int num_tasks) {
+  std::vector<TileKey> keys;
+  keys.reserve(num_dirty_tiles);
+  for (const auto& tile : tiles) {
+    if (tile.second.dirty) {
+      keys.emplace_back(tile.first);
+    }
+  }
+
+  if (keys.empty()) {
+    return keys;
+  }
+
+  // Transform each involved submap only once and distribute its world points to the dirty tiles
+  std::map<TileKey, size_t> bucket_index;
+  for (size_t i = 0; i < keys.size(); i++) {
+    bucket_index[keys[i]] = i;
+  }
+
+  std::vector<int> involved;
+  for (const auto& key : keys) {
+    const auto& tile = tiles[key];
+    involved.insert(involved.end(), tile.submaps.begin(), tile.submaps.end());
+  }
+  std::sort(involved.begin(), involved.end());
+  involved.erase(std::unique(involved.begin(), involved.end()), involved.end());
+
+  std::vector<std::vector<Eigen::Vector4d>> buckets(keys.size());
+  for (const int submap_id : involved) {
+    const auto& submap = submaps[submap_id];
+    for (size_t i = 0; i < submap.local_points->size(); i++) {
+      const Eigen::Vector4d pt = submap.T_world_origin * submap.local_points->points[i];
+      const auto found = bucket_index.find(tile_key(pt.x(), pt.y()));
+      if (found != bucket_index.end()) {
+        buckets[found->second].emplace_back(pt);
+      }
+    }
+  }
+
+  // Tiles are independent of each other and are rebuilt on the shared workers (no threads outside the pool)
+  TaskScheduler::instance().parallel_for(TaskPriority::NORMAL, num_tasks, keys.size(), [&](size_t i) {
+    auto& tile = tiles.find(keys[i])->second;
+    auto& bucket = buckets[i];
+
+    tile.levels.clear();
+    tile.levels.resize(params.lod_resolutions.size(), Level{0, {}});
+    tile.min_z = std::numeric_limits<double>::max();
+    tile.max_z = std::numeric_limits<double>::lowest();
+    for (const auto& pt : bucket) {
+      tile.min_z = std::min(tile.min_z, pt.z());
+      tile.max_z = std::max(tile.max_z, pt.z());
+    }
+
+    gtsam_points::PointCloud::ConstPtr level_points = std::make_shared<gtsam_points::PointCloudCPU>(bucket.data(), bucket.size());
+    for (size_t level = 0; level < params.lod_resolutions.size() && !bucket.empty(); level++) {
+      // Each level is downsampled from the next finer one (the finest level merges the overlapping submaps)
+      level_points = gtsam_points::voxelgrid_sampling(level_points, params.lod_resolutions[level]);
+      tile.levels[level].num_points = level_points->size();
+      tile.levels[level].points.resize(packing.point_step * level_points->size());
+      transform_and_pack(Eigen::Isometry3d::Identity(), *level_points, packing, tile.levels[level].points.data(), false);
+    }
+
+    std::vector<Eigen::Vector4d>().swap(bucket);
+    tile.version++;
+    tile.dirty = false;
+  });
+  num_dirty_tiles = 0;
+
+  // Remove tiles no submap overlaps anymore
+  for (const auto& key : keys) {
+    const auto found = tiles.find(key);
+    if (found->second.submaps.empty()) {
+      tiles.erase(found);
+    }
+  }
+
+  return keys;
+}
+
+size_t TiledMap::memory_usage() const {
+  size_t bytes = 0;
+  for (const auto& submap : submaps) {
+    bytes += submap.local_points->size() * sizeof(Eigen::Vector4d);
+  }
+  for (const auto& tile : tiles) {
+    for (const auto& level : tile.second.levels) {
+      bytes += level.points.capacity();
+    }
+  }
+  return bytes;
+}
+
+std::vector<TiledMap::TileKey> TiledMap::overlapping_tiles(const Eigen::Vector2d& min_pt, const Eigen::Vector2d& max_pt) const {
+  std::vector<TileKey> keys;
+  if ((max_pt.array() < min_pt.array()).any()) {
+    return keys;
+  }
+
+  const TileKey min_key = tile_key(min_pt.x(), min_pt.y());
+  const TileKey max_key = tile_key(max_pt.x(), max_pt.y());
+  const double num_candidates = (static_cast<double>(max_key.first) - min_key.first + 1) * (static_cast<double>(max_key.second) - min_key.second + 1);
+
+  if (num_candidates > tiles.size()) {
+    // A large region is answered by scanning the existing tiles rather than every key in the range
+    for (const auto& tile : tiles) {
+      const TileKey& key = tile.first;
+      if (key.first >= min_key.first && key.first <= max_key.first && key.second >= min_key.second && key.second <= max_key.second) {
+        keys.emplace_back(key);
+      }
+    }
+    return keys;
+  }
+
+  for (int x = min_key.first; x <= max_key.first; x++) {
+    for (int y = min_key.second; y <= max_key.second; y++) {
+      if (tiles.count(TileKey(x, y))) {
+        keys.emplace_back(x, y);
+      }
+    }
+  }
+  return keys;
+}
+
+int TiledMap::select_level(const Query& query) const {
+  if (params.lod_resolutions.empty()) {
+    return -1;
+  }
+
+  // The coarsest level that still satisfies the requested resolution
+  int level = 0;
+  while (level + 1 < static_cast<int>(params.lod_resolutions.size()) && params.lod_resolutions[level + 1] <= query.resolution) {
+    level++;
+  }
+
+  if (!query.max_points) {
+    return level;
+  }
+
+  // Fall back to coarser levels while the region has too many points (counted per overlapping tile, i.e., an upper bound)
+  const auto keys = overlapping_tiles(query.min_pt.head<2>(), query.max_pt.head<2>());
+  for (; level + 1 < static_cast<int>(params.lod_resolutions.size()); level++) {
+    size_t num_points = 0;
+    for (const auto& key : keys) {
+      const auto& tile = tiles.at(key);
+      num_points += tile.levels.empty() ? 0 : tile.levels[level].num_points;
+    }
+
+    if (num_points <= query.max_points) {
+      break;
+    }
+  }
+
+  return level;
+}
+
+int TiledMap::query(const Query& query, const std::string& frame_id, double stamp, sensor_msgs::msg::PointCloud2& msg) const {
+  const int level = select_level(query);
+  const auto keys = level < 0 ? std::vector<TileKey>() : overlapping_tiles(query.min_pt.head<2>(), query.max_pt.head<2>());
+
+  size_t max_num_points = 0;
+  for (const auto& key : keys) {
+    const auto& tile = tiles.at(key);
+    max_num_points += tile.levels.empty() ? 0 : tile.levels[level].num_points;
+  }
+
+  init_pointcloud2(frame_id, stamp, max_num_points, packing, msg);
+
+  size_t num_points = 0;
+  std::uint8_t* data = msg.data.data();
+  for (const auto& key : keys) {
+    const auto& tile = tiles.at(key);
+    if (tile.levels.empty() || !tile.levels[level].num_points) {
+      continue;
+    }
+
+    const auto& points = tile.levels[level];
+    const Eigen::Vector3d tile_min(key.first * params.tile_size, key.second * params.tile_size, tile.min_z);
+    const Eigen::Vector3d tile_max((key.first + 1) * params.tile_size, (key.second + 1) * params.tile_size, tile.max_z);
+
+    // Tiles entirely in the region are copied as is
+    if ((tile_min.array() >= query.min_pt.array()).all() && (tile_max.array() <= query.max_pt.array()).all()) {
+      std::memcpy(data + packing.point_step * num_points, points.points.data(), points.points.size());
+      num_points += points.num_points;
+      continue;
+    }
+
+    const Eigen::Vector3f min_pt = query.min_pt.cast<float>();
+    const Eigen::Vector3f max_pt = query.max_pt.cast<float>();
+    for (size_t i = 0; i < points.num_points; i++) {
+      const std::uint8_t* point = points.points.data() + packing.point_step * i;
+      Eigen::Vector3f pt;
+      std::memcpy(pt.data(), point, sizeof(float) * 3);
+      if ((pt.array() >= min_pt.array()).all() && (pt.array() <= max_pt.array()).all()) {
+        std::memcpy(data + packing.point_step * num_points, point, packing.point_step);
+        num_points++;
+      }
+    }
+  }
+
+  msg.width = num_points;
+  msg.row_step = packing.point_step * num_points;
+  msg.data.resize(msg.row_step);
+
+  return level;
+}
+
+TiledMap::TileKey TiledMap::tile_key(double x, double y) const {
+  return TileKey(static_cast<int>(std::floor(x / params.tile_size)), static_cast<int>(std::floor(y / params.tile_size)));
+}
+
+void TiledMap::bin(int submap_id) {
+  auto& submap = submaps[submap_id];
+  submap.tiles.clear();
+  if (submap.local_bounds.isEmpty()) {
+    return;
+  }
+
+  // XY bounds of the transformed bounding box corners
+  Eigen::AlignedBox2d world_bounds;
+  world_bounds.setEmpty();
+  for (int i = 0; i < 8; i++) {
+    const Eigen::Vector3d corner = submap.T_world_origin * submap.local_bounds.corner(static_cast<Eigen::AlignedBox3d::CornerType>(i));
+    world_bounds.extend(corner.head<2>());
+  }
+
+  const TileKey min_key = tile_key(world_bounds.min().x(), world_bounds.min().y());
+  const TileKey max_key = tile_key(world_bounds.max().x(), world_bounds.max().y());
+  for (int x = min_key.first; x <= max_key.first; x++) {
+    for (int y = min_key.second; y <= max_key.second; y++) {
+      auto found = tiles.find(TileKey(x, y));
+      if (found == tiles.end()) {
+        Tile tile;
+        tile.min_z = tile.max_z = 0.0;
+        tile.version = 0;
+        tile.dirty = false;
+        found = tiles.emplace(TileKey(x, y), std::move(tile)).first;
+      }
+
+      found->second.submaps.emplace_back(submap_id);
+      mark_dirty(found->second);
+      submap.tiles.emplace_back(x, y);
+    }
+  }
+}
+
+void TiledMap::unbin(int submap_id) {
+  for (const auto& key : submaps[submap_id].tiles) {
+    auto& tile = tiles[key];
+    tile.submaps.erase(std::remove(tile.submaps.begin(), tile.submaps.end(), submap_id), tile.submaps.end());
+    mark_dirty(tile);
+  }
+  submaps[submap_id].tiles.clear();
+}
+
+void TiledMap::mark_dirty(Tile& tile) {
+  if (!tile.dirty) {
+    tile.dirty = true;
+    num_dirty_tiles++;
+  }
+}
+
+}  // namespace glim
@@ -1,45 +1,204 @@
 #include <glob.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
 #include <boost/format.hpp>
 #include <rclcpp/rclcpp.hpp>
-#include <sensor_msgs/msg/compressed_image.hpp>
-#include <rosbag2_cpp/reader.hpp>
-#include <rosbag2_cpp/readers/sequential_reader.hpp>
-#include <rosbag2_compression/sequential_compression_reader.hpp>
-#include <rosbag2_storage/storage_filter.hpp>
 #include <ament_index_cpp/get_package_share_directory.hpp>
 
 #include <glim/util/config.hpp>
 #include <glim/util/extension_module_ros2.hpp>
 #include <glim_ros/glim_ros.hpp>
-#include <glim_ros/ros_compatibility.hpp>
-
-class SpeedCounter {
+#include <glim_ros/bag_player.hpp>
+
+/**
+ * @brief Runs independent mapping sessions in parallel child processes.
+ * @note  GLIM keeps global state (GlobalConfig, module callbacks, loggers), so each session needs its own process.
+ *
+ * Each non-empty line of the batch file describes one session: "dump_path bag_glob [bag_glob ...]".
+ * Bags on the same line are chained and processed in order through one pipeline (sharing its global mapping).
+ */
+class BatchRunner {
 public:
-  SpeedCounter() : last_sim_time(0.0), last_real_time(std::chrono::high_resolution_clock::now()) {}
+  struct Session {
+    std::string dump_path;
+    std::vector<std::string> bag_patterns;
+  };
 
-  void update(const double& stamp) {
-    const auto now = std::chrono::high_resolution_clock::now();
-    if (now - last_real_time < std::chrono::seconds(5)) {
+  BatchRunner(const std::string& batch_file, int max_sessions, bool pin_cpus, const std::vector<int64_t>& gpus, const std::vector<std::string>& ros_args)
+  : max_sessions(max_sessions),
+    pin_cpus(pin_cpus),
+    gpus(gpus),
+    ros_args(ros_args) {
+    std::ifstream ifs(batch_file);
+    if (!ifs) {
+      spdlog::error("failed to open batch file {}", batch_file);
       return;
     }
 
-    if (last_sim_time > 0.0) {
-      const auto real = now - last_real_time;
-      const auto sim = stamp - last_sim_time;
-      const double playback_speed = sim / (std::chrono::duration_cast<std::chrono::nanoseconds>(real).count() / 1e9);
-      spdlog::info("playback speed: {:.3f}x", playback_speed);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+
+      Session session;
+      std::stringstream sst(line);
+      sst >> session.dump_path;
+      std::string pattern;
+      while (sst >> pattern) {
+        session.bag_patterns.emplace_back(pattern);
+      }
+
+      if (session.bag_patterns.empty()) {
+        spdlog::warn("skip a session without bags (dump_path={})", session.dump_path);
+        continue;
+      }
+      sessions.emplace_back(session);
     }
 
-    last_sim_time = stamp;
-    last_real_time = now;
+    const int num_cpus = std::max<int>(1, std::thread::hardware_concurrency());
+    if (this->max_sessions <= 0) {
+      // Give each session a reasonable number of cores for odometry, mapping and extension threads
+      this->max_sessions = std::max(1, num_cpus / 8);
+    }
+    this->max_sessions = std::min<int>(this->max_sessions, std::max<size_t>(1, sessions.size()));
+    cpus_per_session = std::max(1, num_cpus / this->max_sessions);
+  }
+
+  /// @brief Run all the sessions and return the number of failed sessions
+  int run() {
+    spdlog::info("batch: {} sessions ({} in parallel, {} cpus per session)", sessions.size(), max_sessions, cpus_per_session);
+
+    std::vector<pid_t> slots(max_sessions, -1);
+    std::unordered_map<pid_t, std::pair<size_t, std::chrono::steady_clock::time_point>> running;
+
+    int num_failed = 0;
+    size_t next_session = 0;
+    while (next_session < sessions.size() || !running.empty()) {
+      // Launch sessions on free slots
+      for (int slot = 0; slot < max_sessions && next_session < sessions.size(); slot++) {
+        if (slots[slot] >= 0) {
+          continue;
+        }
+
+        const pid_t pid = launch(sessions[next_session], slot);
+        if (pid < 0) {
+          spdlog::error("failed to launch session {} (dump_path={})", next_session, sessions[next_session].dump_path);
+          num_failed++;
+        } else {
+          spdlog::info("batch: session {} started (pid={} slot={} dump_path={})", next_session, pid, slot, sessions[next_session].dump_path);
+          slots[slot] = pid;
+          running[pid] = {next_session, std::chrono::steady_clock::now()};
+        }
+        next_session++;
+      }
+
+      if (running.empty()) {
+        continue;
+      }
+
+      int status = 0;
+      const pid_t pid = waitpid(-1, &status, 0);
+      const auto found = running.find(pid);
+      if (pid < 0 || found == running.end()) {
+        continue;
+      }
+
+      const bool succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+      const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - found->second.second).count();
+      if (succeeded) {
+        spdlog::info("batch: session {} finished in {:.1f} sec", found->second.first, elapsed);
+      } else {
+        spdlog::error("batch: session {} failed (status={}) after {:.1f} sec", found->second.first, status, elapsed);
+        num_failed++;
+      }
+
+      std::replace(slots.begin(), slots.end(), pid, pid_t(-1));
+      running.erase(found);
+    }
+
+    spdlog::info("batch: done ({} / {} sessions succeeded)", sessions.size() - num_failed, sessions.size());
+    return num_failed;
   }
 
 private:
-  double last_sim_time;
-  std::chrono::high_resolution_clock::time_point last_real_time;
+  pid_t launch(const Session& session, int slot) const {
+    std::vector<std::string> args = {"glim_rosbag"};
+    args.insert(args.end(), session.bag_patterns.begin(), session.bag_patterns.end());
+    args.emplace_back("--ros-args");
+    args.insert(args.end(), ros_args.begin(), ros_args.end());
+    args.insert(args.end(), {"-p", "dump_path:=" + session.dump_path, "-p", "auto_quit:=true", "-r", "__node:=glim_ros_" + std::to_string(slot)});
+
+    const std::string log_path = session.dump_path + ".log";
+
+    // Everything the child needs is prepared before fork() because the child of a multi-threaded process
+    // may only call async-signal-safe functions (no allocation or setenv) until execve()
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+      argv.emplace_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.emplace_back(nullptr);
+
+    std::vector<std::string> env_vars = {"GLIM_ROSBAG_BATCH_SESSION=" + std::to_string(slot)};
+    if (!gpus.empty()) {
+      env_vars.emplace_back("CUDA_VISIBLE_DEVICES=" + std::to_string(gpus[slot % gpus.size()]));
+    }
+    for (char** env = environ; *env; env++) {
+      const std::string var(*env);
+      if (var.rfind("GLIM_ROSBAG_BATCH_SESSION=", 0) != 0 && (gpus.empty() || var.rfind("CUDA_VISIBLE_DEVICES=", 0) != 0)) {
+        env_vars.emplace_back(var);
+      }
+    }
+
+    std::vector<char*> envp;
+    for (auto& var : env_vars) {
+      envp.emplace_back(const_cast<char*>(var.c_str()));
+    }
+    envp.emplace_back(nullptr);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int i = 0; i < cpus_per_session; i++) {
+      CPU_SET(slot * cpus_per_session + i, &cpus);
+    }
+
+    const pid_t pid = fork();
+    if (pid != 0) {
+      return pid;
+    }
+
+    // Child process
+    if (pin_cpus) {
+      sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    const int fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+
+    execve("/proc/self/exe", argv.data(), envp.data());
+    _exit(127);
+  }
+
+private:
+  int max_sessions;
+  int cpus_per_session;
+  const bool pin_cpus;
+  const std::vector<int64_t> gpus;
+  const std::vector<std::string> ros_args;
+  std::vector<Session> sessions;
 };
 
 int main(int argc, char** argv) {
@@ -49,31 +208,34 @@ int main(int argc, char** argv) {
   }
 
   rclcpp::init(argc, argv);
-  rclcpp::NodeOptions options;
-  auto glim = std::make_shared<glim::GlimROS>(options);
-
-  // List topics
-  glim::Config config_ros(glim::GlobalConfig::get_config_path("config_ros"));
 
-  const std::string imu_topic = config_ros.param<std::string>("glim_ros", "imu_topic", "/imu");
-  const std::string points_topic = config_ros.param<std::string>("glim_ros", "points_topic", "/points");
-  const std::string image_topic = config_ros.param<std::string>("glim_ros", "image_topic", "/image");
-  std::vector<std::string> topics = {imu_topic, points_topic, image_topic};
+  // Batch mode (skipped in the session processes launched by the batch runner)
+  if (!std::getenv("GLIM_ROSBAG_BATCH_SESSION")) {
+    auto batch_node = std::make_shared<rclcpp::Node>("glim_rosbag_batch");
+    const std::string batch_file = batch_node->declare_parameter<std::string>("batch_file", "");
+    if (!batch_file.empty()) {
+      const int max_sessions = batch_node->declare_parameter<int>("batch_max_sessions", 0);
+      const bool pin_cpus = batch_node->declare_parameter<bool>("batch_pin_cpus", true);
+      const std::vector<int64_t> gpus = batch_node->declare_parameter<std::vector<int64_t>>("batch_gpus", std::vector<int64_t>());
+      batch_node.reset();
+
+      // Forward the ROS arguments given to this process to the sessions
+      std::vector<std::string> ros_args;
+      const auto ros_args_begin = std::find(argv, argv + argc, std::string("--ros-args"));
+      for (auto arg = ros_args_begin; arg != argv + argc; arg++) {
+        if (arg != ros_args_begin) {
+          ros_args.emplace_back(*arg);
+        }
+      }
 
-  rosbag2_storage::StorageFilter filter;
-  spdlog::info("topics:");
-  for (const auto& topic : topics) {
-    spdlog::info("- {}", topic);
-    filter.topics.push_back(topic);
+      const int num_failed = BatchRunner(batch_file, max_sessions, pin_cpus, gpus, ros_args).run();
+      rclcpp::shutdown();
+      return num_failed ? 1 : 0;
+    }
   }
 
-  //
-  std::unordered_map<std::string, std::vector<glim::GenericTopicSubscription::Ptr>> subscription_map;
-  for (const auto& sub : glim->extension_subscriptions()) {
-    spdlog::info("- {} (ext)", sub->topic);
-    filter.topics.push_back(sub->topic);
-    subscription_map[sub->topic].push_back(sub);
-  }
+  rclcpp::NodeOptions options;
+  auto glim = std::make_shared<glim::GlimROS>(options);
 
   // List input rosbag filenames
   std::vector<std::string> bag_filenames;
@@ -96,204 +258,29 @@ int main(int argc, char** argv) {
     spdlog::info("- {}", bag_filename);
   }
 
-  // Playback range settings
   double delay = 0.0;
   glim->declare_parameter<double>("delay", delay);
   glim->get_parameter<double>("delay", delay);
 
-  double start_offset = 0.0;
-  glim->declare_parameter<double>("start_offset", start_offset);
-  glim->get_parameter<double>("start_offset", start_offset);
-
-  double playback_duration = 0.0;
-  glim->declare_parameter<double>("playback_duration", playback_duration);
-  glim->get_parameter<double>("playback_duration", playback_duration);
-
-  double playback_until = 0.0;
-  glim->declare_parameter<double>("playback_until", playback_until);
-  glim->get_parameter<double>("playback_until", playback_until);
-
-  // Playback speed settings
-  const double playback_speed = config_ros.param<double>("glim_ros", "playback_speed", 100.0);
-  std::chrono::high_resolution_clock::time_point real_t0;
-  rcutils_time_point_value_t bag_t0 = 0;
-  SpeedCounter speed_counter;
-
-  double end_time = std::numeric_limits<double>::max();
-  glim->declare_parameter<double>("end_time", end_time);
-  glim->get_parameter<double>("end_time", end_time);
+  // Playback, bag reader, and flow control settings
+  glim::BagPlayer player(glim, bag_filenames, glim::BagPlayerParams::load(*glim));
 
   if (delay > 0.0) {
     spdlog::info("delaying {} sec", delay);
     std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(delay * 1000)));
   }
 
-  // Bag read function
-  const auto read_bag = [&](const std::string& bag_filename) {
-    spdlog::info("opening {}", bag_filename);
-    rosbag2_storage::StorageOptions options;
-    options.uri = bag_filename;
-
-    rosbag2_cpp::ConverterOptions converter_options;
-
-    // rosbag2_cpp::Reader reader;
-    std::unique_ptr<rosbag2_cpp::reader_interfaces::BaseReaderInterface> reader_;
-    reader_ = std::make_unique<rosbag2_cpp::readers::SequentialReader>();
-    reader_->open(options, converter_options);
-
-    if (reader_->get_metadata().compression_format != "") {
-      spdlog::info("compression detected (format={})", reader_->get_metadata().compression_format);
-      spdlog::info("opening bag with SequentialCompressionReader");
-      reader_ = std::make_unique<rosbag2_compression::SequentialCompressionReader>();
-      reader_->open(options, converter_options);
-    }
-
-    auto& reader = *reader_;
-    reader.set_filter(filter);
-
-    const auto topics_and_types = reader.get_all_topics_and_types();
-    std::unordered_map<std::string, std::string> topic_type_map;
-    for (const auto& topic : topics_and_types) {
-      topic_type_map[topic.name] = topic.type;
-    }
-
-    rclcpp::Serialization<sensor_msgs::msg::Imu> imu_serialization;
-    rclcpp::Serialization<sensor_msgs::msg::PointCloud2> points_serialization;
-    rclcpp::Serialization<sensor_msgs::msg::Image> image_serialization;
-    rclcpp::Serialization<sensor_msgs::msg::CompressedImage> compressed_image_serialization;
-
-    while (reader.has_next()) {
-      if (!rclcpp::ok()) {
-        return false;
-      }
-      rclcpp::spin_some(glim);
-
-      const auto msg = reader.read_next();
-      const std::string topic_type = topic_type_map[msg->topic_name];
-      const rclcpp::SerializedMessage serialized_msg(*msg->serialized_data);
-
-      if (real_t0.time_since_epoch().count() == 0) {
-        real_t0 = std::chrono::high_resolution_clock::now();
-      }
-
-      const auto msg_time = get_msg_recv_timestamp(*msg);
-      if (bag_t0 == 0) {
-        bag_t0 = msg_time;
-      }
-      spdlog::debug("msg_time: {} ({} sec)", msg_time / 1e9, (msg_time - bag_t0) / 1e9);
-
-      if (start_offset > 0.0) {
-        spdlog::info("skipping msg for start_offset {}", start_offset);
-        reader.seek(bag_t0 + start_offset * 1e9);
-
-        start_offset = 0.0;
-        bag_t0 = 0;
-        real_t0 = std::chrono::high_resolution_clock::from_time_t(0);
-        continue;
-      }
-
-      if (playback_until > 0.0 && msg_time / 1e9 > playback_until) {
-        spdlog::info("reached playback_until ({} < {})", msg_time / 1e9, playback_until);
-        return false;
-      }
-
-      if (playback_duration > 0.0 && (msg_time - bag_t0) / 1e9 > playback_duration) {
-        spdlog::info("reached playback_duration ({} > {})", (msg_time - bag_t0) / 1e9, playback_duration);
-        return false;
-      }
-
-      const auto bag_elapsed = std::chrono::nanoseconds(msg_time - bag_t0);
-      while (playback_speed > 0.0 && (std::chrono::high_resolution_clock::now() - real_t0) * playback_speed < bag_elapsed) {
-        const double real_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - real_t0).count() / 1e9;
-        spdlog::debug("throttling (real_elapsed={} bag_elapsed={} playback_speed={})", real_elapsed, bag_elapsed.count() / 1e9, playback_speed);
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-      }
-
-      if (msg->topic_name == imu_topic) {
-        if (topic_type != "sensor_msgs/msg/Imu") {
-          spdlog::error("topic_type mismatch: {} != sensor_msgs/msg/Imu (topic={})", topic_type, msg->topic_name);
-          return false;
-        }
-        auto imu_msg = std::make_shared<sensor_msgs::msg::Imu>();
-        imu_serialization.deserialize_message(&serialized_msg, imu_msg.get());
-        glim->imu_callback(imu_msg);
-      } else if (msg->topic_name == points_topic) {
-        if (topic_type != "sensor_msgs/msg/PointCloud2") {
-          spdlog::error("topic_type mismatch: {} != sensor_msgs/msg/PointCloud2 (topic={})", topic_type, msg->topic_name);
-          return false;
-        }
-        auto points_msg = std::make_shared<sensor_msgs::msg::PointCloud2>();
-        points_serialization.deserialize_message(&serialized_msg, points_msg.get());
-        const size_t workload = glim->points_callback(points_msg);
-
-        if (points_msg->header.stamp.sec + points_msg->header.stamp.nanosec * 1e-9 > end_time) {
-          spdlog::info("end_time reached");
-          return false;
-        }
-
-        if (workload > 5) {
-          // Odometry estimation is behind
-          const size_t sleep_msec = (workload - 4) * 5;
-          spdlog::debug("throttling: {} msec (workload={})", sleep_msec, workload);
-          std::this_thread::sleep_for(std::chrono::milliseconds(sleep_msec));
-        }
-      } else if (msg->topic_name == image_topic) {
-        if (topic_type == "sensor_msgs/msg/Image") {
-          auto image_msg = std::make_shared<sensor_msgs::msg::Image>();
-          image_serialization.deserialize_message(&serialized_msg, image_msg.get());
-          glim->image_callback(image_msg);
-        } else if (topic_type == "sensor_msgs/msg/CompressedImage") {
-          auto compressed_image_msg = std::make_shared<sensor_msgs::msg::CompressedImage>();
-          compressed_image_serialization.deserialize_message(&serialized_msg, compressed_image_msg.get());
-
-          auto image_msg = std::make_shared<sensor_msgs::msg::Image>();
-          cv_bridge::toCvCopy(*compressed_image_msg, "bgr8")->toImageMsg(*image_msg);
-          glim->image_callback(image_msg);
-        } else {
-          spdlog::error("topic_type mismatch: {} != sensor_msgs/msg/(Image|CompressedImage) (topic={})", topic_type, msg->topic_name);
-          return false;
-        }
-      }
-
-      auto found = subscription_map.find(msg->topic_name);
-      if (found != subscription_map.end()) {
-        for (const auto& sub : found->second) {
-          sub->insert_message_instance(serialized_msg, topic_type);
-        }
-      }
-
-      glim->timer_callback();
-      speed_counter.update(msg_time / 1e9);
-
-      const auto t0 = std::chrono::high_resolution_clock::now();
-      while (glim->needs_wait()) {
-        rclcpp::spin_some(glim);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        spdlog::debug("throttling (waiting for odometry estimation)");
-        if (std::chrono::high_resolution_clock::now() - t0 > std::chrono::seconds(1)) {
-          spdlog::warn("throttling timeout (an extension module may be hanged)");
-          break;
-        }
-      }
-    }
-
-    return true;
-  };
-
   // Read all rosbags
   bool auto_quit = false;
   glim->declare_parameter<bool>("auto_quit", auto_quit);
   glim->get_parameter<bool>("auto_quit", auto_quit);
 
+  // dump_path is declared in GlimROS
   std::string dump_path = "/tmp/dump";
-  glim->declare_parameter<std::string>("dump_path", dump_path);
   glim->get_parameter<std::string>("dump_path", dump_path);
 
-  for (const auto& bag_filename : bag_filenames) {
-    if (!read_bag(bag_filename)) {
-      auto_quit = true;
-      break;
-    }
+  if (!player.play()) {
+    auto_quit = true;
   }
 
   if (!auto_quit) {
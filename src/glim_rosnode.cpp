@@ -1,27 +1,67 @@
 #include <iostream>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include <rclcpp/rclcpp.hpp>
 
+#if __has_include(<rclcpp/experimental/executors/events_executor/events_executor.hpp>)
+#define GLIM_ROS_HAS_EVENTS_EXECUTOR
+#include <rclcpp/experimental/executors/events_executor/events_executor.hpp>
+#endif
+
 #include <glim_ros/glim_ros.hpp>
+#include <glim_ros/thread_affinity.hpp>
 #include <glim/util/config.hpp>
 #include <glim/util/extension_module_ros2.hpp>
 
 int main(int argc, char** argv) {
   rclcpp::init(argc, argv);
-  rclcpp::executors::SingleThreadedExecutor exec;
   rclcpp::NodeOptions options;
 
   auto glim = std::make_shared<glim::GlimROS>(options);
 
-  rclcpp::spin(glim);
+  // Executor settings
+  std::string executor_type = "multi_threaded";
+  glim->declare_parameter<std::string>("executor", executor_type);
+  glim->get_parameter<std::string>("executor", executor_type);
+
+  int num_executor_threads = 4;
+  glim->declare_parameter<int>("num_executor_threads", num_executor_threads);
+  glim->get_parameter<int>("num_executor_threads", num_executor_threads);
+
+  std::shared_ptr<rclcpp::Executor> exec;
+  if (executor_type == "single_threaded") {
+    exec = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  } else if (executor_type == "events") {
+#ifdef GLIM_ROS_HAS_EVENTS_EXECUTOR
+    exec = std::make_shared<rclcpp::experimental::executors::EventsExecutor>();
+#else
+    spdlog::warn("EventsExecutor is not available in this ROS distribution (use multi_threaded instead)");
+#endif
+  } else if (executor_type != "multi_threaded") {
+    spdlog::warn("unknown executor type {} (use multi_threaded instead)", executor_type);
+  }
+
+  if (!exec) {
+    spdlog::info("use MultiThreadedExecutor (num_threads={})", num_executor_threads);
+    exec = std::make_shared<rclcpp::executors::MultiThreadedExecutor>(rclcpp::ExecutorOptions(), std::max(1, num_executor_threads));
+  }
+
+  // The executor threads are spawned by the main thread in spin() and inherit its affinity
+  const auto executor_affinity = glim::ThreadAffinity::load(glim::Config(glim::GlobalConfig::get_config_path("config_ros")), "executor");
+  if (!executor_affinity.empty()) {
+    spdlog::info("thread affinity of executor: requested {} -> {}", executor_affinity.to_string(), glim::ScopedThreadAffinity::apply(executor_affinity));
+  }
+
+  exec->add_node(glim);
+  exec->spin();
   rclcpp::shutdown();
 
+  // dump_path is declared in GlimROS
   std::string dump_path = "/tmp/dump";
-  glim->declare_parameter<std::string>("dump_path", dump_path);
   glim->get_parameter<std::string>("dump_path", dump_path);
 
   glim->wait();
   glim->save(dump_path);
 
   return 0;
-}
\ No newline at end of file
+}
@@ -1,3 +1,5 @@
+#include <memory>
+#include <algorithm>
 #include <iostream>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
@@ -8,15 +10,18 @@
 #include <glim/util/config.hpp>
 #include <glim/util/logging.hpp>
 #include <glim/viewer/offline_viewer.hpp>
+#include <glim_ros/dump_prefetcher.hpp>
 
 int main(int argc, char** argv) {
   using namespace boost::program_options;
   options_description desc("GLIM offline viewer");
-  desc.add_options()                                                               //
-    ("help", "produce help message")                                               //
-    ("map_path", value<std::string>(), "Input map path (dump directory)")          //
-    ("config_path", value<std::string>()->default_value("config"), "Config path")  //
-    ("debug", "Enable debug printing")                                             //
+  desc.add_options()                                                                                                              //
+    ("help", "produce help message")                                                                                              //
+    ("map_path", value<std::string>(), "Input map path (dump directory)")                                                         //
+    ("config_path", value<std::string>()->default_value("config"), "Config path")                                                 //
+    ("load_threads", value<int>()->default_value(4), "Number of threads to prefetch the map dump with (0 = disable)")             //
+    ("load_memory_mb", value<double>()->default_value(0.0), "Memory cap of map prefetching [MB] (0 = half of available memory)")  //
+    ("debug", "Enable debug printing")                                                                                            //
     ;
 
   positional_options_description po;
@@ -56,6 +61,15 @@ int main(int argc, char** argv) {
     spdlog::info("map_path={}", init_map_path);
   }
 
+  // The viewer loads submaps sequentially. Reading the dump ahead of it with multiple threads
+  // lets the loader hit the page cache instead of waiting for each file in turn.
+  std::unique_ptr<glim::DumpPrefetcher> prefetcher;
+  const int load_threads = vm["load_threads"].as<int>();
+  if (!init_map_path.empty() && load_threads > 0) {
+    const size_t load_memory = std::max(0.0, vm["load_memory_mb"].as<double>()) * 1e6;
+    prefetcher.reset(new glim::DumpPrefetcher(init_map_path, load_threads, load_memory));
+  }
+
   glim::OfflineViewer viewer(init_map_path);
   viewer.wait();
 }
\ No newline at end of file
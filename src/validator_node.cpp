@@ -1,51 +1,124 @@
 #include <iostream>
+#include <spdlog/spdlog.h>
+#include <boost/format.hpp>
 #include <rclcpp/rclcpp.hpp>
 
 #include <sensor_msgs/msg/imu.hpp>
 #include <sensor_msgs/msg/point_cloud2.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 
-#define GLIM_ROS2
-#include <glim/util/ros_cloud_converter.hpp>
-#include <glim/util/data_validator.hpp>
+#include <glim_ros/stream_validator.hpp>
 
 namespace glim {
 
 class ValidatorNode : public rclcpp::Node {
 public:
   ValidatorNode(rclcpp::NodeOptions& options) : rclcpp::Node("validator_node", options) {
-    bool debug = false;
+    debug = false;
     this->declare_parameter("debug", debug);
     this->get_parameter("debug", debug);
 
-    validator.reset(new DataValidator(debug));
+    std::string imu_topic = "imu";
+    std::string points_topic = "points";
+    std::string stats_topic = "/diagnostics";
+    double stats_interval = 1.0;
+    this->declare_parameter("imu_topic", imu_topic);
+    this->get_parameter("imu_topic", imu_topic);
+    this->declare_parameter("points_topic", points_topic);
+    this->get_parameter("points_topic", points_topic);
+    this->declare_parameter("stats_topic", stats_topic);
+    this->get_parameter("stats_topic", stats_topic);
+    this->declare_parameter("stats_interval", stats_interval);
+    this->get_parameter("stats_interval", stats_interval);
 
-    using std::placeholders::_1;
-    const std::string imu_topic = "imu";
-    const std::string points_topic = "points";
+    StreamValidatorParams params;
+    this->declare_parameter("min_range", params.min_range);
+    this->get_parameter("min_range", params.min_range);
+    this->declare_parameter("max_range", params.max_range);
+    this->get_parameter("max_range", params.max_range);
+    this->declare_parameter("imu_gap_factor", params.imu_gap_factor);
+    this->get_parameter("imu_gap_factor", params.imu_gap_factor);
+    validator.reset(new StreamValidator(params));
 
+    // Messages are validated in place (ConstSharedPtr callbacks do not copy intra-process messages)
     auto imu_qos = rclcpp::SensorDataQoS();
     imu_qos.get_rmw_qos_profile().depth = 1000;
-    imu_sub = this->create_subscription<sensor_msgs::msg::Imu>(imu_topic, imu_qos, [this](const sensor_msgs::msg::Imu::SharedPtr msg) {
-      const double stamp = msg->header.stamp.sec + msg->header.stamp.nanosec / 1e9;
-      const auto& a = msg->linear_acceleration;
-      const auto& w = msg->angular_velocity;
-      validator->imu_callback(stamp, {a.x, a.y, a.z}, {w.x, w.y, w.z});
-    });
+    imu_sub = this->create_subscription<sensor_msgs::msg::Imu>(imu_topic, imu_qos, [this](const sensor_msgs::msg::Imu::ConstSharedPtr msg) { validator->validate(*msg); });
     points_sub = this->create_subscription<sensor_msgs::msg::PointCloud2>(points_topic, rclcpp::SensorDataQoS(), [this](const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg) {
-      const double stamp = msg->header.stamp.sec + msg->header.stamp.nanosec / 1e9;
-      auto raw_points = extract_raw_points(msg);
-      validator->points_callback(stamp, raw_points);
+      validator->validate(*msg);
     });
 
-    timer = this->create_wall_timer(std::chrono::seconds(1), [this]() { validator->timer_callback(); });
+    stats_pub = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>(stats_topic, 10);
+    timer = this->create_wall_timer(std::chrono::duration<double>(stats_interval), [this]() { publish_stats(); });
+  }
+
+private:
+  void publish_stats() {
+    StreamStats imu;
+    StreamStats points;
+    validator->take_window(imu, points);
+    const auto warnings = validator->warnings(imu, points);
+
+    const auto make_value = [](const std::string& key, const auto& value) {
+      diagnostic_msgs::msg::KeyValue kv;
+      kv.key = key;
+      kv.value = (boost::format("%g") % value).str();
+      return kv;
+    };
+
+    auto msg = std::make_unique<diagnostic_msgs::msg::DiagnosticArray>();
+    msg->header.stamp = this->now();
+
+    diagnostic_msgs::msg::DiagnosticStatus imu_status;
+    imu_status.name = "validator_node: imu";
+    imu_status.hardware_id = "glim";
+    imu_status.values.emplace_back(make_value("rate_hz", imu.rate()));
+    imu_status.values.emplace_back(make_value("jitter_ms", imu.jitter() * 1e3));
+    imu_status.values.emplace_back(make_value("max_interval_ms", imu.max_interval * 1e3));
+    imu_status.values.emplace_back(make_value("stamp_errors", imu.num_stamp_errors));
+    imu_status.values.emplace_back(make_value("gaps", imu.num_imu_gaps));
+    imu_status.values.emplace_back(make_value("non_finite", imu.num_imu_non_finite));
+    msg->status.emplace_back(imu_status);
+
+    diagnostic_msgs::msg::DiagnosticStatus points_status;
+    points_status.name = "validator_node: points";
+    points_status.hardware_id = "glim";
+    points_status.values.emplace_back(make_value("rate_hz", points.rate()));
+    points_status.values.emplace_back(make_value("jitter_ms", points.jitter() * 1e3));
+    points_status.values.emplace_back(make_value("stamp_errors", points.num_stamp_errors));
+    points_status.values.emplace_back(make_value("points", points.num_points));
+    points_status.values.emplace_back(make_value("non_finite", points.num_non_finite));
+    points_status.values.emplace_back(make_value("out_of_range", points.num_out_of_range));
+    points_status.values.emplace_back(make_value("time_disorder", points.num_time_disorder));
+    points_status.values.emplace_back(make_value("max_scan_duration_ms", points.max_scan_duration * 1e3));
+    msg->status.emplace_back(points_status);
+
+    for (auto& status : msg->status) {
+      status.level = warnings.empty() ? diagnostic_msgs::msg::DiagnosticStatus::OK : diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    }
+    for (const auto& warning : warnings) {
+      msg->status.front().message += (msg->status.front().message.empty() ? "" : "; ") + warning;
+    }
+    msg->status.back().message = msg->status.front().message;
+
+    stats_pub->publish(std::move(msg));
+
+    for (const auto& warning : warnings) {
+      spdlog::warn("{}", warning);
+    }
+    if (debug) {
+      spdlog::info("imu: {:.1f}Hz jitter={:.3f}ms points: {:.1f}Hz num_points={}", imu.rate(), imu.jitter() * 1e3, points.rate(), points.num_points);
+    }
   }
 
 private:
-  std::unique_ptr<DataValidator> validator;
+  bool debug;
+  std::unique_ptr<StreamValidator> validator;
 
   rclcpp::TimerBase::SharedPtr timer;
   rclcpp::Subscription<sensor_msgs::msg::Imu>::SharedPtr imu_sub;
   rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr points_sub;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr stats_pub;
 };
 
 }  // namespace glim
@@ -58,4 +131,4 @@ int main(int argc, char** argv) {
   rclcpp::shutdown();
 
   return 0;
-}
\ No newline at end of file
+}
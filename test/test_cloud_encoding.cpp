@@ -0,0 +1,200 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <sensor_msgs/msg/point_field.hpp>
+#include <glim_ros/cloud_encoding.hpp>
+
+using glim::CloudEncoder;
+using glim::CloudEncoding;
+using sensor_msgs::msg::PointCloud2;
+using sensor_msgs::msg::PointField;
+
+namespace {
+
+struct Point {
+  float x, y, z;
+  float intensity;
+  float t;
+};
+
+/// @brief Full-fidelity cloud (float32 x, y, z, intensity, t)
+PointCloud2 create_cloud(const std::vector<Point>& points) {
+  PointCloud2 msg;
+  msg.header.frame_id = "lidar";
+  const std::vector<std::string> names = {"x", "y", "z", "intensity", "t"};
+  for (size_t i = 0; i < names.size(); i++) {
+    PointField field;
+    field.name = names[i];
+    field.offset = sizeof(float) * i;
+    field.datatype = PointField::FLOAT32;
+    field.count = 1;
+    msg.fields.emplace_back(field);
+  }
+
+  msg.height = 1;
+  msg.width = points.size();
+  msg.point_step = sizeof(Point);
+  msg.row_step = msg.point_step * msg.width;
+  msg.data.resize(msg.row_step);
+  std::memcpy(msg.data.data(), points.data(), msg.data.size());
+  return msg;
+}
+
+const PointField* find_field(const PointCloud2& msg, const std::string& name) {
+  for (const auto& field : msg.fields) {
+    if (field.name == name) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+T read(const PointCloud2& msg, size_t i, const PointField& field) {
+  T value;
+  std::memcpy(&value, msg.data.data() + msg.point_step * i + field.offset, sizeof(T));
+  return value;
+}
+
+CloudEncoding int16_encoding(double quantization) {
+  CloudEncoding encoding;
+  encoding.type = CloudEncoding::Type::INT16;
+  encoding.quantization = quantization;
+  return encoding;
+}
+
+}  // namespace
+
+TEST(CloudEncodingTest, Int16RoundTrip) {
+  // Far from the frame origin (e.g., a map-frame cloud)
+  const std::vector<Point> points = {
+    {1000.0f, 2000.0f, 10.0f, 1.0f, 0.0f},
+    {1001.234f, 1994.322f, 19.1011f, 2.0f, 0.01f},
+    {900.005f, 2200.004f, -290.0f, 3.0f, 0.05f},
+    {1227.67f, 1972.33f, 10.004f, 4.0f, 0.1f},
+  };
+
+  const double quantization = 0.01;
+  CloudEncoder encoder(int16_encoding(quantization));
+  PointCloud2 encoded;
+  encoder.encode(create_cloud(points), encoded);
+
+  ASSERT_EQ(encoded.width, points.size());
+  EXPECT_EQ(encoded.height, 1);
+  EXPECT_EQ(encoded.header.frame_id, "lidar");
+  EXPECT_EQ(encoded.point_step, sizeof(std::int16_t) * 3 + sizeof(float) * 2);
+  EXPECT_EQ(encoded.row_step, encoded.point_step * encoded.width + CloudEncoder::int16_frame_size);
+  EXPECT_EQ(encoded.data.size(), encoded.row_step);
+  EXPECT_EQ(encoder.num_rescaled(), 0);
+
+  // The frame is the bounding box center with the configured step
+  Eigen::Vector3d origin;
+  double scale;
+  ASSERT_TRUE(CloudEncoder::read_int16_frame(encoded, origin, scale));
+  EXPECT_NEAR(origin.x(), (900.005 + 1227.67) / 2, 1e-3);
+  EXPECT_NEAR(origin.y(), (1972.33 + 2200.004) / 2, 1e-3);
+  EXPECT_NEAR(origin.z(), (-290.0 + 19.1011) / 2, 1e-3);
+  EXPECT_DOUBLE_EQ(scale, quantization);
+
+  const PointField* x = find_field(encoded, "x");
+  const PointField* y = find_field(encoded, "y");
+  const PointField* z = find_field(encoded, "z");
+  const PointField* t = find_field(encoded, "t");
+  const PointField* intensity = find_field(encoded, "intensity");
+  ASSERT_TRUE(x && y && z && t && intensity);
+  EXPECT_EQ(x->datatype, PointField::INT16);
+  EXPECT_EQ(t->datatype, PointField::FLOAT32);
+  EXPECT_EQ(intensity->datatype, PointField::FLOAT32);
+
+  // Decoded coordinates are within half a step (plus the float32 rounding of the input)
+  const double tolerance = scale / 2 + 1e-3;
+  for (size_t i = 0; i < points.size(); i++) {
+    EXPECT_NEAR(origin.x() + read<std::int16_t>(encoded, i, *x) * scale, points[i].x, tolerance);
+    EXPECT_NEAR(origin.y() + read<std::int16_t>(encoded, i, *y) * scale, points[i].y, tolerance);
+    EXPECT_NEAR(origin.z() + read<std::int16_t>(encoded, i, *z) * scale, points[i].z, tolerance);
+    EXPECT_EQ(read<float>(encoded, i, *t), points[i].t);
+    EXPECT_EQ(read<float>(encoded, i, *intensity), points[i].intensity);
+  }
+
+  // Float32 clouds carry no frame
+  PointCloud2 float_encoded;
+  CloudEncoder(CloudEncoding()).encode(create_cloud(points), float_encoded);
+  EXPECT_FALSE(CloudEncoder::read_int16_frame(float_encoded, origin, scale));
+}
+
+TEST(CloudEncodingTest, Int16Range) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const std::vector<Point> points = {
+    {-327.67f, 0.0f, 0.0f, 0.0f, 0.0f},
+    {327.67f, 0.0f, 0.0f, 0.0f, 0.0f},   // Half extent = 32767 steps: in range
+    {nan, 0.0f, 0.0f, 0.0f, 0.0f},       // Non-finite (skipped)
+  };
+
+  CloudEncoder encoder(int16_encoding(0.01));
+  PointCloud2 encoded;
+  encoder.encode(create_cloud(points), encoded);
+
+  ASSERT_EQ(encoded.width, 2);
+  EXPECT_EQ(encoder.num_rescaled(), 0);
+
+  const PointField* x = find_field(encoded, "x");
+  ASSERT_TRUE(x);
+  EXPECT_EQ(read<std::int16_t>(encoded, 0, *x), -32767);
+  EXPECT_EQ(read<std::int16_t>(encoded, 1, *x), 32767);
+
+  // A cloud beyond the range is kept with a coarser step instead of dropping points
+  const std::vector<Point> large_points = {
+    {-1000.0f, 0.0f, 0.0f, 0.0f, 0.0f},
+    {0.0f, 3000.0f, 0.0f, 0.0f, 0.0f},
+    {0.0f, 0.0f, 5.0f, 0.0f, 0.0f},
+  };
+  encoder.encode(create_cloud(large_points), encoded);
+  ASSERT_EQ(encoded.width, 3);
+  EXPECT_EQ(encoder.num_rescaled(), 1);
+
+  Eigen::Vector3d origin;
+  double scale;
+  ASSERT_TRUE(CloudEncoder::read_int16_frame(encoded, origin, scale));
+  EXPECT_NEAR(scale, 1500.0 / 32767, 1e-9);  // Half extent of y
+
+  const PointField* y = find_field(encoded, "y");
+  ASSERT_TRUE(y);
+  for (size_t i = 0; i < large_points.size(); i++) {
+    EXPECT_NEAR(origin.x() + read<std::int16_t>(encoded, i, *x) * scale, large_points[i].x, scale / 2 + 1e-6);
+    EXPECT_NEAR(origin.y() + read<std::int16_t>(encoded, i, *y) * scale, large_points[i].y, scale / 2 + 1e-6);
+  }
+  EXPECT_EQ(read<std::int16_t>(encoded, 1, *y), 32767);
+}
+
+TEST(CloudEncodingTest, FieldsAndVoxels) {
+  const std::vector<Point> points = {
+    {0.01f, 0.01f, 0.01f, 1.0f, 0.0f},
+    {0.02f, 0.02f, 0.02f, 2.0f, 0.1f},  // Same voxel as the first point
+    {1.01f, 0.01f, 0.01f, 3.0f, 0.2f},
+  };
+
+  CloudEncoding encoding;
+  encoding.with_times = false;
+  encoding.with_intensities = false;
+  encoding.voxel_resolution = 0.5;
+  ASSERT_TRUE(encoding.enabled());
+
+  CloudEncoder encoder(encoding);
+  PointCloud2 encoded;
+  encoder.encode(create_cloud(points), encoded);
+
+  // Only the float32 coordinates of the first point in each voxel are kept
+  ASSERT_EQ(encoded.fields.size(), 3);
+  EXPECT_EQ(encoded.point_step, sizeof(float) * 3);
+  ASSERT_EQ(encoded.width, 2);
+
+  const PointField* x = find_field(encoded, "x");
+  ASSERT_TRUE(x);
+  EXPECT_EQ(x->datatype, PointField::FLOAT32);
+  EXPECT_EQ(read<float>(encoded, 0, *x), 0.01f);
+  EXPECT_EQ(read<float>(encoded, 1, *x), 1.01f);
+
+  EXPECT_FALSE(CloudEncoding().enabled());
+}
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <limits>
+#include <gtest/gtest.h>
+#include <glim_ros/latency_histogram.hpp>
+
+using glim::LatencyHistogram;
+using namespace std::chrono_literals;
+
+TEST(LatencyHistogramTest, BucketBounds) {
+  EXPECT_EQ(LatencyHistogram::bucket_index(0), 0);
+  EXPECT_EQ(LatencyHistogram::bucket_index(999), 0);
+  EXPECT_EQ(LatencyHistogram::bucket_index(1000), 1);
+
+  // Samples beyond the range are saturated into the last bucket
+  EXPECT_EQ(LatencyHistogram::bucket_index(std::numeric_limits<std::int64_t>::max()), LatencyHistogram::num_buckets - 1);
+
+  // Every value in range falls below the upper bound of its bucket and at or above the upper bound of the previous one
+  const std::uint64_t max_ns = std::ldexp(1.0, LatencyHistogram::num_octaves) * 1e3;
+  for (std::uint64_t ns = 1000; ns < max_ns; ns = ns * 17 / 10) {
+    const int index = LatencyHistogram::bucket_index(ns);
+    ASSERT_GT(index, 0);
+    ASSERT_LT(index, LatencyHistogram::num_buckets);
+    EXPECT_LT(ns * 1e-9, LatencyHistogram::bucket_upper_bound(index) * (1.0 + 1e-12)) << "ns=" << ns;
+    EXPECT_GE(ns * 1e-9, LatencyHistogram::bucket_upper_bound(index - 1) * (1.0 - 1e-12)) << "ns=" << ns;
+  }
+}
+
+TEST(LatencyHistogramTest, Statistics) {
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 100; i++) {
+    histogram.record(std::chrono::microseconds(i * 10));
+  }
+
+  const auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 100);
+  EXPECT_NEAR(snapshot.mean(), 505e-6, 1e-12);
+  EXPECT_NEAR(snapshot.max(), 1e-3, 1e-12);
+
+  // Quantiles are bucket upper bounds (at most 25% above the exact value) clamped to the max
+  EXPECT_GE(snapshot.quantile(0.5), 500e-6);
+  EXPECT_LE(snapshot.quantile(0.5), 500e-6 * 1.25);
+  EXPECT_DOUBLE_EQ(snapshot.quantile(1.0), snapshot.max());
+  EXPECT_DOUBLE_EQ(LatencyHistogram::Snapshot().quantile(0.5), 0.0);
+}
+
+TEST(LatencyHistogramTest, Window) {
+  LatencyHistogram histogram;
+  histogram.record(100ms);
+  histogram.record(1ms);
+  const auto window0 = histogram.take_window();
+  EXPECT_EQ(window0.count, 2);
+  EXPECT_NEAR(window0.window_max_ns * 1e-9, 0.1, 1e-12);
+
+  histogram.record(2ms);
+  histogram.record(4ms);
+  const auto window1 = histogram.take_window();
+  const auto diff = window1 - window0;
+
+  // The window contains only the samples recorded after the previous window, including the max
+  EXPECT_EQ(diff.count, 2);
+  EXPECT_NEAR(diff.mean(), 3e-3, 1e-12);
+  EXPECT_NEAR(diff.max(), 4e-3, 1e-12);
+  EXPECT_LE(diff.quantile(0.99), 4e-3);
+  EXPECT_EQ(diff.counts[LatencyHistogram::bucket_index(100000000)], 0);
+
+  // The cumulative max is kept
+  EXPECT_NEAR(window1.max(), 0.1, 1e-12);
+
+  // An empty window has no max
+  const auto empty = histogram.take_window() - window1;
+  EXPECT_EQ(empty.count, 0);
+  EXPECT_EQ(empty.max_ns, 0);
+}
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+#include <glim_ros/pose_slot.hpp>
+
+using glim::PoseSample;
+using glim::PoseSlot;
+
+namespace {
+
+/// @brief Sample whose fields are all derived from i (a torn read mixes different values)
+PoseSample create_sample(int i) {
+  PoseSample sample;
+  sample.stamp = i;
+  sample.anchor_stamp = i;
+  for (int j = 0; j < 3; j++) {
+    sample.position[j] = i;
+    sample.linear_velocity[j] = i;
+    sample.angular_velocity[j] = i;
+  }
+  for (int j = 0; j < 4; j++) {
+    sample.orientation[j] = i;
+  }
+  return sample;
+}
+
+bool consistent(const PoseSample& sample) {
+  const double* values = reinterpret_cast<const double*>(&sample);
+  for (size_t j = 0; j < sizeof(PoseSample) / sizeof(double); j++) {
+    if (values[j] != sample.stamp) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(PoseSlotTest, ReadWrite) {
+  PoseSlot slot;
+  slot.sequence = 0;
+
+  PoseSample sample;
+  EXPECT_FALSE(slot.read(sample));
+  EXPECT_EQ(slot.count(), 0);
+
+  slot.write(create_sample(1));
+  slot.write(create_sample(2));
+  ASSERT_TRUE(slot.read(sample));
+  EXPECT_EQ(sample.stamp, 2.0);
+  EXPECT_TRUE(consistent(sample));
+  EXPECT_EQ(slot.count(), 2);
+}
+
+TEST(PoseSlotTest, ConcurrentReadsAreNotTorn) {
+  PoseSlot slot;
+  slot.sequence = 0;
+  slot.write(create_sample(0));
+
+  std::atomic_bool done(false);
+  std::thread writer([&] {
+    for (int i = 1; i <= 200000; i++) {
+      slot.write(create_sample(i));
+    }
+    done = true;
+  });
+
+  double last_stamp = 0.0;
+  while (!done) {
+    PoseSample sample;
+    if (slot.read(sample)) {
+      ASSERT_TRUE(consistent(sample));
+      ASSERT_GE(sample.stamp, last_stamp);
+      last_stamp = sample.stamp;
+    }
+  }
+
+  writer.join();
+  EXPECT_EQ(slot.count(), 200001);
+}
@@ -0,0 +1,154 @@
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <glim_ros/sensor_merge_queue.hpp>
+
+using glim::RawPoints;
+using glim::SensorMergeQueue;
+
+namespace {
+
+/// @brief Records the delivered inputs as "imu:<stamp>" or "points:<stamp>"
+class Recorder {
+public:
+  std::unique_ptr<SensorMergeQueue> create(double max_latency, double imu_time_offset = 0.0, double points_time_offset = 0.0) {
+    return std::make_unique<SensorMergeQueue>(
+      max_latency,
+      imu_time_offset,
+      points_time_offset,
+      [this](double stamp, const Eigen::Vector3d&, const Eigen::Vector3d&) { add("imu:" + std::to_string(stamp)); },
+      [this](const RawPoints::Ptr& raw_points) { add("points:" + std::to_string(raw_points->stamp)); },
+      [this](double stamp, const cv::Mat&) { add("image:" + std::to_string(stamp)); });
+  }
+
+  /// @brief Wait until n inputs have been delivered (or a timeout)
+  std::vector<std::string> wait(size_t n) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (delivered.size() >= n) {
+          return delivered;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return get();
+  }
+
+  std::vector<std::string> get() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return delivered;
+  }
+
+private:
+  void add(const std::string& input) {
+    std::lock_guard<std::mutex> lock(mutex);
+    delivered.emplace_back(input);
+  }
+
+  std::mutex mutex;
+  std::vector<std::string> delivered;
+};
+
+/// @brief Frame with relative per-point times in [0, duration]
+RawPoints::Ptr create_frame(double stamp, double duration) {
+  auto raw_points = std::make_shared<RawPoints>();
+  raw_points->stamp = stamp;
+  raw_points->times = {0.0, duration};
+  raw_points->points.resize(2, Eigen::Vector4d(1.0, 0.0, 0.0, 1.0));
+  return raw_points;
+}
+
+std::string imu(double stamp) {
+  return "imu:" + std::to_string(stamp);
+}
+
+std::string points(double stamp) {
+  return "points:" + std::to_string(stamp);
+}
+
+}  // namespace
+
+TEST(SensorMergeQueueTest, HoldFrameUntilImuCoverage) {
+  Recorder recorder;
+  auto queue = recorder.create(10.0);
+
+  queue->push_imu(100.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  queue->push_points(create_frame(100.1, 0.1));  // Scan end = 100.2
+  queue->push_imu(100.15, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  EXPECT_EQ(recorder.wait(2), (std::vector<std::string>{imu(100.0), imu(100.15)}));
+
+  // IMU samples after the scan end wait behind the frame
+  queue->push_imu(100.18, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(recorder.get().size(), 3);
+  EXPECT_EQ(queue->size(), 1);
+
+  queue->push_imu(100.25, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  EXPECT_EQ(recorder.wait(5), (std::vector<std::string>{imu(100.0), imu(100.15), imu(100.18), points(100.1), imu(100.25)}));
+  EXPECT_EQ(queue->num_expired(), 0);
+}
+
+TEST(SensorMergeQueueTest, SensorTimeOrder) {
+  Recorder recorder;
+  auto queue = recorder.create(10.0);
+
+  // A frame that arrives later but ends earlier in sensor time is released first
+  queue->push_imu(1.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  queue->push_points(create_frame(1.0, 0.1));    // Scan end = 1.1
+  queue->push_points(create_frame(0.98, 0.05));  // Scan end = 1.03
+  queue->push_imu(1.2, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+
+  const std::vector<std::string> expected = {imu(1.0), points(0.98), points(1.0), imu(1.2)};
+  EXPECT_EQ(recorder.wait(expected.size()), expected);
+  EXPECT_EQ(queue->num_late(), 0);
+
+  // An IMU sample older than a released one is delivered but counted as late
+  queue->push_imu(1.15, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  recorder.wait(expected.size() + 1);
+  EXPECT_EQ(queue->num_late(), 1);
+}
+
+TEST(SensorMergeQueueTest, TimeOffsets) {
+  Recorder recorder;
+  auto queue = recorder.create(10.0, 0.5, 0.0);
+
+  // IMU sensor time = stamp + 0.5, so the IMU stamped 0.0 covers the frame ending at 0.3
+  queue->push_imu(-0.4, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  queue->push_points(create_frame(0.2, 0.1));
+  queue->push_imu(0.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+
+  // The callbacks receive the original stamps
+  EXPECT_EQ(recorder.wait(3), (std::vector<std::string>{imu(-0.4), points(0.2), imu(0.0)}));
+}
+
+TEST(SensorMergeQueueTest, ExpireWithoutImu) {
+  Recorder recorder;
+  auto queue = recorder.create(0.05);
+
+  queue->push_imu(100.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  queue->push_points(create_frame(100.1, 0.1));
+
+  // Released after max_latency although the IMU stream stalled
+  EXPECT_EQ(recorder.wait(2), (std::vector<std::string>{imu(100.0), points(100.1)}));
+  EXPECT_EQ(queue->num_expired(), 1);
+}
+
+TEST(SensorMergeQueueTest, Flush) {
+  Recorder recorder;
+  auto queue = recorder.create(10.0);
+
+  queue->push_imu(100.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  queue->push_points(create_frame(100.1, 0.1));
+  queue->push_imu(100.3, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  queue->push_points(create_frame(100.5, 0.1));
+  queue->flush();
+
+  // Everything is delivered when flush() returns
+  EXPECT_EQ(recorder.get(), (std::vector<std::string>{imu(100.0), points(100.1), imu(100.3), points(100.5)}));
+  EXPECT_EQ(queue->size(), 0);
+}
@@ -0,0 +1,86 @@
+#include <thread>
+#include <memory>
+#include <gtest/gtest.h>
+#include <glim_ros/spsc_queue.hpp>
+
+using glim::SPSCQueue;
+
+TEST(SPSCQueueTest, Capacity) {
+  EXPECT_EQ(SPSCQueue<int>(1).capacity(), 1);
+  EXPECT_EQ(SPSCQueue<int>(5).capacity(), 8);
+  EXPECT_EQ(SPSCQueue<int>(1024).capacity(), 1024);
+
+  SPSCQueue<int> queue(4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.try_push(i));
+  }
+  EXPECT_FALSE(queue.try_push(4));
+  EXPECT_EQ(queue.size(), 4);
+
+  int value;
+  EXPECT_TRUE(queue.try_pop(value));
+  EXPECT_EQ(value, 0);
+  EXPECT_TRUE(queue.try_push(4));
+}
+
+TEST(SPSCQueueTest, Order) {
+  SPSCQueue<int> queue(4);
+  int value;
+  EXPECT_FALSE(queue.try_pop(value));
+
+  // Wraps around the ring buffer several times
+  int next_push = 0;
+  int next_pop = 0;
+  for (int round = 0; round < 10; round++) {
+    while (queue.try_push(next_push)) {
+      next_push++;
+    }
+    for (int i = 0; i < 3 && queue.try_pop(value); i++) {
+      EXPECT_EQ(value, next_pop++);
+    }
+  }
+
+  while (queue.try_pop(value)) {
+    EXPECT_EQ(value, next_pop++);
+  }
+  EXPECT_EQ(next_pop, next_push);
+  EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(SPSCQueueTest, ReleasesPoppedElements) {
+  SPSCQueue<std::shared_ptr<int>> queue(2);
+  const auto element = std::make_shared<int>(1);
+  queue.try_push(element);
+
+  std::shared_ptr<int> popped;
+  EXPECT_TRUE(queue.try_pop(popped));
+  popped.reset();
+  EXPECT_EQ(element.use_count(), 1);
+}
+
+TEST(SPSCQueueTest, Concurrent) {
+  constexpr int num_values = 200000;
+  SPSCQueue<int> queue(64);
+
+  std::thread producer([&] {
+    for (int i = 0; i < num_values; i++) {
+      while (!queue.try_push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  while (expected < num_values) {
+    int value;
+    if (!queue.try_pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(value, expected);
+    expected++;
+  }
+
+  producer.join();
+  EXPECT_EQ(queue.size(), 0);
+}